@@ -0,0 +1,1067 @@
+#include "Bvh.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+
+namespace {
+
+const float inf = std::numeric_limits<float>::infinity();
+const unsigned maxBins = 256;
+// chopping references at every bin border is most of the cost of a spatial split, and more
+// bins than this hardly find better planes
+const unsigned spatialBins = 16;
+
+struct Bounds {
+    float lo[3] = {inf, inf, inf};
+    float hi[3] = {-inf, -inf, -inf};
+
+    void grow(const float p[3]) {
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], p[k]);
+            hi[k] = std::max(hi[k], p[k]);
+        }
+    }
+
+    void grow(const Bounds& b) {
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], b.lo[k]);
+            hi[k] = std::max(hi[k], b.hi[k]);
+        }
+    }
+
+    void clip(const Bounds& b) {
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::max(lo[k], b.lo[k]);
+            hi[k] = std::min(hi[k], b.hi[k]);
+        }
+    }
+
+    bool empty() const {
+        return lo[0] > hi[0] || lo[1] > hi[1] || lo[2] > hi[2];
+    }
+
+    float area() const {
+        float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+        if (dx < 0.0f || dy < 0.0f || dz < 0.0f) return 0.0f;
+        return 2.0f * (dx * dy + dy * dz + dz * dx);
+    }
+};
+
+struct Bin {
+    Bounds bounds;     // of the triangles
+    Bounds centroids;  // of their centroids, the next level bins over these
+    uint32_t count = 0;
+
+    void add(const Bin& o) {
+        bounds.grow(o.bounds);
+        centroids.grow(o.centroids);
+        count += o.count;
+    }
+};
+
+// a range of refs that becomes the subtree under `node`
+struct BuildTask {
+    uint32_t node;
+    uint32_t begin, end;
+    Bounds bounds, centroids;
+    unsigned depth;
+};
+
+class Builder {
+public:
+    Builder(const TriangleGeometry& geometry, const BvhBuildOptions& options, std::vector<uint32_t>& refs)
+        : options(options), binCount(std::clamp(options.bins, 2u, maxBins)), refs(refs) {
+        prepare(geometry.triangleCount, [&](size_t t, Bounds& box) {
+            for (int k = 0; k < 3; ++k) box.grow(geometry.vertex(geometry.indices[3 * t + k]));
+        });
+    }
+
+    // over boxes given as min x, y, z, max x, y, z each
+    Builder(const float* items, size_t count, const BvhBuildOptions& options, std::vector<uint32_t>& refs)
+        : options(options), binCount(std::clamp(options.bins, 2u, maxBins)), refs(refs) {
+        prepare(count, [&](size_t t, Bounds& box) {
+            box.grow(items + 6 * t);
+            box.grow(items + 6 * t + 3);
+        });
+    }
+
+    BuildTask rootTask() const {
+        // the bounds of everything, merged from per-block partial bounds
+        size_t count = refs.size(), block = 1 << 16;
+        std::vector<Bin> partial((count + block - 1) / block);
+        parallelFor(0, partial.size(), [&](size_t b) {
+            for (size_t t = b * block; t < std::min(count, (b + 1) * block); ++t) {
+                partial[b].bounds.grow(boxes[t]);
+                partial[b].centroids.grow(&centers[3 * t]);
+            }
+        });
+        Bin all;
+        for (const Bin& bin : partial) all.add(bin);
+        return {0, 0, static_cast<uint32_t>(count), all.bounds, all.centroids, 0};
+    }
+
+    // Builds the tree top-down. Large ranges are binned on all cores and split here one by one;
+    // the ranges below the threshold become subtrees that are built on their own, all at once,
+    // and are appended to `nodes` afterwards.
+    void build(std::vector<BvhNode>& nodes) {
+        BuildTask root = rootTask();
+        nodes.assign(1, BvhNode());
+        const size_t threshold = std::max<size_t>(4096, refs.size() / (threadCount() * 8));
+
+        std::vector<BuildTask> queue = {root}, subtrees;
+        std::vector<Bin> bins(3 * binCount);
+        for (size_t i = 0; i < queue.size(); ++i) {
+            BuildTask task = queue[i];
+            if (task.end - task.begin <= threshold) {
+                subtrees.push_back(task);
+                continue;
+            }
+            binParallel(task, bins);
+            BuildTask children[2];
+            if (split(nodes, task, bins, children)) queue.insert(queue.end(), children, children + 2);
+        }
+
+        // biggest first, so a large one doesn't start last
+        std::sort(subtrees.begin(), subtrees.end(), [](const BuildTask& a, const BuildTask& b) {
+            return a.end - a.begin > b.end - b.begin;
+        });
+        std::vector<std::vector<BvhNode>> local(subtrees.size());
+        parallelFor(0, subtrees.size(), [&](size_t s) {
+            BuildTask task = subtrees[s];
+            task.node = 0;
+            local[s].assign(1, BvhNode());
+            buildSerial(local[s], task);
+        });
+
+        // splice: local node 0 replaces the placeholder, the rest is appended
+        std::vector<size_t> offset(subtrees.size());
+        size_t total = nodes.size();
+        for (size_t s = 0; s < subtrees.size(); ++s) {
+            offset[s] = total - 1;
+            total += local[s].size() - 1;
+        }
+        nodes.resize(total);
+        parallelFor(0, subtrees.size(), [&](size_t s) {
+            auto relocate = [&](BvhNode node) {
+                if (node.count == 0) node.first += static_cast<uint32_t>(offset[s]);
+                return node;
+            };
+            nodes[subtrees[s].node] = relocate(local[s][0]);
+            for (size_t n = 1; n < local[s].size(); ++n) nodes[offset[s] + n] = relocate(local[s][n]);
+            std::vector<BvhNode>().swap(local[s]);
+        });
+    }
+
+private:
+    template <typename BoxOf>
+    void prepare(size_t count, BoxOf boxOf) {
+        boxes.resize(count);
+        centers.resize(3 * count);
+        refs.resize(count);
+        parallelFor(0, count, [&](size_t t) {
+            Bounds& box = boxes[t];
+            boxOf(t, box);
+            for (int k = 0; k < 3; ++k) centers[3 * t + k] = 0.5f * (box.lo[k] + box.hi[k]);
+            refs[t] = static_cast<uint32_t>(t);
+        }, 4096);
+    }
+
+    const BvhBuildOptions& options;
+    const unsigned binCount;
+    std::vector<uint32_t>& refs;
+    std::vector<Bounds> boxes;  // per triangle
+    std::vector<float> centers; // x, y, z per triangle
+
+    // small ranges get fewer bins, more candidates than triangles buy nothing
+    unsigned binsFor(const BuildTask& task) const {
+        return std::min(binCount, std::max(4u, task.end - task.begin));
+    }
+
+    // maps centroids of a task to bins along each axis. a flat axis puts everything in bin 0,
+    // which leaves no split candidates on it
+    struct BinMapping {
+        float lo[3];
+        float scale[3];
+        unsigned count;
+
+        unsigned bin(const float* center, int axis) const {
+            float x = (center[axis] - lo[axis]) * scale[axis];
+            return std::min(count - 1, static_cast<unsigned>(std::max(0.0f, x)));
+        }
+    };
+
+    BinMapping mapping(const BuildTask& task) const {
+        BinMapping m;
+        m.count = binsFor(task);
+        for (int k = 0; k < 3; ++k) {
+            float extent = task.centroids.hi[k] - task.centroids.lo[k];
+            m.lo[k] = task.centroids.lo[k];
+            m.scale[k] = extent > 0.0f ? m.count / extent : 0.0f;
+        }
+        return m;
+    }
+
+    void binRange(const BuildTask& task, uint32_t begin, uint32_t end, Bin* bins) const {
+        BinMapping m = mapping(task);
+        for (uint32_t r = begin; r < end; ++r) {
+            uint32_t ref = refs[r];
+            const Bounds& box = boxes[ref];
+            const float* center = &centers[3 * ref];
+            for (int axis = 0; axis < 3; ++axis) {
+                Bin& bin = bins[axis * binCount + m.bin(center, axis)];
+                bin.bounds.grow(box);
+                bin.centroids.grow(center);
+                bin.count++;
+            }
+        }
+    }
+
+    void binParallel(const BuildTask& task, std::vector<Bin>& bins) const {
+        const uint32_t block = 1 << 16;
+        size_t blocks = (task.end - task.begin + block - 1) / block;
+        std::vector<std::vector<Bin>> partial(blocks);
+        parallelFor(0, blocks, [&](size_t b) {
+            partial[b].resize(3 * binCount);
+            uint32_t begin = task.begin + static_cast<uint32_t>(b) * block;
+            binRange(task, begin, std::min(task.end, begin + block), partial[b].data());
+        });
+        std::fill(bins.begin(), bins.end(), Bin());
+        for (const auto& p : partial) {
+            for (size_t i = 0; i < bins.size(); ++i) bins[i].add(p[i]);
+        }
+    }
+
+    void buildSerial(std::vector<BvhNode>& nodes, const BuildTask& root) const {
+        std::vector<BuildTask> stack = {root};
+        std::vector<Bin> bins(3 * binCount);
+        while (!stack.empty()) {
+            BuildTask task = stack.back();
+            stack.pop_back();
+            for (int axis = 0; axis < 3; ++axis) {
+                std::fill_n(bins.begin() + axis * binCount, binsFor(task), Bin());
+            }
+            binRange(task, task.begin, task.end, bins.data());
+            BuildTask children[2];
+            if (split(nodes, task, bins, children)) {
+                stack.push_back(children[1]);
+                stack.push_back(children[0]);
+            }
+        }
+    }
+
+    // Writes the node for `task`: a leaf, or an interior node with two fresh children whose
+    // ranges come back in `children`. Returns false for a leaf.
+    bool split(std::vector<BvhNode>& nodes, const BuildTask& task, const std::vector<Bin>& bins, BuildTask children[2]) const {
+        uint32_t count = task.end - task.begin;
+        auto makeLeaf = [&]() {
+            BvhNode& node = nodes[task.node];
+            std::copy(task.bounds.lo, task.bounds.lo + 3, node.boundsMin);
+            std::copy(task.bounds.hi, task.bounds.hi + 3, node.boundsMax);
+            node.first = task.begin;
+            node.count = count;
+            return false;
+        };
+        if (count <= 1) return makeLeaf();
+
+        // best bin border over all axes
+        int bestAxis = -1;
+        unsigned bestBin = 0;
+        float bestCost = inf;
+        if (task.depth < bvhMaxDepth / 2) {
+            float rightArea[maxBins];
+            uint32_t rightCount[maxBins];
+            float area = task.bounds.area();
+            unsigned used = binsFor(task);
+            for (int axis = 0; axis < 3; ++axis) {
+                if (task.centroids.hi[axis] <= task.centroids.lo[axis]) continue;
+                const Bin* axisBins = &bins[axis * binCount];
+                Bounds right;
+                uint32_t n = 0;
+                for (unsigned b = used - 1; b > 0; --b) {
+                    right.grow(axisBins[b].bounds);
+                    n += axisBins[b].count;
+                    rightArea[b] = right.area();
+                    rightCount[b] = n;
+                }
+                Bounds left;
+                n = 0;
+                for (unsigned b = 1; b < used; ++b) {
+                    left.grow(axisBins[b - 1].bounds);
+                    n += axisBins[b - 1].count;
+                    if (n == 0 || rightCount[b] == 0) continue;
+                    float cost = options.traversalCost +
+                                 options.intersectionCost * (left.area() * n + rightArea[b] * rightCount[b]) / area;
+                    if (cost < bestCost) {
+                        bestCost = cost;
+                        bestAxis = axis;
+                        bestBin = b;
+                    }
+                }
+            }
+        }
+
+        bool worthIt = bestAxis >= 0 && bestCost < options.intersectionCost * count;
+        if (!worthIt && count <= options.maxLeafSize) return makeLeaf();
+
+        uint32_t middle;
+        Bin left, right;
+        auto begin = refs.begin() + task.begin, end = refs.begin() + task.end;
+        if (bestAxis >= 0) {
+            BinMapping m = mapping(task);
+            middle = static_cast<uint32_t>(std::partition(begin, end, [&](uint32_t ref) {
+                return m.bin(&centers[3 * ref], bestAxis) < bestBin;
+            }) - refs.begin());
+            for (unsigned b = 0; b < binsFor(task); ++b) (b < bestBin ? left : right).add(bins[bestAxis * binCount + b]);
+        } else {
+            // too deep for the SAH or no usable bins (all centroids in one spot): halve along the
+            // widest centroid axis, which always terminates and keeps the depth bounded
+            int axis = 0;
+            for (int k = 1; k < 3; ++k) {
+                if (task.centroids.hi[k] - task.centroids.lo[k] > task.centroids.hi[axis] - task.centroids.lo[axis]) axis = k;
+            }
+            middle = task.begin + count / 2;
+            std::nth_element(begin, refs.begin() + middle, end, [&](uint32_t a, uint32_t b) {
+                return centers[3 * a + axis] < centers[3 * b + axis];
+            });
+            for (uint32_t r = task.begin; r < task.end; ++r) {
+                Bin& side = r < middle ? left : right;
+                side.bounds.grow(boxes[refs[r]]);
+                side.centroids.grow(&centers[3 * refs[r]]);
+            }
+        }
+
+        BvhNode& node = nodes[task.node];
+        std::copy(task.bounds.lo, task.bounds.lo + 3, node.boundsMin);
+        std::copy(task.bounds.hi, task.bounds.hi + 3, node.boundsMax);
+        node.first = static_cast<uint32_t>(nodes.size());
+        node.count = 0;
+        children[0] = {node.first, task.begin, middle, left.bounds, left.centroids, task.depth + 1};
+        children[1] = {node.first + 1, middle, task.end, right.bounds, right.centroids, task.depth + 1};
+        nodes.resize(nodes.size() + 2);
+        return true;
+    }
+};
+
+// a triangle, or the part of it that is left in a node after spatial splits
+struct Reference {
+    Bounds bounds;
+    uint32_t triangle;
+};
+
+// the boxes of the parts of triangle `v` below and above `plane` on `axis`, each clipped to
+// `box`, the reference's own box. a part the triangle doesn't reach comes back empty
+void splitTriangle(const float* const v[3], const Bounds& box, int axis, float plane, Bounds& left, Bounds& right) {
+    left = right = Bounds();
+    for (int i = 0; i < 3; ++i) {
+        const float* a = v[i];
+        const float* b = v[(i + 1) % 3];
+        if (a[axis] <= plane) left.grow(a);
+        if (a[axis] >= plane) right.grow(a);
+        if ((a[axis] < plane && b[axis] > plane) || (a[axis] > plane && b[axis] < plane)) {
+            float s = (plane - a[axis]) / (b[axis] - a[axis]);
+            float p[3];
+            for (int k = 0; k < 3; ++k) p[k] = a[k] + s * (b[k] - a[k]);
+            p[axis] = plane;
+            left.grow(p);
+            right.grow(p);
+        }
+    }
+    left.clip(box);
+    right.clip(box);
+}
+
+void splitReference(const TriangleGeometry& geometry, const Reference& ref, int axis, float plane, Bounds& left, Bounds& right) {
+    const uint32_t* tri = &geometry.indices[3 * ref.triangle];
+    const float* v[3] = {geometry.vertex(tri[0]), geometry.vertex(tri[1]), geometry.vertex(tri[2])};
+    splitTriangle(v, ref.bounds, axis, plane, left, right);
+}
+
+Bounds boundsOf(const std::vector<Reference>& refs) {
+    Bounds bounds;
+    for (const Reference& ref : refs) bounds.grow(ref.bounds);
+    return bounds;
+}
+
+// references that become the subtree under `node`. Each task owns its references, since
+// spatial splits make the children hold more of them than their parent
+struct SpatialTask {
+    uint32_t node = 0;
+    std::vector<Reference> refs;
+    Bounds bounds;
+    unsigned depth = 0;
+    size_t budget = 0;  // duplicates the subtree may still add
+};
+
+struct SpatialBin {
+    Bounds bounds;        // of the reference parts that fall in the bin
+    uint32_t entries = 0; // references that start in the bin
+    uint32_t exits = 0;   // references that end in it
+};
+
+// SBVH after Stich et al. 2009: every node takes the cheaper of the best binned object split
+// and, where that one's children overlap, the best spatial split. References straddling a
+// spatial split go to one side when duplicating them costs more than it saves. The budget is
+// handed down to the children in proportion to their size, so the tree doesn't depend on the
+// order in which subtrees are built.
+class SpatialBuilder {
+public:
+    SpatialBuilder(const TriangleGeometry& geometry, const BvhBuildOptions& options)
+        : geometry(geometry), options(options), binCount(std::clamp(options.bins, 2u, maxBins)) {}
+
+    // same two phases as Builder::build; leaf runs are in build order, see orderPrimitives
+    size_t build(std::vector<BvhNode>& nodes, std::vector<uint32_t>& primitives) {
+        size_t count = geometry.triangleCount;
+        SpatialTask root;
+        root.refs.resize(count);
+        parallelFor(0, count, [&](size_t t) {
+            Reference& ref = root.refs[t];
+            for (int k = 0; k < 3; ++k) ref.bounds.grow(geometry.vertex(geometry.indices[3 * t + k]));
+            ref.triangle = static_cast<uint32_t>(t);
+        }, 4096);
+        root.bounds = boundsOf(root.refs);
+        root.budget = static_cast<size_t>(std::max(0.0f, options.referenceBudget) * count);
+        rootArea = root.bounds.area();
+        nodes.assign(1, BvhNode());
+        const size_t threshold = std::max<size_t>(4096, count / (threadCount() * 8));
+
+        std::vector<SpatialTask> queue, subtrees;
+        queue.push_back(std::move(root));
+        for (size_t i = 0; i < queue.size(); ++i) {
+            SpatialTask task = std::move(queue[i]);
+            if (task.refs.size() <= threshold) {
+                subtrees.push_back(std::move(task));
+                continue;
+            }
+            SpatialTask children[2];
+            if (split(nodes, primitives, task, children, true)) {
+                queue.push_back(std::move(children[0]));
+                queue.push_back(std::move(children[1]));
+            }
+        }
+
+        std::sort(subtrees.begin(), subtrees.end(), [](const SpatialTask& a, const SpatialTask& b) {
+            return a.refs.size() > b.refs.size();
+        });
+        std::vector<std::vector<BvhNode>> localNodes(subtrees.size());
+        std::vector<std::vector<uint32_t>> localPrimitives(subtrees.size());
+        std::vector<uint32_t> targets(subtrees.size());
+        parallelFor(0, subtrees.size(), [&](size_t s) {
+            targets[s] = subtrees[s].node;
+            subtrees[s].node = 0;
+            localNodes[s].assign(1, BvhNode());
+            buildSerial(localNodes[s], localPrimitives[s], std::move(subtrees[s]));
+        });
+
+        // splice as in Builder::build, leaves also move their runs behind what is there
+        std::vector<size_t> nodeOffset(subtrees.size()), primitiveOffset(subtrees.size());
+        size_t totalNodes = nodes.size(), totalPrimitives = primitives.size();
+        for (size_t s = 0; s < subtrees.size(); ++s) {
+            nodeOffset[s] = totalNodes - 1;
+            totalNodes += localNodes[s].size() - 1;
+            primitiveOffset[s] = totalPrimitives;
+            totalPrimitives += localPrimitives[s].size();
+        }
+        nodes.resize(totalNodes);
+        primitives.resize(totalPrimitives);
+        parallelFor(0, subtrees.size(), [&](size_t s) {
+            auto relocate = [&](BvhNode node) {
+                node.first += static_cast<uint32_t>(node.count ? primitiveOffset[s] : nodeOffset[s]);
+                return node;
+            };
+            nodes[targets[s]] = relocate(localNodes[s][0]);
+            for (size_t n = 1; n < localNodes[s].size(); ++n) nodes[nodeOffset[s] + n] = relocate(localNodes[s][n]);
+            std::copy(localPrimitives[s].begin(), localPrimitives[s].end(), primitives.begin() + primitiveOffset[s]);
+            std::vector<BvhNode>().swap(localNodes[s]);
+            std::vector<uint32_t>().swap(localPrimitives[s]);
+        });
+        return spatialSplits;
+    }
+
+private:
+    struct ObjectSplit {
+        int axis = -1;
+        unsigned bin = 0;
+        float cost = inf;
+        Bounds left, right;
+    };
+
+    struct SpatialSplit {
+        int axis = -1;
+        float plane = 0.0f;
+        float cost = inf;
+        Bounds left, right;
+        uint32_t leftCount = 0, rightCount = 0;
+    };
+
+    const TriangleGeometry& geometry;
+    const BvhBuildOptions& options;
+    const unsigned binCount;
+    float rootArea = 0.0f;
+    std::atomic<size_t> spatialSplits{0};
+
+    unsigned binsFor(size_t count) const {
+        return static_cast<unsigned>(std::min<size_t>(binCount, std::max<size_t>(4, count)));
+    }
+
+    // runs bin(begin, end, bins) over blocks of references, on all cores when asked to, and
+    // merges the per-block bins with merge(into, from)
+    template <typename BinType, typename BinRange, typename Merge>
+    void binBlocks(size_t count, bool parallel, std::vector<BinType>& bins, BinRange&& bin, Merge&& merge) const {
+        const size_t block = 1 << 16;
+        std::fill(bins.begin(), bins.end(), BinType());
+        if (!parallel || count <= block) {
+            bin(0, count, bins.data());
+            return;
+        }
+        std::vector<std::vector<BinType>> partial((count + block - 1) / block);
+        parallelFor(0, partial.size(), [&](size_t b) {
+            partial[b].resize(bins.size());
+            bin(b * block, std::min(count, (b + 1) * block), partial[b].data());
+        });
+        for (const auto& p : partial) {
+            for (size_t i = 0; i < bins.size(); ++i) merge(bins[i], p[i]);
+        }
+    }
+
+    static float center(const Reference& ref, int axis) {
+        return 0.5f * (ref.bounds.lo[axis] + ref.bounds.hi[axis]);
+    }
+
+    ObjectSplit findObjectSplit(const SpatialTask& task, const Bounds& centroids, bool parallel) const {
+        ObjectSplit best;
+        unsigned used = binsFor(task.refs.size());
+        float lo[3], scale[3];
+        for (int k = 0; k < 3; ++k) {
+            float extent = centroids.hi[k] - centroids.lo[k];
+            lo[k] = centroids.lo[k];
+            scale[k] = extent > 0.0f ? used / extent : 0.0f;
+        }
+        std::vector<Bin> bins(3 * binCount);
+        binBlocks(task.refs.size(), parallel, bins, [&](size_t begin, size_t end, Bin* out) {
+            for (size_t r = begin; r < end; ++r) {
+                const Reference& ref = task.refs[r];
+                for (int axis = 0; axis < 3; ++axis) {
+                    float x = (center(ref, axis) - lo[axis]) * scale[axis];
+                    Bin& bin = out[axis * binCount + std::min(used - 1, static_cast<unsigned>(std::max(0.0f, x)))];
+                    bin.bounds.grow(ref.bounds);
+                    bin.count++;
+                }
+            }
+        }, [](Bin& into, const Bin& from) { into.add(from); });
+
+        float area = task.bounds.area();
+        float rightArea[maxBins];
+        uint32_t rightCount[maxBins];
+        for (int axis = 0; axis < 3; ++axis) {
+            if (centroids.hi[axis] <= centroids.lo[axis]) continue;
+            const Bin* axisBins = &bins[axis * binCount];
+            Bounds right;
+            uint32_t n = 0;
+            for (unsigned b = used - 1; b > 0; --b) {
+                right.grow(axisBins[b].bounds);
+                n += axisBins[b].count;
+                rightArea[b] = right.area();
+                rightCount[b] = n;
+            }
+            Bounds left;
+            n = 0;
+            for (unsigned b = 1; b < used; ++b) {
+                left.grow(axisBins[b - 1].bounds);
+                n += axisBins[b - 1].count;
+                if (n == 0 || rightCount[b] == 0) continue;
+                float cost = options.traversalCost +
+                             options.intersectionCost * (left.area() * n + rightArea[b] * rightCount[b]) / area;
+                if (cost < best.cost) {
+                    best.cost = cost;
+                    best.axis = axis;
+                    best.bin = b;
+                }
+            }
+        }
+        if (best.axis >= 0) {
+            for (unsigned b = 0; b < used; ++b) {
+                (b < best.bin ? best.left : best.right).grow(bins[best.axis * binCount + b].bounds);
+            }
+        }
+        return best;
+    }
+
+    bool objectSide(const ObjectSplit& split, const Bounds& centroids, unsigned used, const Reference& ref) const {
+        float extent = centroids.hi[split.axis] - centroids.lo[split.axis];
+        float x = (center(ref, split.axis) - centroids.lo[split.axis]) * (used / extent);
+        return std::min(used - 1, static_cast<unsigned>(std::max(0.0f, x))) < split.bin;
+    }
+
+    // bins the node's box itself, chopping every reference at the borders of the bins it spans
+    SpatialSplit findSpatialSplit(const SpatialTask& task, bool parallel) const {
+        SpatialSplit best;
+        uint32_t count = static_cast<uint32_t>(task.refs.size());
+        unsigned used = std::min(spatialBins, binsFor(count));
+        float lo[3], width[3], scale[3];
+        for (int k = 0; k < 3; ++k) {
+            float extent = task.bounds.hi[k] - task.bounds.lo[k];
+            lo[k] = task.bounds.lo[k];
+            width[k] = extent / used;
+            scale[k] = extent > 0.0f ? used / extent : 0.0f;
+        }
+        auto binOf = [&](float x, int axis) {
+            return std::min(used - 1, static_cast<unsigned>(std::max(0.0f, (x - lo[axis]) * scale[axis])));
+        };
+
+        std::vector<SpatialBin> bins(3 * binCount);
+        binBlocks(count, parallel, bins, [&](size_t begin, size_t end, SpatialBin* out) {
+            for (size_t r = begin; r < end; ++r) {
+                const Reference& ref = task.refs[r];
+                const uint32_t* tri = &geometry.indices[3 * ref.triangle];
+                const float* v[3] = {geometry.vertex(tri[0]), geometry.vertex(tri[1]), geometry.vertex(tri[2])};
+                for (int axis = 0; axis < 3; ++axis) {
+                    if (scale[axis] == 0.0f) continue;
+                    SpatialBin* axisBins = out + axis * binCount;
+                    Bounds part = ref.bounds;
+                    unsigned first = binOf(part.lo[axis], axis), last = binOf(part.hi[axis], axis);
+                    for (unsigned b = first; b < last; ++b) {
+                        Bounds below, above;
+                        splitTriangle(v, part, axis, lo[axis] + (b + 1) * width[axis], below, above);
+                        axisBins[b].bounds.grow(below);
+                        part = above;
+                    }
+                    axisBins[last].bounds.grow(part);
+                    axisBins[first].entries++;
+                    axisBins[last].exits++;
+                }
+            }
+        }, [](SpatialBin& into, const SpatialBin& from) {
+            into.bounds.grow(from.bounds);
+            into.entries += from.entries;
+            into.exits += from.exits;
+        });
+
+        float area = task.bounds.area();
+        Bounds rightBounds[maxBins];
+        uint32_t rightCount[maxBins];
+        for (int axis = 0; axis < 3; ++axis) {
+            if (scale[axis] == 0.0f) continue;
+            const SpatialBin* axisBins = &bins[axis * binCount];
+            Bounds right;
+            uint32_t n = 0;
+            for (unsigned b = used - 1; b > 0; --b) {
+                right.grow(axisBins[b].bounds);
+                n += axisBins[b].exits;
+                rightBounds[b] = right;
+                rightCount[b] = n;
+            }
+            Bounds left;
+            n = 0;
+            for (unsigned b = 1; b < used; ++b) {
+                left.grow(axisBins[b - 1].bounds);
+                n += axisBins[b - 1].entries;
+                // both sides must shrink, and the duplicates must fit the budget
+                if (n == 0 || rightCount[b] == 0 || n >= count || rightCount[b] >= count) continue;
+                if (n + rightCount[b] - count > task.budget) continue;
+                float cost = options.traversalCost +
+                             options.intersectionCost * (left.area() * n + rightBounds[b].area() * rightCount[b]) / area;
+                if (cost < best.cost) {
+                    best = {axis, lo[axis] + b * width[axis], cost, left, rightBounds[b], n, rightCount[b]};
+                }
+            }
+        }
+        return best;
+    }
+
+    // sends every reference to the side it lies on; straddling ones are split, or moved whole to
+    // one side when that is cheaper (unsplitting)
+    void partitionSpatial(SpatialTask& task, const SpatialSplit& split, std::vector<Reference>& left,
+                          std::vector<Reference>& right) const {
+        Bounds leftBounds = split.left, rightBounds = split.right;
+        float leftCount = static_cast<float>(split.leftCount), rightCount = static_cast<float>(split.rightCount);
+        for (const Reference& ref : task.refs) {
+            if (ref.bounds.hi[split.axis] <= split.plane) {
+                left.push_back(ref);
+                continue;
+            }
+            if (ref.bounds.lo[split.axis] >= split.plane) {
+                right.push_back(ref);
+                continue;
+            }
+            Bounds leftWhole = leftBounds, rightWhole = rightBounds;
+            leftWhole.grow(ref.bounds);
+            rightWhole.grow(ref.bounds);
+            float duplicated = leftBounds.area() * leftCount + rightBounds.area() * rightCount;
+            float toLeft = leftWhole.area() * leftCount + rightBounds.area() * (rightCount - 1.0f);
+            float toRight = leftBounds.area() * (leftCount - 1.0f) + rightWhole.area() * rightCount;
+            if (toLeft < duplicated && toLeft <= toRight) {
+                left.push_back(ref);
+                leftBounds = leftWhole;
+                rightCount -= 1.0f;
+            } else if (toRight < duplicated) {
+                right.push_back(ref);
+                rightBounds = rightWhole;
+                leftCount -= 1.0f;
+            } else {
+                Bounds below, above;
+                splitReference(geometry, ref, split.axis, split.plane, below, above);
+                if (!below.empty()) left.push_back({below, ref.triangle});
+                if (!above.empty()) right.push_back({above, ref.triangle});
+                if (below.empty() && above.empty()) left.push_back(ref);
+            }
+        }
+    }
+
+    void buildSerial(std::vector<BvhNode>& nodes, std::vector<uint32_t>& primitives, SpatialTask root) {
+        std::vector<SpatialTask> stack;
+        stack.push_back(std::move(root));
+        while (!stack.empty()) {
+            SpatialTask task = std::move(stack.back());
+            stack.pop_back();
+            SpatialTask children[2];
+            if (split(nodes, primitives, task, children, false)) {
+                stack.push_back(std::move(children[1]));
+                stack.push_back(std::move(children[0]));
+            }
+        }
+    }
+
+    // Builder::split for references: writes a leaf, or an interior node whose children's
+    // references come back in `children`
+    bool split(std::vector<BvhNode>& nodes, std::vector<uint32_t>& primitives, SpatialTask& task,
+               SpatialTask children[2], bool parallel) {
+        uint32_t count = static_cast<uint32_t>(task.refs.size());
+        BvhNode& node = nodes[task.node];
+        std::copy(task.bounds.lo, task.bounds.lo + 3, node.boundsMin);
+        std::copy(task.bounds.hi, task.bounds.hi + 3, node.boundsMax);
+        auto makeLeaf = [&]() {
+            node.first = static_cast<uint32_t>(primitives.size());
+            node.count = count;
+            for (const Reference& ref : task.refs) primitives.push_back(ref.triangle);
+            return false;
+        };
+        if (count <= 1) return makeLeaf();
+
+        Bounds centroids;
+        for (const Reference& ref : task.refs) {
+            float c[3] = {center(ref, 0), center(ref, 1), center(ref, 2)};
+            centroids.grow(c);
+        }
+        ObjectSplit object;
+        SpatialSplit spatial;
+        if (task.depth < bvhMaxDepth / 2) {
+            object = findObjectSplit(task, centroids, parallel);
+            // small nodes rarely gain from a spatial split over making leaves, and chopping their
+            // references at every bin border is where the time goes
+            Bounds overlap = object.left;
+            overlap.clip(object.right);
+            bool overlaps = object.axis < 0 || (!overlap.empty() && overlap.area() > options.spatialOverlap * rootArea);
+            if (task.budget > 0 && count > 2 * options.maxLeafSize && overlaps) {
+                spatial = findSpatialSplit(task, parallel);
+            }
+        }
+
+        float leafCost = options.intersectionCost * count;
+        bool useSpatial = spatial.axis >= 0 && spatial.cost < object.cost && spatial.cost < leafCost;
+        bool worthIt = useSpatial || (object.axis >= 0 && object.cost < leafCost);
+        if (!worthIt && count <= options.maxLeafSize) return makeLeaf();
+
+        std::vector<Reference> left, right;
+        if (useSpatial) {
+            partitionSpatial(task, spatial, left, right);
+            if (left.empty() || right.empty()) {
+                useSpatial = false;
+                left.clear();
+                right.clear();
+            }
+        }
+        if (useSpatial) {
+            spatialSplits++;
+        } else if (object.axis >= 0) {
+            unsigned used = binsFor(count);
+            auto middle = std::partition(task.refs.begin(), task.refs.end(), [&](const Reference& ref) {
+                return objectSide(object, centroids, used, ref);
+            });
+            left.assign(task.refs.begin(), middle);
+            right.assign(middle, task.refs.end());
+        } else {
+            // too deep for the SAH or all centroids in one spot: halve along the widest centroid axis
+            int axis = 0;
+            for (int k = 1; k < 3; ++k) {
+                if (centroids.hi[k] - centroids.lo[k] > centroids.hi[axis] - centroids.lo[axis]) axis = k;
+            }
+            auto middle = task.refs.begin() + count / 2;
+            std::nth_element(task.refs.begin(), middle, task.refs.end(), [&](const Reference& a, const Reference& b) {
+                return center(a, axis) < center(b, axis);
+            });
+            left.assign(task.refs.begin(), middle);
+            right.assign(middle, task.refs.end());
+        }
+        std::vector<Reference>().swap(task.refs);
+
+        size_t total = left.size() + right.size();
+        size_t budget = task.budget - std::min(task.budget, total - count);
+        size_t leftBudget = static_cast<size_t>(static_cast<double>(budget) * left.size() / total);
+
+        node.first = static_cast<uint32_t>(nodes.size());
+        node.count = 0;
+        children[0].node = node.first;
+        children[1].node = node.first + 1;
+        children[0].budget = leftBudget;
+        children[1].budget = budget - leftBudget;
+        children[0].bounds = boundsOf(left);
+        children[1].bounds = boundsOf(right);
+        children[0].refs = std::move(left);
+        children[1].refs = std::move(right);
+        children[0].depth = children[1].depth = task.depth + 1;
+        nodes.resize(nodes.size() + 2);
+        return true;
+    }
+};
+
+// lays the leaf runs out in depth-first order, so that every subtree owns a contiguous run
+void orderPrimitives(std::vector<BvhNode>& nodes, std::vector<uint32_t>& primitives) {
+    std::vector<uint32_t> ordered;
+    ordered.reserve(primitives.size());
+    std::vector<uint32_t> stack = {0};
+    while (!stack.empty()) {
+        BvhNode& node = nodes[stack.back()];
+        stack.pop_back();
+        if (node.count) {
+            uint32_t first = static_cast<uint32_t>(ordered.size());
+            ordered.insert(ordered.end(), primitives.begin() + node.first, primitives.begin() + node.first + node.count);
+            node.first = first;
+        } else if (nodes.size() > 1) {
+            stack.push_back(node.first + 1);
+            stack.push_back(node.first);
+        }
+    }
+    primitives.swap(ordered);
+}
+
+float area(const BvhNode& node) {
+    float dx = node.boundsMax[0] - node.boundsMin[0];
+    float dy = node.boundsMax[1] - node.boundsMin[1];
+    float dz = node.boundsMax[2] - node.boundsMin[2];
+    if (dx < 0.0f || dy < 0.0f || dz < 0.0f) return 0.0f;
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+}
+
+TriangleGeometry triangleGeometry(const Mesh& mesh, const float* primitiveNormals) {
+    TriangleGeometry geometry;
+    geometry.vertices = mesh.vertices.data();
+    geometry.indices = mesh.indices.data();
+    geometry.triangleCount = mesh.indices.size() / 3;
+    geometry.primitiveData = primitiveNormals;
+    geometry.primitiveDataStride = primitiveNormals ? 9 * sizeof(float) : 0;
+    return geometry;
+}
+
+Bvh buildBvh(const TriangleGeometry& geometry, const BvhBuildOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    Bvh bvh;
+    if (geometry.triangleCount == 0) {
+        // one empty leaf whose inverted bounds no ray enters
+        BvhNode empty = {{inf, inf, inf}, 0, {-inf, -inf, -inf}, 0};
+        bvh.nodes.assign(1, empty);
+    } else if (options.spatialSplits == SpatialSplits::On ||
+               (options.spatialSplits == SpatialSplits::Auto && prefersSpatialSplits(geometry))) {
+        SpatialBuilder builder(geometry, options);
+        bvh.stats.spatialSplits = builder.build(bvh.nodes, bvh.primitives);
+        orderPrimitives(bvh.nodes, bvh.primitives);
+    } else {
+        Builder builder(geometry, options, bvh.primitives);
+        builder.build(bvh.nodes);
+    }
+    if (options.leafFormat == LeafFormat::Transformed) {
+        bvh.transforms = triangleTransforms(bvh.primitives.data(), bvh.primitives.size(), geometry);
+    }
+    bvh.stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    updateBvhStats(bvh, options);
+    return bvh;
+}
+
+Bvh buildBvh(const float* boxes, size_t count, const BvhBuildOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    Bvh bvh;
+    if (count == 0) {
+        BvhNode empty = {{inf, inf, inf}, 0, {-inf, -inf, -inf}, 0};
+        bvh.nodes.assign(1, empty);
+    } else {
+        Builder builder(boxes, count, options, bvh.primitives);
+        builder.build(bvh.nodes);
+    }
+    bvh.stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    updateBvhStats(bvh, options);
+    return bvh;
+}
+
+void updateBvhStats(Bvh& bvh, const BvhBuildOptions& options) {
+    BvhBuildStats& stats = bvh.stats;
+    stats.nodes = bvh.nodes.size();
+    stats.leaves = 0;
+    stats.maxDepth = 0;
+    std::vector<std::pair<uint32_t, unsigned>> stack = {{0, 0}};
+    while (!stack.empty()) {
+        auto [index, depth] = stack.back();
+        stack.pop_back();
+        stats.maxDepth = std::max(stats.maxDepth, depth);
+        const BvhNode& node = bvh.nodes[index];
+        if (node.count) {
+            stats.leaves++;
+        } else if (bvh.nodes.size() > 1) {
+            stack.push_back({node.first, depth + 1});
+            stack.push_back({node.first + 1, depth + 1});
+        }
+    }
+    stats.averageLeafSize = stats.leaves ? static_cast<double>(bvh.primitives.size()) / stats.leaves : 0.0;
+    stats.sahCost = sahCost(bvh, options);
+    stats.references = bvh.primitives.size();
+}
+
+TriangleTransform triangleTransform(const float a[3], const float b[3], const float c[3]) {
+    // the inverse of the columns e1, e2, n with n = e1 x e2 has the rows e2 x n, n x e1 and n,
+    // all over |n|^2. in double, so thin triangles keep their precision
+    double e1[3], e2[3];
+    for (int k = 0; k < 3; ++k) {
+        e1[k] = double(b[k]) - a[k];
+        e2[k] = double(c[k]) - a[k];
+    }
+    auto cross = [](const double* x, const double* y, double* out) {
+        out[0] = x[1] * y[2] - x[2] * y[1];
+        out[1] = x[2] * y[0] - x[0] * y[2];
+        out[2] = x[0] * y[1] - x[1] * y[0];
+    };
+    double n[3], rows[3][3];
+    cross(e1, e2, n);
+    double det = n[0] * n[0] + n[1] * n[1] + n[2] * n[2];
+    TriangleTransform m = {};
+    if (!(det > 0.0) || !std::isfinite(det)) {
+        m.rows[2][3] = 1.0f;  // z is 1 everywhere, rays never cross 0
+        return m;
+    }
+    cross(e2, n, rows[0]);
+    cross(n, e1, rows[1]);
+    std::copy(n, n + 3, rows[2]);
+    for (int r = 0; r < 3; ++r) {
+        double offset = 0.0;
+        for (int k = 0; k < 3; ++k) {
+            m.rows[r][k] = static_cast<float>(rows[r][k] / det);
+            offset -= rows[r][k] / det * a[k];
+        }
+        m.rows[r][3] = static_cast<float>(offset);
+    }
+    return m;
+}
+
+std::vector<TriangleTransform> triangleTransforms(const uint32_t* primitives, size_t count, const TriangleGeometry& geometry) {
+    std::vector<TriangleTransform> transforms(count);
+    parallelFor(0, count, [&](size_t i) {
+        const uint32_t* tri = &geometry.indices[3 * primitives[i]];
+        transforms[i] = triangleTransform(geometry.vertex(tri[0]), geometry.vertex(tri[1]), geometry.vertex(tri[2]));
+    }, 4096);
+    return transforms;
+}
+
+double thinTriangleShare(const TriangleGeometry& geometry, float aspect) {
+    size_t count = geometry.triangleCount, block = 1 << 16;
+    std::vector<std::pair<double, double>> partial((count + block - 1) / block); // thin, all
+    parallelFor(0, partial.size(), [&](size_t b) {
+        for (size_t t = b * block; t < std::min(count, (b + 1) * block); ++t) {
+            const uint32_t* tri = &geometry.indices[3 * t];
+            const float* v[3] = {geometry.vertex(tri[0]), geometry.vertex(tri[1]), geometry.vertex(tri[2])};
+            Bounds box;
+            float longest = 0.0f, e1[3], e2[3];
+            for (int i = 0; i < 3; ++i) {
+                box.grow(v[i]);
+                float length = 0.0f;
+                for (int k = 0; k < 3; ++k) length += (v[(i + 1) % 3][k] - v[i][k]) * (v[(i + 1) % 3][k] - v[i][k]);
+                longest = std::max(longest, length);
+            }
+            for (int k = 0; k < 3; ++k) {
+                e1[k] = v[1][k] - v[0][k];
+                e2[k] = v[2][k] - v[0][k];
+            }
+            float cx = e1[1] * e2[2] - e1[2] * e2[1], cy = e1[2] * e2[0] - e1[0] * e2[2], cz = e1[0] * e2[1] - e1[1] * e2[0];
+            // height onto the longest edge is twice the area over its length, so the aspect
+            // ratio is longest^2 / (2 * area)
+            float twiceArea = std::sqrt(cx * cx + cy * cy + cz * cz);
+            double a = box.area();
+            partial[b].second += a;
+            if (longest > aspect * twiceArea) partial[b].first += a;
+        }
+    });
+    double thin = 0.0, all = 0.0;
+    for (const auto& p : partial) {
+        thin += p.first;
+        all += p.second;
+    }
+    return all > 0.0 ? thin / all : 0.0;
+}
+
+bool prefersSpatialSplits(const TriangleGeometry& geometry) {
+    return thinTriangleShare(geometry) > 0.2;
+}
+
+double sahCost(const Bvh& bvh, const BvhBuildOptions& options) {
+    double rootArea = area(bvh.nodes[0]);
+    if (rootArea <= 0.0) return 0.0;
+    double cost = 0.0;
+    for (const BvhNode& node : bvh.nodes) {
+        double relative = area(node) / rootArea;
+        cost += relative * (node.count ? options.intersectionCost * node.count : options.traversalCost);
+    }
+    return cost;
+}
+
+namespace {
+
+// the traversal, with counting compiled in only where asked for. Any stops at the first hit,
+// in whatever order, for shadow rays
+template <bool Count, bool Any = false>
+bool traverse(const BvhView& bvh, const TriangleGeometry& geometry, const Ray& ray, Hit& hit, TraversalCounters* counters) {
+    bool found = false;
+    walkBvh(bvh.nodes, ray, [&](const BvhNode& node, float& tMax) {
+        if constexpr (Count) {
+            counters->nodes++;
+            counters->triangles += node.count;
+        }
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            float t, u, v;
+            bool test;
+            if (bvh.transforms) {
+                test = intersectTriangle(bvh.transforms[i], ray, tMax, t, u, v);
+            } else {
+                const uint32_t* tri = &geometry.indices[3 * bvh.primitives[i]];
+                test = intersectTriangle(geometry.vertex(tri[0]), geometry.vertex(tri[1]), geometry.vertex(tri[2]), ray, tMax, t, u, v);
+            }
+            if (test) {
+                tMax = t;
+                hit = {t, bvh.primitives[i], u, v};
+                found = true;
+                if constexpr (Any) return true;
+            }
+        }
+        return false;
+    });
+    return found;
+}
+
+}
+
+bool intersect(const Bvh& bvh, const TriangleGeometry& geometry, const Ray& ray, Hit& hit) {
+    return traverse<false>(bvh, geometry, ray, hit, nullptr);
+}
+
+bool intersect(const Bvh& bvh, const TriangleGeometry& geometry, const Ray& ray, Hit& hit, TraversalCounters& counters) {
+    return traverse<true>(bvh, geometry, ray, hit, &counters);
+}
+
+bool intersect(const BvhView& bvh, const TriangleGeometry& geometry, const Ray& ray, Hit& hit) {
+    return traverse<false>(bvh, geometry, ray, hit, nullptr);
+}
+
+bool occluded(const BvhView& bvh, const TriangleGeometry& geometry, const Ray& ray) {
+    Hit hit;
+    return traverse<false, true>(bvh, geometry, ray, hit, nullptr);
+}
@@ -0,0 +1,257 @@
+#pragma once
+
+#include "Mesh.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+// The inputs of an MTL::AccelerationStructureTriangleGeometryDescriptor, so the CPU structures
+// are built from exactly what the Metal one gets. The primitive data isn't used for building,
+// it is what a hit hands back for shading, like intersection.primitive_data in compute_kernel.
+struct TriangleGeometry {
+    const float* vertices = nullptr;       // x, y, z at the start of every vertexStride bytes
+    size_t vertexStride = 3 * sizeof(float);
+    const uint32_t* indices = nullptr;     // three per triangle
+    size_t triangleCount = 0;
+    const void* primitiveData = nullptr;   // primitiveDataStride bytes per triangle, may be null
+    size_t primitiveDataStride = 0;
+
+    const float* vertex(uint32_t index) const {
+        return reinterpret_cast<const float*>(reinterpret_cast<const char*>(vertices) + index * vertexStride);
+    }
+
+    const void* primitive(uint32_t triangle) const {
+        return primitiveData ? static_cast<const char*>(primitiveData) + triangle * primitiveDataStride : nullptr;
+    }
+};
+
+// a Mesh as geometry, with optional per-primitive normals (see primitiveNormals) as primitive data
+TriangleGeometry triangleGeometry(const Mesh& mesh, const float* primitiveNormals = nullptr);
+
+struct Ray {
+    float origin[3];
+    float tMin = 0.0f;
+    float direction[3];
+    float tMax = std::numeric_limits<float>::infinity();
+};
+
+// u and v weigh the triangle's second and third vertex, like triangle_barycentric_coord in Metal
+struct Hit {
+    float t = std::numeric_limits<float>::infinity();
+    uint32_t triangle = UINT32_MAX;
+    float u = 0.0f;
+    float v = 0.0f;
+};
+
+// Möller-Trumbore, both faces, hits strictly inside (tMin, tMax)
+inline bool intersectTriangle(const float a[3], const float b[3], const float c[3], const Ray& ray, float tMax,
+                              float& t, float& u, float& v) {
+    float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+    float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+    const float* d = ray.direction;
+    float p[3] = {d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0]};
+    float det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+    if (det == 0.0f) return false;
+    float inv = 1.0f / det;
+    float s[3] = {ray.origin[0] - a[0], ray.origin[1] - a[1], ray.origin[2] - a[2]};
+    u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv;
+    if (u < 0.0f || u > 1.0f) return false;
+    float q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0]};
+    v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv;
+    if (v < 0.0f || u + v > 1.0f) return false;
+    t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+    return t > ray.tMin && t < tMax;
+}
+
+// Woop's unit triangle test, after Baldwin and Weber: the affine map that takes a triangle's
+// second and third vertex directions to x and y and its normal to z, so the first vertex lands
+// on the origin and the triangle on the unit one in z = 0. A ray mapped by it hits where z
+// crosses 0, at barycentrics x and y. 48 bytes per triangle against three fetched vertices,
+// and no edges or cross products to compute per test.
+struct TriangleTransform {
+    float rows[3][4];  // u, v and z, each a dot product with the point plus the last entry
+};
+
+// the transform of triangle (a, b, c); degenerate triangles get one that no ray hits
+TriangleTransform triangleTransform(const float a[3], const float b[3], const float c[3]);
+
+// the same hits as intersectTriangle, up to rounding
+inline bool intersectTriangle(const TriangleTransform& m, const Ray& ray, float tMax, float& t, float& u, float& v) {
+    const float* o = ray.origin;
+    const float* d = ray.direction;
+    const float* z = m.rows[2];
+    float oz = z[0] * o[0] + z[1] * o[1] + z[2] * o[2] + z[3];
+    float dz = z[0] * d[0] + z[1] * d[1] + z[2] * d[2];
+    t = -oz / dz;
+    if (!(t > ray.tMin && t < tMax)) return false;
+    const float* x = m.rows[0];
+    u = x[0] * o[0] + x[1] * o[1] + x[2] * o[2] + x[3] + t * (x[0] * d[0] + x[1] * d[1] + x[2] * d[2]);
+    if (u < 0.0f || u > 1.0f) return false;
+    const float* y = m.rows[1];
+    v = y[0] * o[0] + y[1] * o[1] + y[2] * o[2] + y[3] + t * (y[0] * d[0] + y[1] * d[1] + y[2] * d[2]);
+    return v >= 0.0f && u + v <= 1.0f;
+}
+
+// 32 bytes, children of an interior node are stored next to each other
+struct BvhNode {
+    float boundsMin[3];
+    uint32_t first;   // interior: index of the left child, the right one follows. leaf: first entry in Bvh::primitives
+    float boundsMax[3];
+    uint32_t count;   // triangles in a leaf, 0 for interior nodes
+};
+
+// deeper than this the builder only makes balanced splits, so traversal stacks of bvhMaxDepth
+// entries are always enough
+const unsigned bvhMaxDepth = 64;
+
+// Spatial splits (SBVH) cut a node with a plane and put a triangle that straddles it in both
+// children, each with the box of its own part. Long, thin triangles then stop inflating every
+// box above them, at the price of more references and a slower build.
+enum class SpatialSplits { Off, On, Auto };  // Auto: On where prefersSpatialSplits() says so
+
+// what leaves test against: the mesh's vertices, or a TriangleTransform per primitive entry
+// stored with the tree
+enum class LeafFormat { VertexFetch, Transformed };
+
+struct BvhBuildOptions {
+    unsigned bins = 32;             // SAH candidates per axis are the bin borders, at most 256
+    unsigned maxLeafSize = 8;       // larger ranges are split even when the SAH says otherwise
+    float traversalCost = 1.0f;     // SAH cost of visiting a node, relative to ...
+    float intersectionCost = 1.0f;  // ... testing one triangle
+    SpatialSplits spatialSplits = SpatialSplits::Off;
+    float referenceBudget = 0.3f;   // duplicated references allowed, as a fraction of the triangles
+    float spatialOverlap = 1e-5f;   // spatial splits are tried where the best object split's children
+                                    // overlap by more than this fraction of the root's area
+    LeafFormat leafFormat = LeafFormat::VertexFetch;
+};
+
+struct BvhBuildStats {
+    double seconds = 0.0;
+    size_t nodes = 0;
+    size_t leaves = 0;
+    unsigned maxDepth = 0;
+    double averageLeafSize = 0.0;
+    double sahCost = 0.0;
+    size_t references = 0;     // entries in Bvh::primitives, more than the triangles after spatial splits
+    size_t spatialSplits = 0;  // interior nodes that were split spatially
+};
+
+struct Bvh {
+    std::vector<BvhNode> nodes;       // root first
+    std::vector<uint32_t> primitives; // triangle indices, every subtree owns a contiguous run
+    std::vector<TriangleTransform> transforms;  // one per primitive entry with LeafFormat::Transformed, else empty
+    BvhBuildStats stats;
+};
+
+// a tree in memory owned elsewhere, such as a mapped cache file, for the traversal
+struct BvhView {
+    const BvhNode* nodes = nullptr;
+    size_t nodeCount = 0;
+    const uint32_t* primitives = nullptr;
+    size_t primitiveCount = 0;
+    const TriangleTransform* transforms = nullptr;  // primitiveCount of them, or null for vertex fetch
+
+    BvhView() = default;
+    BvhView(const Bvh& bvh)
+        : nodes(bvh.nodes.data()), nodeCount(bvh.nodes.size()), primitives(bvh.primitives.data()),
+          primitiveCount(bvh.primitives.size()), transforms(bvh.transforms.empty() ? nullptr : bvh.transforms.data()) {}
+};
+
+// Top-down binned SAH build. Large ranges are binned and split on all cores one at a time,
+// once there are enough independent subtrees they are built in parallel and spliced in.
+Bvh buildBvh(const TriangleGeometry& geometry, const BvhBuildOptions& options = {});
+// the same over `count` boxes of anything, such as instances, given as min x, y, z, max x, y, z
+// each; primitives are then box indices, and spatial splits are never made
+Bvh buildBvh(const float* boxes, size_t count, const BvhBuildOptions& options = {});
+
+// Share of the summed triangle box areas that belongs to thin triangles, whose longest edge is
+// more than `aspect` times the height onto it. Thin triangles that are also large are what makes
+// object splits overlap.
+double thinTriangleShare(const TriangleGeometry& geometry, float aspect = 8.0f);
+// whether a mesh is worth spatial splits, from its thinTriangleShare
+bool prefersSpatialSplits(const TriangleGeometry& geometry);
+
+// the TriangleTransform of every entry of `primitives`, on all cores
+std::vector<TriangleTransform> triangleTransforms(const uint32_t* primitives, size_t count, const TriangleGeometry& geometry);
+
+// recomputes bvh.stats from the tree, all but the build time and the spatial split count
+void updateBvhStats(Bvh& bvh, const BvhBuildOptions& options = {});
+
+// expected cost of a random ray that hits the root, with the option's traversal and intersection costs
+double sahCost(const Bvh& bvh, const BvhBuildOptions& options = {});
+
+// work done by traversals, summed over as many rays as the caller likes
+struct TraversalCounters {
+    uint64_t nodes = 0;      // nodes entered, interior and leaves
+    uint64_t triangles = 0;  // triangle tests
+};
+
+// entry distance of the ray into the node's box, false if it misses within [tMin, tMax]
+inline bool slab(const BvhNode& node, const float origin[3], const float inverse[3], float tMin, float tMax, float& tEnter) {
+    for (int k = 0; k < 3; ++k) {
+        float t0 = (node.boundsMin[k] - origin[k]) * inverse[k];
+        float t1 = (node.boundsMax[k] - origin[k]) * inverse[k];
+        // near and far by the direction, not by value, so the inverted box of an empty tree
+        // stays empty
+        if (inverse[k] < 0.0f) std::swap(t0, t1);
+        tMin = std::max(tMin, t0);
+        tMax = std::min(tMax, t1);
+    }
+    tEnter = tMin;
+    return tMin <= tMax;
+}
+
+// The ordered walk of a binary tree that every traversal over BvhNodes shares: nearer child
+// first, the other one waiting on the stack with its entry distance until the closest hit is
+// nearer. visit(node, tMax) is called on every node entered, interior ones included; on a leaf
+// it tests what the leaf holds, lowers tMax to any closer hit, and returns true to end the walk.
+template <typename Visit>
+void walkBvh(const BvhNode* nodes, const Ray& ray, Visit&& visit) {
+    float inverse[3] = {1.0f / ray.direction[0], 1.0f / ray.direction[1], 1.0f / ray.direction[2]};
+    float tMax = ray.tMax, tEnter;
+    if (!slab(nodes[0], ray.origin, inverse, ray.tMin, tMax, tEnter)) return;
+
+    struct Entry {
+        uint32_t node;
+        float t;
+    };
+    Entry stack[bvhMaxDepth];
+    unsigned size = 0;
+    uint32_t index = 0;
+    for (;;) {
+        const BvhNode& node = nodes[index];
+        if (visit(node, tMax)) return;
+        if (!node.count) {
+            float tLeft, tRight;
+            bool left = slab(nodes[node.first], ray.origin, inverse, ray.tMin, tMax, tLeft);
+            bool right = slab(nodes[node.first + 1], ray.origin, inverse, ray.tMin, tMax, tRight);
+            if (left && right) {
+                // nearer child first, the other one waits with its entry distance
+                bool leftFirst = tLeft <= tRight;
+                stack[size++] = {leftFirst ? node.first + 1 : node.first, leftFirst ? tRight : tLeft};
+                index = leftFirst ? node.first : node.first + 1;
+                continue;
+            }
+            if (left || right) {
+                index = left ? node.first : node.first + 1;
+                continue;
+            }
+        }
+        // next waiting node that can still beat the closest hit
+        while (size > 0 && stack[size - 1].t > tMax) --size;
+        if (size == 0) return;
+        index = stack[--size].node;
+    }
+}
+
+// closest hit, false if the ray misses everything within its interval
+bool intersect(const Bvh& bvh, const TriangleGeometry& geometry, const Ray& ray, Hit& hit);
+// the same, adding its work to `counters`
+bool intersect(const Bvh& bvh, const TriangleGeometry& geometry, const Ray& ray, Hit& hit, TraversalCounters& counters);
+bool intersect(const BvhView& bvh, const TriangleGeometry& geometry, const Ray& ray, Hit& hit);
+// whether anything is hit within the ray's interval, stopping at the first triangle found
+bool occluded(const BvhView& bvh, const TriangleGeometry& geometry, const Ray& ray);
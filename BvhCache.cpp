@@ -0,0 +1,263 @@
+#include "BvhCache.hpp"
+#include "MeshCache.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+// Layout of a .cbvh file, little endian:
+//   CBvhHeader
+//   the nodes, then the primitives, each starting on a 16 KiB boundary like the sections of a
+//   .cmesh, so they can be wrapped by no-copy buffers for uploads, and zero padded
+const char cbvhMagic[8] = {'C', 'O', 'B', 'B', 'V', 'H', '\0', '\0'};
+const uint32_t cbvhVersion = 1;
+const uint64_t cbvhAlignment = 16384;
+
+enum CBvhSection {
+    SectionNodes,
+    SectionPrimitives,
+    SectionCount
+};
+
+struct CBvhHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+
+    // cache key: the geometry and every option that changes the tree
+    uint64_t meshHash;
+    uint64_t triangleCount;
+    uint32_t bins;
+    uint32_t maxLeafSize;
+    float traversalCost;
+    float intersectionCost;
+    uint32_t spatialSplits;
+    float referenceBudget;
+    float spatialOverlap;
+    uint32_t reserved;
+
+    // stats of the build that wrote the file
+    double buildSeconds;
+    uint64_t leaves;
+    uint64_t spatialSplitCount;
+    uint32_t maxDepth;
+    uint32_t reserved2;
+    double averageLeafSize;
+    double sahCost;
+
+    uint64_t nodeCount;
+    uint64_t primitiveCount;
+    uint64_t offsets[SectionCount];
+    uint64_t sizes[SectionCount];
+};
+
+static_assert(sizeof(CBvhHeader) == 160, "CBvhHeader must not have padding");
+static_assert(sizeof(BvhNode) == 32, "BvhNode is stored as is");
+
+uint64_t alignUp(uint64_t value) {
+    return (value + cbvhAlignment - 1) / cbvhAlignment * cbvhAlignment;
+}
+
+CBvhHeader makeKey(const TriangleGeometry& geometry, const BvhBuildOptions& options) {
+    CBvhHeader key = {};
+    std::memcpy(key.magic, cbvhMagic, sizeof(cbvhMagic));
+    key.version = cbvhVersion;
+    key.headerSize = sizeof(CBvhHeader);
+    key.meshHash = geometryHash(geometry);
+    key.triangleCount = geometry.triangleCount;
+    key.bins = options.bins;
+    key.maxLeafSize = options.maxLeafSize;
+    key.traversalCost = options.traversalCost;
+    key.intersectionCost = options.intersectionCost;
+    key.spatialSplits = static_cast<uint32_t>(options.spatialSplits);
+    key.referenceBudget = options.referenceBudget;
+    key.spatialOverlap = options.spatialOverlap;
+    return key;
+}
+
+// everything a traversal relies on: children inside the tree and after their parent, leaves
+// inside the primitives, primitives inside the mesh, every node the child of at most one
+// parent, and no deeper than the traversal stack
+bool validTree(const BvhView& bvh, uint64_t triangleCount) {
+    if (bvh.nodeCount == 0) return false;
+    if (bvh.nodeCount == 1 && bvh.nodes[0].count == 0) return bvh.primitiveCount == 0;
+
+    std::atomic<bool> valid{true};
+    parallelFor(0, bvh.primitiveCount, [&](size_t i) {
+        if (bvh.primitives[i] >= triangleCount) valid = false;
+    }, 1 << 16);
+    if (!valid) return false;
+
+    std::vector<uint8_t> depth(bvh.nodeCount, 0), seen(bvh.nodeCount, 0);
+    for (size_t i = 0; i < bvh.nodeCount; ++i) {
+        const BvhNode& node = bvh.nodes[i];
+        if (node.count) {
+            if (uint64_t(node.first) + node.count > bvh.primitiveCount) return false;
+            continue;
+        }
+        if (node.first <= i || uint64_t(node.first) + 1 >= bvh.nodeCount) return false;
+        if (depth[i] + 1u >= bvhMaxDepth) return false;
+        // a second parent would make a graph whose depth isn't the one recorded here
+        if (seen[node.first] || seen[node.first + 1]) return false;
+        seen[node.first] = seen[node.first + 1] = 1;
+        depth[node.first] = depth[node.first + 1] = static_cast<uint8_t>(depth[i] + 1);
+    }
+    return true;
+}
+
+// maps the cache and checks it against the key. returns false on any mismatch
+bool openCache(const std::string& path, const CBvhHeader& key, CachedBvh& out, std::unique_ptr<MappedFile>& file) {
+    try {
+        file = std::make_unique<MappedFile>(path);
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    if (file->size() < sizeof(CBvhHeader)) return false;
+    CBvhHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    // the key is everything before the stats
+    if (std::memcmp(&header, &key, offsetof(CBvhHeader, buildSeconds)) != 0) return false;
+
+    // counts first, so a damaged one can't wrap the sizes around
+    if (header.nodeCount > file->size() / sizeof(BvhNode) || header.primitiveCount > file->size() / sizeof(uint32_t)) {
+        return false;
+    }
+    const uint64_t expected[SectionCount] = {
+        header.nodeCount * sizeof(BvhNode),
+        header.primitiveCount * sizeof(uint32_t),
+    };
+    for (int s = 0; s < SectionCount; ++s) {
+        if (header.sizes[s] != expected[s] || header.offsets[s] % cbvhAlignment != 0) return false;
+        if (header.offsets[s] > file->size() || header.sizes[s] > file->size() - header.offsets[s]) return false;
+    }
+
+    out.bvh.nodes = reinterpret_cast<const BvhNode*>(file->data() + header.offsets[SectionNodes]);
+    out.bvh.nodeCount = header.nodeCount;
+    out.bvh.primitives = reinterpret_cast<const uint32_t*>(file->data() + header.offsets[SectionPrimitives]);
+    out.bvh.primitiveCount = header.primitiveCount;
+    if (!validTree(out.bvh, header.triangleCount)) return false;
+
+    BvhBuildStats& stats = out.stats;
+    stats.seconds = header.buildSeconds;
+    stats.nodes = header.nodeCount;
+    stats.leaves = header.leaves;
+    stats.maxDepth = header.maxDepth;
+    stats.averageLeafSize = header.averageLeafSize;
+    stats.sahCost = header.sahCost;
+    stats.references = header.primitiveCount;
+    stats.spatialSplits = header.spatialSplitCount;
+    return true;
+}
+
+// writes to a temporary file and renames it over the cache, so readers never see half a file
+void writeCache(const std::string& path, const CBvhHeader& key, const Bvh& bvh) {
+    CBvhHeader header = key;
+    header.buildSeconds = bvh.stats.seconds;
+    header.leaves = bvh.stats.leaves;
+    header.spatialSplitCount = bvh.stats.spatialSplits;
+    header.maxDepth = bvh.stats.maxDepth;
+    header.averageLeafSize = bvh.stats.averageLeafSize;
+    header.sahCost = bvh.stats.sahCost;
+    header.nodeCount = bvh.nodes.size();
+    header.primitiveCount = bvh.primitives.size();
+
+    const void* data[SectionCount] = {bvh.nodes.data(), bvh.primitives.data()};
+    const uint64_t sizes[SectionCount] = {bvh.nodes.size() * sizeof(BvhNode), bvh.primitives.size() * sizeof(uint32_t)};
+    uint64_t offset = alignUp(sizeof(CBvhHeader));
+    for (int s = 0; s < SectionCount; ++s) {
+        header.offsets[s] = offset;
+        header.sizes[s] = sizes[s];
+        offset = alignUp(offset + sizes[s]);
+    }
+
+    std::string temp = path + ".tmp";
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Warning: could not write BVH cache " << path << std::endl;
+        return;
+    }
+
+    static const char zeros[cbvhAlignment] = {};
+    uint64_t written = 0;
+    auto pad = [&](uint64_t to) {
+        out.write(zeros, static_cast<std::streamsize>(to - written));
+        written = to;
+    };
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    written = sizeof(header);
+    for (int s = 0; s < SectionCount; ++s) {
+        pad(header.offsets[s]);
+        if (sizes[s]) out.write(static_cast<const char*>(data[s]), static_cast<std::streamsize>(sizes[s]));
+        written += sizes[s];
+    }
+    pad(offset);
+    out.close();
+
+    if (!out || std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::remove(temp.c_str());
+        std::cerr << "Warning: could not write BVH cache " << path << std::endl;
+    }
+}
+
+}
+
+uint64_t geometryHash(const TriangleGeometry& geometry) {
+    size_t indexCount = 3 * geometry.triangleCount, block = 1 << 16;
+    std::vector<uint32_t> partial((indexCount + block - 1) / block, 0);
+    parallelFor(0, partial.size(), [&](size_t b) {
+        for (size_t i = b * block; i < std::min(indexCount, (b + 1) * block); ++i) {
+            partial[b] = std::max(partial[b], geometry.indices[i] + 1);
+        }
+    });
+    size_t vertexCount = partial.empty() ? 0 : *std::max_element(partial.begin(), partial.end());
+
+    uint64_t hashes[3] = {vertexCount, contentHash(geometry.indices, indexCount * sizeof(uint32_t)), 0};
+    if (geometry.vertexStride == 3 * sizeof(float)) {
+        hashes[2] = contentHash(geometry.vertices, vertexCount * 3 * sizeof(float));
+    } else {
+        // only the positions count, not whatever else shares their stride
+        std::vector<float> positions(3 * vertexCount);
+        parallelFor(0, vertexCount, [&](size_t v) {
+            std::memcpy(&positions[3 * v], geometry.vertex(static_cast<uint32_t>(v)), 3 * sizeof(float));
+        }, 4096);
+        hashes[2] = contentHash(positions.data(), positions.size() * sizeof(float));
+    }
+    return contentHash(hashes, sizeof(hashes));
+}
+
+CachedBvh loadCachedBvh(const std::string& path, const TriangleGeometry& geometry, const BvhBuildOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    CBvhHeader key = makeKey(geometry, options);
+
+    CachedBvh result;
+    if (openCache(path, key, result, result.file)) {
+        result.fromCache = true;
+        if (options.leafFormat == LeafFormat::Transformed) {
+            result.transforms = triangleTransforms(result.bvh.primitives, result.bvh.primitiveCount, geometry);
+            result.bvh.transforms = result.transforms.data();
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Mapped BVH cache " << path << " in " << result.seconds * 1000.0 << " ms" << std::endl;
+        return result;
+    }
+    result.file.reset();
+
+    // cache miss, build and write the cache for next time
+    result.built = buildBvh(geometry, options);
+    result.bvh = result.built;
+    result.stats = result.built.stats;
+    writeCache(path, key, result.built);
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return result;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "Bvh.hpp"
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// A BVH ready for tracing. On a warm start nodes and primitives point straight into the mapped
+// .cbvh file; after a miss they point into the freshly built tree.
+struct CachedBvh {
+    BvhView bvh;
+    BvhBuildStats stats;   // of the build that wrote the cache, its time included
+    double seconds = 0.0;  // mapping and validating, or building and writing, here
+    bool fromCache = false;
+
+    CachedBvh() = default;
+    CachedBvh(const CachedBvh&) = delete;
+    CachedBvh& operator=(const CachedBvh&) = delete;
+    CachedBvh(CachedBvh&&) = default;
+    CachedBvh& operator=(CachedBvh&&) = default;
+
+private:
+    friend CachedBvh loadCachedBvh(const std::string& path, const TriangleGeometry& geometry, const BvhBuildOptions& options);
+
+    // storage behind the view, only one of them is ever used
+    std::unique_ptr<MappedFile> file;
+    Bvh built;
+    std::vector<TriangleTransform> transforms;  // of a mapped tree with transformed leaves
+};
+
+// Loads the tree of `geometry` from the cache file at `path`, or builds it with buildBvh and
+// writes the cache for next time. The cache is keyed on geometryHash() plus every build option,
+// and its nodes are checked to stay inside the file and the mesh, so a stale or damaged cache
+// is rebuilt rather than traced. A cache that can't be written only costs a warning. The leaf
+// format isn't part of the key: transformed leaves are recomputed from the mesh after mapping,
+// which is cheap next to a build and keeps one file per tree.
+CachedBvh loadCachedBvh(const std::string& path, const TriangleGeometry& geometry, const BvhBuildOptions& options = {});
+
+// 64-bit hash of the vertices and triangles a tree is built from, on all cores
+uint64_t geometryHash(const TriangleGeometry& geometry);
@@ -0,0 +1,126 @@
+#include "BvhRefit.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+const float inf = std::numeric_limits<float>::infinity();
+const size_t blockSize = 1 << 14;
+
+double area(const BvhNode& node) {
+    double dx = node.boundsMax[0] - node.boundsMin[0];
+    double dy = node.boundsMax[1] - node.boundsMin[1];
+    double dz = node.boundsMax[2] - node.boundsMin[2];
+    if (dx < 0.0 || dy < 0.0 || dz < 0.0) return 0.0;
+    return 2.0 * (dx * dy + dy * dz + dz * dx);
+}
+
+void setUnion(BvhNode& node, const BvhNode& a, const BvhNode& b) {
+    for (int k = 0; k < 3; ++k) {
+        node.boundsMin[k] = std::min(a.boundsMin[k], b.boundsMin[k]);
+        node.boundsMax[k] = std::max(a.boundsMax[k], b.boundsMax[k]);
+    }
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+BvhRefitter::BvhRefitter(const Bvh& bvh) : parents(bvh.nodes.size(), UINT32_MAX), visits(new std::atomic<uint32_t>[bvh.nodes.size()]) {
+    // a lone root is a leaf even when it is empty
+    if (bvh.nodes.size() == 1) {
+        leaves.push_back(0);
+        return;
+    }
+    for (uint32_t i = 0; i < bvh.nodes.size(); ++i) {
+        const BvhNode& node = bvh.nodes[i];
+        if (node.count) {
+            leaves.push_back(i);
+        } else {
+            parents[node.first] = i;
+            parents[node.first + 1] = i;
+        }
+    }
+}
+
+double BvhRefitter::refit(Bvh& bvh, const TriangleGeometry& geometry, const BvhBuildOptions& options) {
+    std::vector<BvhNode>& nodes = bvh.nodes;
+    parallelFor(0, nodes.size(), [&](size_t i) { visits[i].store(0, std::memory_order_relaxed); }, blockSize);
+
+    // every leaf walks up, and the second child to arrive at a node takes it on, like in the
+    // linear builder: no level-by-level barriers, and all parent boxes are final when read
+    parallelFor(0, leaves.size(), [&](size_t i) {
+        uint32_t index = leaves[i];
+        BvhNode& leaf = nodes[index];
+        float lo[3] = {inf, inf, inf}, hi[3] = {-inf, -inf, -inf};
+        for (uint32_t p = leaf.first; p < leaf.first + leaf.count; ++p) {
+            const uint32_t* tri = &geometry.indices[3 * bvh.primitives[p]];
+            for (int c = 0; c < 3; ++c) {
+                const float* v = geometry.vertex(tri[c]);
+                for (int k = 0; k < 3; ++k) {
+                    lo[k] = std::min(lo[k], v[k]);
+                    hi[k] = std::max(hi[k], v[k]);
+                }
+            }
+            // transformed leaves are as stale as the boxes
+            if (!bvh.transforms.empty()) {
+                bvh.transforms[p] = triangleTransform(geometry.vertex(tri[0]), geometry.vertex(tri[1]), geometry.vertex(tri[2]));
+            }
+        }
+        std::copy(lo, lo + 3, leaf.boundsMin);
+        std::copy(hi, hi + 3, leaf.boundsMax);
+
+        for (uint32_t node = parents[index]; node != UINT32_MAX; node = parents[node]) {
+            if (visits[node].fetch_add(1, std::memory_order_acq_rel) == 0) return;
+            uint32_t left = nodes[node].first;
+            setUnion(nodes[node], nodes[left], nodes[left + 1]);
+        }
+    }, 64);
+
+    // sahCost, summed on all cores
+    std::vector<double> partial((nodes.size() + blockSize - 1) / blockSize);
+    parallelFor(0, partial.size(), [&](size_t b) {
+        for (size_t i = b * blockSize; i < std::min(nodes.size(), (b + 1) * blockSize); ++i) {
+            const BvhNode& node = nodes[i];
+            partial[b] += area(node) * (node.count ? options.intersectionCost * node.count : options.traversalCost);
+        }
+    });
+    double cost = 0.0, rootArea = area(nodes[0]);
+    for (double sum : partial) cost += sum;
+    bvh.stats.sahCost = rootArea > 0.0 ? cost / rootArea : 0.0;
+    return bvh.stats.sahCost;
+}
+
+DynamicBvh::DynamicBvh(const TriangleGeometry& geometry, const DynamicBvhOptions& options) : options(options) {
+    rebuild(geometry);
+    updateStats.rebuilds = 0;
+}
+
+bool DynamicBvh::update(const TriangleGeometry& geometry) {
+    auto start = std::chrono::steady_clock::now();
+    double cost = refitter->refit(tree, geometry, options.build);
+    updateStats.degradation = builtCost > 0.0 ? cost / builtCost : 1.0;
+    if (updateStats.degradation > options.rebuildThreshold) {
+        rebuild(geometry);
+        updateStats.seconds = secondsSince(start);
+        return true;
+    }
+    updateStats.refits++;
+    updateStats.seconds = secondsSince(start);
+    return false;
+}
+
+void DynamicBvh::rebuild(const TriangleGeometry& geometry) {
+    auto start = std::chrono::steady_clock::now();
+    tree = buildBvh(geometry, options.build);
+    refitter.reset(new BvhRefitter(tree));
+    // measured on refitted boxes, which are the built ones except under spatial splits
+    builtCost = refitter->refit(tree, geometry, options.build);
+    updateStats.degradation = 1.0;
+    updateStats.rebuilds++;
+    updateStats.seconds = secondsSince(start);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "Bvh.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Refitting for meshes that deform but keep their triangles: the tree's topology and primitive
+// runs stay, only the boxes are recomputed bottom-up from the moved vertices. That is one
+// linear pass where a rebuild sorts, but the boxes grow apart from what the build optimised
+// for as the mesh moves, so DynamicBvh watches the SAH cost and rebuilds once it has degraded
+// too far. The cost is relative to the root, so a mesh that also grows or shrinks as a whole
+// moves it a little either way. Refitting a tree built with spatial splits bounds whole triangles again.
+
+// parent links and leaves of a tree, set up once and reused by every refit
+class BvhRefitter {
+public:
+    explicit BvhRefitter(const Bvh& bvh);
+
+    // new boxes for every node from the current vertices of `geometry`, which must have the
+    // triangles `bvh` was built from, on all cores, and new transforms for a tree with
+    // transformed leaves. Updates bvh.stats.sahCost and returns it.
+    double refit(Bvh& bvh, const TriangleGeometry& geometry, const BvhBuildOptions& options = {});
+
+private:
+    std::vector<uint32_t> parents;  // UINT32_MAX for the root
+    std::vector<uint32_t> leaves;
+    std::unique_ptr<std::atomic<uint32_t>[]> visits;
+};
+
+struct DynamicBvhOptions {
+    BvhBuildOptions build;        // for the first build, every rebuild and the SAH cost
+    double rebuildThreshold = 1.3; // rebuild once the degradation passes this
+};
+
+struct DynamicBvhStats {
+    double seconds = 0.0;      // the last update, refit or rebuild
+    double degradation = 1.0;  // SAH cost over what it was right after the last build
+    size_t refits = 0;
+    size_t rebuilds = 0;       // not counting the first build
+};
+
+class DynamicBvh {
+public:
+    DynamicBvh(const TriangleGeometry& geometry, const DynamicBvhOptions& options = {});
+
+    // after the vertices of `geometry` have moved: refits, and rebuilds instead when refitting
+    // would leave the tree degraded past the threshold. Returns whether it rebuilt.
+    bool update(const TriangleGeometry& geometry);
+    // rebuilds now, whatever the degradation
+    void rebuild(const TriangleGeometry& geometry);
+
+    const Bvh& bvh() const { return tree; }
+    const DynamicBvhStats& stats() const { return updateStats; }
+
+private:
+    DynamicBvhOptions options;
+    Bvh tree;
+    std::unique_ptr<BvhRefitter> refitter;
+    double builtCost = 0.0;  // SAH cost right after the last build
+    DynamicBvhStats updateStats;
+};
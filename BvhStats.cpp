@@ -0,0 +1,139 @@
+#include "BvhStats.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <stdexcept>
+
+namespace {
+
+double area(const float lo[3], const float hi[3]) {
+    double dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+    if (dx < 0.0 || dy < 0.0 || dz < 0.0) return 0.0;
+    return 2.0 * (dx * dy + dy * dz + dz * dx);
+}
+
+double area(const BvhNode& node) {
+    return area(node.boundsMin, node.boundsMax);
+}
+
+void appendHistogram(std::string& out, const char* label, const std::vector<size_t>& counts) {
+    size_t largest = counts.empty() ? 0 : *std::max_element(counts.begin(), counts.end());
+    char line[160];
+    for (size_t i = 0; i < counts.size(); ++i) {
+        if (counts[i] == 0) continue;
+        int bar = largest ? static_cast<int>(50.0 * counts[i] / largest + 0.5) : 0;
+        std::snprintf(line, sizeof(line), "%-6s %4zu %10zu", label, i, counts[i]);
+        out += line;
+        if (bar) out += "  " + std::string(bar, '#');
+        out += '\n';
+    }
+}
+
+}
+
+BvhQualityReport analyzeBvh(const BvhView& bvh, const BvhBuildOptions& options) {
+    BvhQualityReport report;
+    if (bvh.nodeCount == 0) return report;
+    double rootArea = area(bvh.nodes[0]);
+    size_t interior = 0;
+    double cost = 0.0;
+    std::vector<std::pair<uint32_t, unsigned>> stack = {{0, 0}};
+    while (!stack.empty()) {
+        auto [index, depth] = stack.back();
+        stack.pop_back();
+        const BvhNode& node = bvh.nodes[index];
+        if (node.count || bvh.nodeCount == 1) {
+            if (report.leavesAtDepth.size() <= depth) report.leavesAtDepth.resize(depth + 1);
+            if (report.leavesOfSize.size() <= node.count) report.leavesOfSize.resize(node.count + 1);
+            report.leavesAtDepth[depth]++;
+            report.leavesOfSize[node.count]++;
+            cost += area(node) * options.intersectionCost * node.count;
+            continue;
+        }
+        const BvhNode& left = bvh.nodes[node.first];
+        const BvhNode& right = bvh.nodes[node.first + 1];
+        float lo[3], hi[3];
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::max(left.boundsMin[k], right.boundsMin[k]);
+            hi[k] = std::min(left.boundsMax[k], right.boundsMax[k]);
+        }
+        double shared = area(lo, hi), own = area(node);
+        report.overlapCost += shared;
+        if (own > 0.0) report.meanOverlap += shared / own;
+        interior++;
+        cost += own * options.traversalCost;
+        stack.push_back({node.first, depth + 1});
+        stack.push_back({node.first + 1, depth + 1});
+    }
+    if (rootArea > 0.0) {
+        report.sahCost = cost / rootArea;
+        report.overlapCost /= rootArea;
+    }
+    if (interior) report.meanOverlap /= interior;
+    return report;
+}
+
+std::string formatReport(const BvhQualityReport& report) {
+    char line[160];
+    std::snprintf(line, sizeof(line), "SAH cost %.2f, overlap %.2f of it, %.1f%% mean child overlap\n", report.sahCost,
+                  report.overlapCost, 100.0 * report.meanOverlap);
+    std::string out = line;
+    appendHistogram(out, "depth", report.leavesAtDepth);
+    appendHistogram(out, "size", report.leavesOfSize);
+    return out;
+}
+
+#if COBALT_STATS
+
+FrameStats::FrameStats(size_t width, size_t height)
+    : width(width), height(height), nodes(width * height), triangles(width * height), rayCount(width * height) {}
+
+void FrameStats::beginFrame() {
+    std::fill(nodes.begin(), nodes.end(), 0);
+    std::fill(triangles.begin(), triangles.end(), 0);
+    std::fill(rayCount.begin(), rayCount.end(), 0);
+}
+
+void FrameStats::record(size_t pixel, const TraversalCounters& counters) {
+    nodes[pixel] += static_cast<uint32_t>(counters.nodes);
+    triangles[pixel] += static_cast<uint32_t>(counters.triangles);
+    rayCount[pixel]++;
+}
+
+void FrameStats::endFrame() {
+    frameTotals = TraversalCounters();
+    frameRays = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        frameTotals.nodes += nodes[i];
+        frameTotals.triangles += triangles[i];
+        frameRays += rayCount[i];
+    }
+}
+
+uint64_t FrameStats::rays() const {
+    return frameRays;
+}
+
+const TraversalCounters& FrameStats::totals() const {
+    return frameTotals;
+}
+
+void FrameStats::writeHeatmap(const std::string& path) const {
+    uint32_t busiest = nodes.empty() ? 0 : *std::max_element(nodes.begin(), nodes.end());
+    std::vector<unsigned char> pixels(3 * nodes.size());
+    parallelFor(0, nodes.size(), [&](size_t i) {
+        float x = busiest ? 3.0f * nodes[i] / busiest : 0.0f;
+        pixels[3 * i] = static_cast<unsigned char>(255.0f * std::clamp(x, 0.0f, 1.0f));
+        pixels[3 * i + 1] = static_cast<unsigned char>(255.0f * std::clamp(x - 1.0f, 0.0f, 1.0f));
+        pixels[3 * i + 2] = static_cast<unsigned char>(255.0f * std::clamp(x - 2.0f, 0.0f, 1.0f));
+    }, 4096);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out << "P6\n" << width << " " << height << "\n255\n";
+    out.write(reinterpret_cast<const char*>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+    if (!out) throw std::runtime_error("Failed to write heatmap: cannot write " + path);
+}
+
+#endif
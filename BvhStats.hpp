@@ -0,0 +1,89 @@
+#pragma once
+
+#include "Bvh.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Instrumentation for finding out why a model traces slowly. The tree report is computed on
+// demand and costs nothing unless asked for. The per-ray counters sit on the hot path, so they
+// only exist in builds with COBALT_STATS=1 (make STATS=1); otherwise FrameStats is empty, its
+// calls compile to nothing and traceCounted() is the plain intersect().
+#ifndef COBALT_STATS
+#define COBALT_STATS 0
+#endif
+
+// the shape of a built tree
+struct BvhQualityReport {
+    double sahCost = 0.0;
+    std::vector<size_t> leavesAtDepth;  // leaves per depth, the root at 0
+    std::vector<size_t> leavesOfSize;   // leaves per triangle count
+    // surface area of the box shared by the two children of every interior node, summed and
+    // relative to the root: the part of the SAH cost rays pay twice
+    double overlapCost = 0.0;
+    double meanOverlap = 0.0;  // the same per interior node, relative to the node, averaged
+};
+
+BvhQualityReport analyzeBvh(const BvhView& bvh, const BvhBuildOptions& options = {});
+// human readable, one line per statistic with ASCII histograms
+std::string formatReport(const BvhQualityReport& report);
+
+// Traversal work of one frame: nodes visited and triangles tested per pixel, summed into frame
+// totals by endFrame(). Every pixel must be traced by one thread at a time.
+class FrameStats {
+public:
+    FrameStats(size_t width, size_t height);
+
+    void beginFrame();
+    void record(size_t pixel, const TraversalCounters& counters);
+    void endFrame();
+
+    uint64_t rays() const;
+    const TraversalCounters& totals() const;
+
+    // nodes visited per pixel as a binary PPM, black to red to yellow to white from none to the
+    // busiest pixel. Throws std::runtime_error if the file can't be written, or without
+    // COBALT_STATS, where there are no counts to write.
+    void writeHeatmap(const std::string& path) const;
+
+private:
+#if COBALT_STATS
+    size_t width, height;
+    std::vector<uint32_t> nodes, triangles, rayCount;  // per pixel
+    TraversalCounters frameTotals;
+    uint64_t frameRays = 0;
+#endif
+};
+
+// closest hit like intersect(), counted into `stats` at `pixel` when instrumentation is built in
+inline bool traceCounted(const Bvh& bvh, const TriangleGeometry& geometry, const Ray& ray, Hit& hit, FrameStats& stats,
+                         size_t pixel) {
+#if COBALT_STATS
+    TraversalCounters counters;
+    bool found = intersect(bvh, geometry, ray, hit, counters);
+    stats.record(pixel, counters);
+    return found;
+#else
+    (void)stats;
+    (void)pixel;
+    return intersect(bvh, geometry, ray, hit);
+#endif
+}
+
+#if !COBALT_STATS
+inline FrameStats::FrameStats(size_t, size_t) {}
+inline void FrameStats::beginFrame() {}
+inline void FrameStats::record(size_t, const TraversalCounters&) {}
+inline void FrameStats::endFrame() {}
+inline uint64_t FrameStats::rays() const { return 0; }
+inline const TraversalCounters& FrameStats::totals() const {
+    static const TraversalCounters none;
+    return none;
+}
+inline void FrameStats::writeHeatmap(const std::string& path) const {
+    throw std::runtime_error("Failed to write heatmap: " + path + " needs a build with COBALT_STATS");
+}
+#endif
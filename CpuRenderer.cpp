@@ -0,0 +1,570 @@
+#include "CpuRenderer.hpp"
+#include "NormalPacking.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+void normalize(float v[3]) {
+    float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    for (int k = 0; k < 3; ++k) v[k] /= length;
+}
+
+void cross(const float a[3], const float b[3], float out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// the viewport of compute_kernel, worked out once per frame rather than per pixel
+struct Viewport {
+    float origin[3];
+    float lowerLeft[3];  // relative to the origin
+    float horizontal[3];
+    float vertical[3];
+
+    Viewport(const Camera& camera, size_t width, size_t height) {
+        float aspect = float(width) / float(height);
+        float halfHeight = std::tan(camera.theta / 2.0f);
+        float halfWidth = aspect * halfHeight;
+
+        float forward[3], right[3], up[3];
+        const float worldUp[3] = {0.0f, 1.0f, 0.0f};
+        for (int k = 0; k < 3; ++k) forward[k] = camera.lookAt[k] - camera.lookFrom[k];
+        normalize(forward);
+        cross(forward, worldUp, right);
+        normalize(right);
+        cross(right, forward, up);
+
+        for (int k = 0; k < 3; ++k) {
+            origin[k] = camera.lookFrom[k];
+            horizontal[k] = 2.0f * halfWidth * right[k];
+            vertical[k] = 2.0f * halfHeight * up[k];
+            lowerLeft[k] = forward[k] - halfWidth * right[k] - halfHeight * up[k];
+        }
+    }
+
+    // the ray through (x, y) in pixels, pixel corners at whole numbers like the kernel's gid
+    Ray ray(float x, float y, size_t width, size_t height) const {
+        float u = x / float(width), v = y / float(height);
+        Ray ray;
+        for (int k = 0; k < 3; ++k) {
+            ray.origin[k] = origin[k];
+            ray.direction[k] = lowerLeft[k] + u * horizontal[k] + v * vertical[k];
+        }
+        normalize(ray.direction);
+        ray.tMin = 0.0001f;
+        return ray;
+    }
+};
+
+float dot(const float a[3], const float b[3]) {
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+// the kernel's light, towards it
+struct Light {
+    float direction[3] = {1.0f, 1.0f, -1.0f};
+    Light() { normalize(direction); }
+};
+const Light light;
+
+// the ground or the sky by the ray's direction
+const float* background(const float direction[3]) {
+    static const float ground[3] = {0.7f, 0.7f, 0.7f}, sky[3] = {0.68f, 0.96f, 0.96f};
+    return direction[1] < 0.0f ? ground : sky;
+}
+
+// the three normals of the hit triangle weighed by the barycentrics, unnormalised like the kernel's
+void interpolatedNormal(const RenderScene& scene, const Hit& hit, float normal[3]) {
+    float n[3][3];
+    const void* data = scene.geometry.primitive(hit.triangle);
+    if (scene.packedNormals) {
+        const uint32_t* packed = static_cast<const uint32_t*>(data);
+        for (int i = 0; i < 3; ++i) decodeOctahedral(packed[i], n[i]);
+    } else {
+        std::memcpy(n, data, sizeof(n));
+    }
+    float w = 1.0f - hit.u - hit.v;
+    for (int k = 0; k < 3; ++k) normal[k] = w * n[0][k] + hit.u * n[1][k] + hit.v * n[2][k];
+}
+
+// the kernel's shading: dot of the light with the interpolated normal, and the background on
+// a miss
+void shade(const RenderScene& scene, const Ray& ray, const Hit& hit, bool found, float color[4]) {
+    color[3] = 1.0f;
+    if (!found) {
+        std::copy(background(ray.direction), background(ray.direction) + 3, color);
+        return;
+    }
+    float normal[3];
+    interpolatedNormal(scene, hit, normal);
+    color[0] = color[1] = color[2] = dot(normal, light.direction);
+}
+
+// PCG hash, compute_kernel's too
+uint32_t pcgHash(uint32_t v) {
+    uint32_t state = v * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// [0, 1) from the top 24 bits
+float unitFloat(uint32_t bits) {
+    return (bits >> 8) * (1.0f / 16777216.0f);
+}
+
+// a stream of hashed random numbers
+struct Random {
+    uint32_t state;
+    float next() {
+        state = pcgHash(state);
+        return unitFloat(state);
+    }
+};
+
+// one path from `ray`, see PathTracingOptions. Returns the rays traced, shadow rays included
+uint32_t tracePath(const RenderScene& scene, Ray ray, const PathTracingOptions& options, Random& random, float color[4]) {
+    const float pi = 3.14159265f;
+    float throughput = 1.0f, radiance[3] = {0.0f, 0.0f, 0.0f};
+    uint32_t rays = 0;
+    for (unsigned bounce = 0; bounce < options.maxDepth; ++bounce) {
+        Hit hit;
+        rays++;
+        if (!intersect(scene.bvh, scene.geometry, ray, hit)) {
+            const float* environment = background(ray.direction);
+            for (int c = 0; c < 3; ++c) radiance[c] += throughput * environment[c];
+            break;
+        }
+
+        // the geometric normal facing the ray, and the shading normal on its side
+        const uint32_t* tri = &scene.geometry.indices[3 * hit.triangle];
+        const float* v[3] = {scene.geometry.vertex(tri[0]), scene.geometry.vertex(tri[1]), scene.geometry.vertex(tri[2])};
+        float e1[3], e2[3];
+        for (int k = 0; k < 3; ++k) {
+            e1[k] = v[1][k] - v[0][k];
+            e2[k] = v[2][k] - v[0][k];
+        }
+        float geometric[3], normal[3], point[3];
+        cross(e1, e2, geometric);
+        normalize(geometric);
+        if (dot(geometric, ray.direction) > 0.0f) for (float& g : geometric) g = -g;
+        interpolatedNormal(scene, hit, normal);
+        normalize(normal);
+        if (!(dot(normal, geometric) > 0.0f)) std::copy(geometric, geometric + 3, normal);
+        // off the surface along the geometric normal, so neither ray finds it again
+        for (int k = 0; k < 3; ++k) point[k] = ray.origin[k] + hit.t * ray.direction[k] + 1e-4f * geometric[k];
+
+        // direct light, if nothing is in its way
+        float cosine = dot(normal, light.direction);
+        if (cosine > 0.0f && dot(geometric, light.direction) > 0.0f) {
+            Ray shadow;
+            std::copy(point, point + 3, shadow.origin);
+            std::copy(light.direction, light.direction + 3, shadow.direction);
+            shadow.tMin = 0.0001f;
+            rays++;
+            if (!occluded(scene.bvh, scene.geometry, shadow)) {
+                float direct = throughput * options.albedo / pi * options.lightIrradiance * cosine;
+                for (int c = 0; c < 3; ++c) radiance[c] += direct;
+            }
+        }
+
+        // the cosine-weighted bounce carries albedo, BRDF cosine and pdf cancel
+        throughput *= options.albedo;
+        if (bounce + 1 >= options.rouletteDepth) {
+            float survive = std::min(throughput, 0.95f);
+            if (random.next() >= survive) break;
+            throughput /= survive;
+        }
+        float r = std::sqrt(random.next()), phi = 2.0f * pi * random.next();
+        float local[3] = {r * std::cos(phi), r * std::sin(phi), std::sqrt(std::max(0.0f, 1.0f - r * r))};
+        // orthonormal basis around the normal (Duff et al.)
+        float sign = std::copysign(1.0f, normal[2]);
+        float p = -1.0f / (sign + normal[2]), q = normal[0] * normal[1] * p;
+        float tangent[3] = {1.0f + sign * normal[0] * normal[0] * p, sign * q, -sign * normal[0]};
+        float bitangent[3] = {q, sign + normal[1] * normal[1] * p, -normal[1]};
+        for (int k = 0; k < 3; ++k) {
+            ray.origin[k] = point[k];
+            ray.direction[k] = local[0] * tangent[k] + local[1] * bitangent[k] + local[2] * normal[k];
+        }
+        // a shading normal tilted away from the surface can send it inside
+        if (!(dot(ray.direction, geometric) > 0.0f)) break;
+        ray.tMin = 0.0001f;
+        ray.tMax = std::numeric_limits<float>::infinity();
+    }
+    std::copy(radiance, radiance + 3, color);
+    color[3] = 1.0f;
+    return rays;
+}
+
+// sample `sample` of pixel (x, y): through the corner first, then anywhere in the pixel.
+// Returns the rays traced for it
+uint32_t tracePixel(const RenderScene& scene, const Viewport& viewport, size_t width, size_t height, uint32_t x,
+                    uint32_t y, uint32_t sample, const RenderOptions& options, float color[4]) {
+    Random random = {pcgHash(x + pcgHash(y + (pcgHash(sample) ^ options.seed)))};
+    float jx = 0.0f, jy = 0.0f;
+    if (sample > 0) {
+        jx = unitFloat(random.state);
+        jy = random.next();
+    }
+    Ray ray = viewport.ray(x + jx, y + jy, width, height);
+    if (options.integrator == Integrator::PathTracer) return tracePath(scene, ray, options.path, random, color);
+    Hit hit;
+    bool found = intersect(scene.bvh, scene.geometry, ray, hit);
+    shade(scene, ray, hit, found, color);
+    return 1;
+}
+
+float luminance(const float color[4]) {
+    return 0.2126f * color[0] + 0.7152f * color[1] + 0.0722f * color[2];
+}
+
+void checkNormals(const RenderScene& scene) {
+    size_t stride = scene.packedNormals ? 3 * sizeof(uint32_t) : 9 * sizeof(float);
+    if (scene.geometry.triangleCount && (!scene.geometry.primitiveData || scene.geometry.primitiveDataStride < stride)) {
+        throw std::runtime_error("Failed to render: the geometry has no per-primitive normals");
+    }
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}
+
+RenderStats renderFrame(const RenderScene& scene, const Camera& camera, Image& image, const RenderOptions& options) {
+    checkNormals(scene);
+    auto start = std::chrono::steady_clock::now();
+    size_t width = image.width, height = image.height;
+    Viewport viewport(camera, width, height);
+    std::vector<Tile> tiles = makeTiles(width, height, options.tiles.tileSize, options.tiles.order);
+    std::atomic<uint64_t> rays{0};
+    TileSchedulerStats schedule = runTiles(tiles, [&](const Tile& tile) {
+        uint64_t traced = 0;
+        for (uint32_t y = tile.y0; y < tile.y1; ++y) {
+            for (uint32_t x = tile.x0; x < tile.x1; ++x) traced += tracePixel(scene, viewport, width, height, x, y, 0, options, image.pixel(x, y));
+        }
+        rays += traced;
+    }, options.tiles);
+
+    RenderStats stats;
+    stats.seconds = secondsSince(start);
+    stats.rays = rays;
+    stats.samples = uint64_t(width) * height;
+    stats.threads = std::move(schedule.threads);
+    return stats;
+}
+
+Accumulator::Accumulator(size_t width, size_t height)
+    : meanImage(width, height), oddMean(width, height), m2(4 * width * height, 0.0f), counts(width * height, 0) {}
+
+void Accumulator::reset() {
+    std::fill(meanImage.pixels.begin(), meanImage.pixels.end(), 0.0f);
+    std::fill(oddMean.pixels.begin(), oddMean.pixels.end(), 0.0f);
+    std::fill(m2.begin(), m2.end(), 0.0f);
+    std::fill(counts.begin(), counts.end(), 0);
+}
+
+void Accumulator::add(size_t x, size_t y, const float color[4]) {
+    size_t pixel = y * width() + x;
+    float n = static_cast<float>(++counts[pixel]);
+    float* mean = meanImage.pixel(x, y);
+    float* squares = &m2[4 * pixel];
+    for (int c = 0; c < 4; ++c) {
+        float delta = color[c] - mean[c];
+        mean[c] += delta / n;
+        squares[c] += delta * (color[c] - mean[c]);
+    }
+    // samples 1, 3, 5... counting from 0
+    if (counts[pixel] % 2 == 0) {
+        float odd = static_cast<float>(counts[pixel] / 2);
+        float* half = oddMean.pixel(x, y);
+        for (int c = 0; c < 4; ++c) half[c] += (color[c] - half[c]) / odd;
+    }
+}
+
+float Accumulator::variance(size_t x, size_t y) const {
+    size_t pixel = y * width() + x;
+    if (counts[pixel] < 2) return 0.0f;
+    const float* squares = &m2[4 * pixel];
+    return std::max({squares[0], squares[1], squares[2]}) / (counts[pixel] - 1);
+}
+
+bool Accumulator::converged(size_t x, size_t y, const ConvergenceOptions& options) const {
+    uint32_t n = samples(x, y);
+    if (n < std::max(options.minSamples, 2u)) return false;
+    float error = std::sqrt(variance(x, y) / n);
+    return error <= options.relativeError * std::max(std::fabs(luminance(meanImage.pixel(x, y))), 0.01f);
+}
+
+float Accumulator::error(const Tile& tile) const {
+    double squares = 0.0, light = 0.0;
+    size_t pixels = 0;
+    for (uint32_t y = tile.y0; y < tile.y1; ++y) {
+        for (uint32_t x = tile.x0; x < tile.x1; ++x) {
+            uint32_t n = samples(x, y), odd = n / 2;
+            if (n < 2) return std::numeric_limits<float>::infinity();
+            const float* mean = meanImage.pixel(x, y);
+            const float* half = oddMean.pixel(x, y);
+            for (int c = 0; c < 3; ++c) {
+                // the even half out of the whole, in double as the whole is n times larger
+                double even = (double(n) * mean[c] - double(odd) * half[c]) / (n - odd);
+                squares += (even - half[c]) * (even - half[c]);
+            }
+            light += luminance(mean);
+            pixels++;
+        }
+    }
+    if (pixels == 0) return 0.0f;
+    double rmse = 0.5 * std::sqrt(squares / (3 * pixels));
+    return static_cast<float>(rmse / std::max(std::fabs(light / pixels), 0.01));
+}
+
+RenderStats accumulateFrame(const RenderScene& scene, const Camera& camera, Accumulator& accumulator,
+                            const ConvergenceOptions& convergence, const RenderOptions& options) {
+    checkNormals(scene);
+    auto start = std::chrono::steady_clock::now();
+    size_t width = accumulator.width(), height = accumulator.height();
+    Viewport viewport(camera, width, height);
+    std::vector<Tile> tiles = makeTiles(width, height, options.tiles.tileSize, options.tiles.order);
+    std::atomic<size_t> converged{0};
+    std::atomic<uint64_t> rays{0};
+    TileSchedulerStats schedule = runTiles(tiles, [&](const Tile& tile) {
+        size_t done = 0;
+        uint64_t traced = 0;
+        for (uint32_t y = tile.y0; y < tile.y1; ++y) {
+            for (uint32_t x = tile.x0; x < tile.x1; ++x) {
+                float color[4];
+                traced += tracePixel(scene, viewport, width, height, x, y, accumulator.samples(x, y), options, color);
+                accumulator.add(x, y, color);
+                done += accumulator.converged(x, y, convergence);
+            }
+        }
+        converged += done;
+        rays += traced;
+    }, options.tiles);
+
+    RenderStats stats;
+    stats.seconds = secondsSince(start);
+    stats.rays = rays;
+    stats.samples = uint64_t(width) * height;
+    stats.threads = std::move(schedule.threads);
+    stats.convergedPixels = converged;
+    return stats;
+}
+
+ProgressiveStats renderProgressive(const RenderScene& scene, const Camera& camera, Accumulator& accumulator,
+                                   const ConvergenceOptions& convergence, const RenderOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    size_t pixels = accumulator.width() * accumulator.height();
+    ProgressiveStats stats;
+    // every pass adds to every pixel, so one pixel's count is the image's
+    while (pixels && accumulator.samples(0, 0) < convergence.maxSamples) {
+        RenderStats pass = accumulateFrame(scene, camera, accumulator, convergence, options);
+        stats.passes++;
+        stats.rays += pass.rays;
+        stats.samples += pass.samples;
+        stats.convergedPixels = pass.convergedPixels;
+        if (pass.convergedPixels >= convergence.pixelShare * pixels) {
+            stats.converged = true;
+            break;
+        }
+    }
+    stats.seconds = secondsSince(start);
+    return stats;
+}
+
+void writeImage(const Image& image, const std::string& path) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    bool pfm = path.size() >= 4 && path.compare(path.size() - 4, 4, ".pfm") == 0;
+    if (pfm) {
+        // bottom row first and a negative scale for little endian, the texture as it is
+        out << "PF\n" << image.width << " " << image.height << "\n-1.0\n";
+        std::vector<float> row(3 * image.width);
+        for (size_t y = 0; y < image.height; ++y) {
+            for (size_t x = 0; x < image.width; ++x) std::copy(image.pixel(x, y), image.pixel(x, y) + 3, &row[3 * x]);
+            out.write(reinterpret_cast<const char*>(row.data()), static_cast<std::streamsize>(row.size() * sizeof(float)));
+        }
+    } else {
+        std::vector<unsigned char> pixels(3 * image.width * image.height);
+        parallelFor(0, image.height, [&](size_t y) {
+            // top row first, the texture is shown with its row 0 at the bottom
+            unsigned char* row = &pixels[3 * (image.height - 1 - y) * image.width];
+            for (size_t x = 0; x < image.width; ++x) {
+                for (int c = 0; c < 3; ++c) {
+                    float value = image.pixel(x, y)[c];
+                    value = std::clamp(value / (1.0f + value), 0.0f, 1.0f);
+                    row[3 * x + c] = static_cast<unsigned char>(std::lround(255.0f * value));
+                }
+            }
+        });
+        out << "P6\n" << image.width << " " << image.height << "\n255\n";
+        out.write(reinterpret_cast<const char*>(pixels.data()), static_cast<std::streamsize>(pixels.size()));
+    }
+    if (!out) throw std::runtime_error("Failed to write image: cannot write " + path);
+}
+
+Image readPfm(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("Failed to read image: cannot open " + path);
+    std::string magic;
+    size_t width = 0, height = 0;
+    float scale = 0.0f;
+    in >> magic >> width >> height >> scale;
+    in.get();
+    if (!in || magic != "PF" || width == 0 || height == 0 || scale >= 0.0f) {
+        throw std::runtime_error("Failed to read image: " + path + " is not a little endian colour PFM");
+    }
+
+    Image image(width, height);
+    std::vector<float> row(3 * width);
+    for (size_t y = 0; y < height; ++y) {
+        in.read(reinterpret_cast<char*>(row.data()), static_cast<std::streamsize>(row.size() * sizeof(float)));
+        for (size_t x = 0; x < width; ++x) {
+            std::copy(&row[3 * x], &row[3 * x] + 3, image.pixel(x, y));
+            image.pixel(x, y)[3] = 1.0f;
+        }
+    }
+    if (!in) throw std::runtime_error("Failed to read image: " + path + " is truncated");
+    return image;
+}
+
+ImageDifference compareImages(const Image& image, const Image& reference, float tolerance) {
+    if (image.width != reference.width || image.height != reference.height) {
+        throw std::runtime_error("Failed to compare images: " + std::to_string(image.width) + "x" +
+                                 std::to_string(image.height) + " against " + std::to_string(reference.width) + "x" +
+                                 std::to_string(reference.height));
+    }
+    ImageDifference difference;
+    double squares = 0.0;
+    for (size_t i = 0; i < image.width * image.height; ++i) {
+        float worst = 0.0f;
+        for (int c = 0; c < 3; ++c) {
+            float error = std::fabs(image.pixels[4 * i + c] - reference.pixels[4 * i + c]);
+            squares += double(error) * error;
+            worst = std::max(worst, error);
+        }
+        difference.maxError = std::max(difference.maxError, worst);
+        if (worst > tolerance) difference.pixelsOver++;
+    }
+    size_t values = 3 * image.width * image.height;
+    difference.rmse = values ? std::sqrt(squares / values) : 0.0;
+    return difference;
+}
+
+AdaptiveRenderer::AdaptiveRenderer(Accumulator& accumulator, const AdaptiveOptions& options, const RenderOptions& renderOptions)
+    : accumulator(accumulator), options(options), renderOptions(renderOptions) {
+    tiles = makeTiles(accumulator.width(), accumulator.height(), renderOptions.tiles.tileSize, renderOptions.tiles.order);
+    tileSamples.resize(tiles.size());
+    tileConverged.assign(tiles.size(), 0);
+    uint64_t taken = 0;
+    for (size_t t = 0; t < tiles.size(); ++t) {
+        tileSamples[t] = accumulator.samples(tiles[t].x0, tiles[t].y0);
+        taken += uint64_t(tileSamples[t]) * (tiles[t].x1 - tiles[t].x0) * (tiles[t].y1 - tiles[t].y0);
+    }
+    uint64_t total = uint64_t(options.sampleBudget) * accumulator.width() * accumulator.height();
+    budget = total > taken ? total - taken : 0;
+    adaptiveStats.tiles = tiles.size();
+}
+
+bool AdaptiveRenderer::pass(const RenderScene& scene, const Camera& camera) {
+    checkNormals(scene);
+    auto start = std::chrono::steady_clock::now();
+    auto even = [](double samples) { return 2 * static_cast<uint32_t>(std::ceil(samples / 2.0)); };
+
+    // samples per pixel every unfinished tile asks for
+    std::vector<Tile> active;
+    std::vector<uint32_t> wanted, index;
+    uint64_t asked = 0;
+    for (size_t t = 0; t < tiles.size(); ++t) {
+        if (tileConverged[t]) continue;
+        uint32_t n = tileSamples[t], want;
+        if (n < options.minSamples) {
+            want = even(options.minSamples - n);
+        } else {
+            float error = accumulator.error(tiles[t]);
+            if (error <= options.relativeError) {
+                tileConverged[t] = 1;
+                continue;
+            }
+            // the error falls with the square root of the samples
+            double ratio = double(error) / options.relativeError;
+            want = std::min(even(n * (ratio * ratio - 1.0)), even(n / 2.0));
+        }
+        if (n >= options.maxSamples) continue;
+        want = std::max(2u, std::min(want, options.maxSamples - n));
+        active.push_back(tiles[t]);
+        wanted.push_back(want);
+        index.push_back(static_cast<uint32_t>(t));
+        asked += uint64_t(want) * (tiles[t].x1 - tiles[t].x0) * (tiles[t].y1 - tiles[t].y0);
+    }
+
+    adaptiveStats.convergedTiles = std::count(tileConverged.begin(), tileConverged.end(), 1);
+    adaptiveStats.converged = adaptiveStats.convergedTiles == tiles.size();
+    if (active.empty() || budget == 0) return false;
+
+    // scaled down alike when the budget can't cover them all, the last tiles may go without
+    if (asked > budget) {
+        double scale = double(budget) / asked;
+        uint64_t left = budget;
+        for (size_t i = 0; i < active.size(); ++i) {
+            uint64_t pixels = uint64_t(active[i].x1 - active[i].x0) * (active[i].y1 - active[i].y0);
+            uint32_t want = std::max(2u, 2 * static_cast<uint32_t>(wanted[i] * scale / 2.0));
+            while (want > 0 && want * pixels > left) want -= 2;
+            wanted[i] = want;
+            left -= want * pixels;
+        }
+    }
+    // what is left of the budget may not cover two samples of any tile: it counts as spent,
+    // or every later pass would trace nothing and still report progress
+    uint64_t granted = 0;
+    for (size_t i = 0; i < active.size(); ++i) {
+        granted += uint64_t(wanted[i]) * (active[i].x1 - active[i].x0) * (active[i].y1 - active[i].y0);
+    }
+    if (granted == 0) {
+        budget = 0;
+        return false;
+    }
+
+    size_t width = accumulator.width(), height = accumulator.height();
+    Viewport viewport(camera, width, height);
+    std::atomic<uint64_t> rays{0}, samples{0};
+    runTiles(active, [&](const Tile& tile) {
+        size_t i = &tile - active.data();
+        uint64_t traced = 0;
+        for (uint32_t y = tile.y0; y < tile.y1; ++y) {
+            for (uint32_t x = tile.x0; x < tile.x1; ++x) {
+                for (uint32_t k = 0; k < wanted[i]; ++k) {
+                    float color[4];
+                    traced += tracePixel(scene, viewport, width, height, x, y, accumulator.samples(x, y), renderOptions, color);
+                    accumulator.add(x, y, color);
+                }
+            }
+        }
+        rays += traced;
+        samples += uint64_t(wanted[i]) * (tile.x1 - tile.x0) * (tile.y1 - tile.y0);
+    }, renderOptions.tiles);
+
+    for (size_t i = 0; i < active.size(); ++i) tileSamples[index[i]] += wanted[i];
+    budget -= std::min<uint64_t>(budget, samples);
+    adaptiveStats.rays += rays;
+    adaptiveStats.samples += samples;
+    adaptiveStats.passes++;
+    adaptiveStats.seconds += secondsSince(start);
+    return true;
+}
+
+AdaptiveStats renderAdaptive(const RenderScene& scene, const Camera& camera, Accumulator& accumulator,
+                             const AdaptiveOptions& options, const RenderOptions& renderOptions) {
+    AdaptiveRenderer renderer(accumulator, options, renderOptions);
+    while (renderer.pass(scene, camera)) {}
+    return renderer.stats();
+}
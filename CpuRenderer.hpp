@@ -0,0 +1,214 @@
+#pragma once
+
+#include "Bvh.hpp"
+#include "TileScheduler.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// compute_kernel in shaders/shader.metal on the CPU, for machines without Metal: the same
+// camera, closest-hit query, normal-interpolated shading and sky/ground background, in tiles
+// on all cores and without a window. Pixels match the kernel to float rounding, except along
+// silhouettes and shared edges, where the two traversals can pick different triangles.
+
+// compute_kernel's pinhole camera; the defaults are the viewer's starting view of the dragon
+struct Camera {
+    float lookFrom[3] = {2.8f, 0.0f, -1.2f};
+    float lookAt[3] = {0.0f, 0.1f, 0.0f};
+    float theta = 0.3f;  // vertical field of view in radians
+};
+
+// What compute_kernel is bound to. The geometry's primitive data holds three normals per
+// triangle, nine floats (see primitiveNormals) or, with packedNormals, three octahedral
+// uint32 (see packPrimitiveNormals).
+struct RenderScene {
+    TriangleGeometry geometry;
+    BvhView bvh;
+    bool packedNormals = false;
+};
+
+// RGBA float pixels like the compute texture, row 0 at the bottom of the view
+struct Image {
+    size_t width = 0;
+    size_t height = 0;
+    std::vector<float> pixels;
+
+    Image() = default;
+    Image(size_t width, size_t height) : width(width), height(height), pixels(4 * width * height, 0.0f) {}
+
+    float* pixel(size_t x, size_t y) { return &pixels[4 * (y * width + x)]; }
+    const float* pixel(size_t x, size_t y) const { return &pixels[4 * (y * width + x)]; }
+};
+
+// how a sample's colour is computed
+enum class Integrator {
+    Kernel,      // compute_kernel's shading, one ray per sample
+    PathTracer,  // see PathTracingOptions
+};
+
+// Path tracing. Surfaces are grey and diffuse, lit by the kernel's directional light through
+// shadow rays and by its sky and ground, which every path that escapes picks up. Bounces are
+// drawn from the cosine-weighted hemisphere, so the BRDF's cosine and the pdf cancel and the
+// throughput only loses albedo; past rouletteDepth a path survives each bounce with that
+// throughput as its probability (at most 0.95) and is scaled up by it, which ends dim paths
+// early without biasing the mean.
+struct PathTracingOptions {
+    unsigned maxDepth = 4;       // surfaces a path can hit; 1 is the light and nothing else
+    unsigned rouletteDepth = 2;  // bounces before Russian roulette
+    float albedo = 0.8f;
+    // of the light; pi lights a white surface facing it like the kernel's dot(n, l)
+    float lightIrradiance = 3.14159265f;
+};
+
+struct RenderOptions {
+    TileSchedulerOptions tiles;
+    Integrator integrator = Integrator::Kernel;
+    PathTracingOptions path;
+    // picks another sequence of sample positions past the first, for renders that must be
+    // independent, like a reference. 0 is the sequence compute_kernel uses
+    uint32_t seed = 0;
+};
+
+struct RenderStats {
+    double seconds = 0.0;
+    uint64_t rays = 0;     // every ray traced, the path tracer's bounces and shadow rays too
+    uint64_t samples = 0;  // pixel samples
+    std::vector<TileThreadStats> threads;  // busy and idle time of every thread
+    size_t convergedPixels = 0;            // of accumulateFrame, see below
+};
+
+// one frame at the image's size, one sample per pixel. Throws std::runtime_error if the
+// geometry has no normals to shade with
+RenderStats renderFrame(const RenderScene& scene, const Camera& camera, Image& image, const RenderOptions& options = {});
+
+// Progressive rendering. Every pass adds one sample per pixel to a running mean and variance
+// (Welford's update, which stays accurate in float over thousands of samples), the same as
+// compute_kernel does when the viewer accumulates. The first sample goes through the pixel's
+// corner like renderFrame; later ones are spread over the pixel by a hash of the pixel and
+// the sample number that the kernel shares, so the mean converges to the antialiased image.
+
+// when a pixel, and the image, is done
+struct ConvergenceOptions {
+    // standard error of the mean of every colour channel relative to the mean's luminance,
+    // which is floored at 0.01 so black pixels don't have to be exact
+    float relativeError = 0.01f;
+    unsigned minSamples = 8;     // before a pixel can count as converged, so two lucky ones don't
+    unsigned maxSamples = 1024;  // the sample budget: the image is done after this many passes
+    // the image is done when this share of its pixels has converged. Silhouette pixels are half
+    // model and half background and take far longer than the rest
+    float pixelShare = 0.99f;
+};
+
+// Running mean and variance of every pixel's samples. The odd-numbered samples are also
+// averaged on their own, so the even and the odd half are two independent images of the same
+// pixels: half their difference estimates the error of the mean without a reference.
+class Accumulator {
+public:
+    Accumulator(size_t width, size_t height);
+
+    size_t width() const { return meanImage.width; }
+    size_t height() const { return meanImage.height; }
+
+    void reset();
+    void add(size_t x, size_t y, const float color[4]);
+
+    const Image& mean() const { return meanImage; }
+    uint32_t samples(size_t x, size_t y) const { return counts[y * width() + x]; }
+    // unbiased sample variance of the noisiest colour channel
+    float variance(size_t x, size_t y) const;
+    bool converged(size_t x, size_t y, const ConvergenceOptions& options) const;
+    // the two-buffer estimate of the RMS error of the mean over a tile, relative to the tile's
+    // luminance floored at 0.01. Meant for even sample counts, where both halves are equal
+    float error(const Tile& tile) const;
+
+private:
+    Image meanImage;
+    Image oddMean;
+    std::vector<float> m2;  // summed squared deviations, rgba per pixel
+    std::vector<uint32_t> counts;
+};
+
+struct ProgressiveStats {
+    double seconds = 0.0;
+    uint64_t rays = 0;
+    uint64_t samples = 0;
+    unsigned passes = 0;         // in this call
+    size_t convergedPixels = 0;  // after the last pass
+    bool converged = false;      // enough pixels met the target, rather than the budget running out
+};
+
+// one more sample for every pixel, counting the pixels that have converged after it
+RenderStats accumulateFrame(const RenderScene& scene, const Camera& camera, Accumulator& accumulator,
+                            const ConvergenceOptions& convergence = {}, const RenderOptions& options = {});
+// passes until the image has converged or the sample budget is spent, then stops; carries on
+// from whatever `accumulator` holds
+ProgressiveStats renderProgressive(const RenderScene& scene, const Camera& camera, Accumulator& accumulator,
+                                   const ConvergenceOptions& convergence = {}, const RenderOptions& options = {});
+
+// Adaptive sampling: after a first round everywhere, only tiles whose two-buffer error is over
+// the target get more samples, as many as that error says they need but at most half again
+// what they have per pass, so they don't overshoot. The budget a uniform render spends on flat
+// sky and ground goes to the noisy tiles instead. Tiles are those of the RenderOptions, and
+// every tile gets an even number of samples per pass.
+struct AdaptiveOptions {
+    float relativeError = 0.01f;  // per tile, see Accumulator::error
+    unsigned minSamples = 8;      // per pixel everywhere before any tile's error is trusted
+    unsigned maxSamples = 4096;   // per pixel, so no tile of silhouettes takes the whole budget
+    unsigned sampleBudget = 64;   // the image's average samples per pixel
+};
+
+struct AdaptiveStats {
+    double seconds = 0.0;
+    uint64_t rays = 0;
+    uint64_t samples = 0;
+    unsigned passes = 0;
+    size_t tiles = 0;
+    size_t convergedTiles = 0;
+    bool converged = false;  // every tile met the target, rather than the budget running out
+};
+
+// Renders in passes that can be stepped through, to watch the image converge
+class AdaptiveRenderer {
+public:
+    // starts with whatever `accumulator` holds, which must outlive the renderer
+    AdaptiveRenderer(Accumulator& accumulator, const AdaptiveOptions& options = {}, const RenderOptions& renderOptions = {});
+
+    // one pass over the tiles that need more samples; false, without tracing, once every tile
+    // has converged or the budget is spent
+    bool pass(const RenderScene& scene, const Camera& camera);
+    const AdaptiveStats& stats() const { return adaptiveStats; }
+
+private:
+    Accumulator& accumulator;
+    AdaptiveOptions options;
+    RenderOptions renderOptions;
+    std::vector<Tile> tiles;
+    std::vector<uint32_t> tileSamples;  // samples per pixel of every tile so far
+    std::vector<uint8_t> tileConverged;
+    uint64_t budget = 0;                // samples left over the whole image
+    AdaptiveStats adaptiveStats;
+};
+
+// passes until done
+AdaptiveStats renderAdaptive(const RenderScene& scene, const Camera& camera, Accumulator& accumulator,
+                             const AdaptiveOptions& options = {}, const RenderOptions& renderOptions = {});
+
+// A .pfm gets the raw pixels, what the compute texture holds; anything else a binary PPM after
+// frag_shader's color / (1 + color), what the window shows. Throws std::runtime_error if the
+// file can't be written.
+void writeImage(const Image& image, const std::string& path);
+// a colour .pfm as written by writeImage or a GPU capture, alpha set to 1. Throws
+// std::runtime_error if it can't be read.
+Image readPfm(const std::string& path);
+
+// per channel differences of the red, green and blue channels
+struct ImageDifference {
+    double rmse = 0.0;
+    float maxError = 0.0f;
+    size_t pixelsOver = 0;  // pixels with a channel more than the tolerance off
+};
+
+// throws std::runtime_error if the sizes differ
+ImageDifference compareImages(const Image& image, const Image& reference, float tolerance = 1e-3f);
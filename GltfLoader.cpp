@@ -0,0 +1,724 @@
+#include "GltfLoader.hpp"
+#include "MeshLoader.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+[[noreturn]] void gltfError(const std::string& what, const std::string& filepath) {
+    throw std::runtime_error("Failed to load glTF file: " + what + " in " + filepath);
+}
+
+// ---------------------------------------------------------------------------------------------
+// just enough JSON for the glTF document
+
+struct JsonValue {
+    enum Type { Null, Bool, Number, String, Array, Object };
+    Type type = Null;
+    bool boolean = false;
+    double number = 0.0;
+    std::string string;
+    std::vector<JsonValue> array;
+    std::vector<std::pair<std::string, JsonValue>> object;
+
+    const JsonValue* find(const char* key) const {
+        if (type != Object) return nullptr;
+        for (const auto& member : object) {
+            if (member.first == key) return &member.second;
+        }
+        return nullptr;
+    }
+
+    double numberOr(const char* key, double fallback) const {
+        const JsonValue* value = find(key);
+        return value && value->type == Number ? value->number : fallback;
+    }
+
+    // array member, or an empty one when it's missing
+    const std::vector<JsonValue>& list(const char* key) const {
+        static const std::vector<JsonValue> empty;
+        const JsonValue* value = find(key);
+        return value && value->type == Array ? value->array : empty;
+    }
+};
+
+class JsonParser {
+public:
+    JsonParser(const char* begin, const char* end, const std::string& filepath) : p(begin), end(end), filepath(filepath) {}
+
+    JsonValue parseDocument() {
+        JsonValue value = parseValue(0);
+        skipSpace();
+        if (p != end) fail("trailing characters");
+        return value;
+    }
+
+private:
+    const char* p;
+    const char* end;
+    const std::string& filepath;
+
+    [[noreturn]] void fail(const char* what) { gltfError(std::string("bad JSON, ") + what, filepath); }
+
+    void skipSpace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) ++p;
+    }
+
+    bool consume(const char* literal) {
+        size_t length = std::strlen(literal);
+        if (static_cast<size_t>(end - p) < length || std::memcmp(p, literal, length) != 0) return false;
+        p += length;
+        return true;
+    }
+
+    JsonValue parseValue(int depth) {
+        if (depth > 64) fail("nested too deeply");
+        skipSpace();
+        if (p == end) fail("unexpected end");
+
+        JsonValue value;
+        if (*p == '{') {
+            value.type = JsonValue::Object;
+            ++p;
+            skipSpace();
+            if (p < end && *p == '}') {
+                ++p;
+                return value;
+            }
+            for (;;) {
+                skipSpace();
+                if (p == end || *p != '"') fail("expected a key");
+                std::string key = parseString();
+                skipSpace();
+                if (p == end || *p != ':') fail("expected ':'");
+                ++p;
+                value.object.emplace_back(std::move(key), parseValue(depth + 1));
+                skipSpace();
+                if (p < end && *p == ',') { ++p; continue; }
+                if (p < end && *p == '}') { ++p; break; }
+                fail("expected ',' or '}'");
+            }
+        } else if (*p == '[') {
+            value.type = JsonValue::Array;
+            ++p;
+            skipSpace();
+            if (p < end && *p == ']') {
+                ++p;
+                return value;
+            }
+            for (;;) {
+                value.array.push_back(parseValue(depth + 1));
+                skipSpace();
+                if (p < end && *p == ',') { ++p; continue; }
+                if (p < end && *p == ']') { ++p; break; }
+                fail("expected ',' or ']'");
+            }
+        } else if (*p == '"') {
+            value.type = JsonValue::String;
+            value.string = parseString();
+        } else if (consume("true")) {
+            value.type = JsonValue::Bool;
+            value.boolean = true;
+        } else if (consume("false")) {
+            value.type = JsonValue::Bool;
+        } else if (consume("null")) {
+            value.type = JsonValue::Null;
+        } else {
+            value.type = JsonValue::Number;
+            const char* start = p;
+            while (p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' || *p == '.' || *p == 'e' || *p == 'E')) ++p;
+            if (p == start) fail("unexpected character");
+            value.number = std::strtod(std::string(start, p).c_str(), nullptr);
+        }
+        return value;
+    }
+
+    void appendUtf8(std::string& out, uint32_t code) {
+        if (code < 0x80) {
+            out += static_cast<char>(code);
+        } else if (code < 0x800) {
+            out += static_cast<char>(0xC0 | (code >> 6));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            out += static_cast<char>(0xE0 | (code >> 12));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (code >> 18));
+            out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    uint32_t parseHex4() {
+        if (end - p < 4) fail("short \\u escape");
+        uint32_t code = 0;
+        for (int i = 0; i < 4; ++i, ++p) {
+            char c = *p;
+            code <<= 4;
+            if (c >= '0' && c <= '9') code |= c - '0';
+            else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+            else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+            else fail("bad \\u escape");
+        }
+        return code;
+    }
+
+    std::string parseString() {
+        ++p; // opening quote
+        std::string out;
+        while (p < end && *p != '"') {
+            if (*p != '\\') {
+                out += *p++;
+                continue;
+            }
+            if (++p == end) break;
+            char c = *p++;
+            switch (c) {
+                case 'b': out += '\b'; break;
+                case 'f': out += '\f'; break;
+                case 'n': out += '\n'; break;
+                case 'r': out += '\r'; break;
+                case 't': out += '\t'; break;
+                case 'u': {
+                    uint32_t code = parseHex4();
+                    if (code >= 0xD800 && code < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                        p += 2;
+                        uint32_t low = parseHex4();
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    }
+                    appendUtf8(out, code);
+                    break;
+                }
+                default: out += c; break; // \" \\ \/
+            }
+        }
+        if (p == end) fail("unterminated string");
+        ++p; // closing quote
+        return out;
+    }
+};
+
+// ---------------------------------------------------------------------------------------------
+// accessors
+
+enum ComponentType : int {
+    Byte = 5120,
+    UnsignedByte = 5121,
+    Short = 5122,
+    UnsignedShort = 5123,
+    UnsignedInt = 5125,
+    Float = 5126,
+};
+
+size_t componentSize(int type) {
+    switch (type) {
+        case Byte: case UnsignedByte: return 1;
+        case Short: case UnsignedShort: return 2;
+        case UnsignedInt: case Float: return 4;
+    }
+    return 0;
+}
+
+int componentCount(const std::string& type) {
+    if (type == "SCALAR") return 1;
+    if (type == "VEC2") return 2;
+    if (type == "VEC3") return 3;
+    if (type == "VEC4") return 4;
+    if (type == "MAT4") return 16;
+    return 0;
+}
+
+// an accessor resolved down to bytes in the BIN chunk
+struct AccessorView {
+    const char* data = nullptr;   // null for an accessor without a buffer view (all zeros)
+    size_t count = 0;
+    size_t stride = 0;
+    int componentType = Float;
+    int components = 0;
+    bool normalized = false;
+};
+
+struct GlbDocument {
+    JsonValue json;
+    const char* bin = nullptr;
+    size_t binSize = 0;
+};
+
+AccessorView accessorView(const GlbDocument& document, size_t index, const std::string& filepath) {
+    const std::vector<JsonValue>& accessors = document.json.list("accessors");
+    if (index >= accessors.size()) gltfError("accessor index out of range", filepath);
+    const JsonValue& accessor = accessors[index];
+    if (accessor.find("sparse")) gltfError("sparse accessors are not supported", filepath);
+
+    AccessorView view;
+    view.count = static_cast<size_t>(accessor.numberOr("count", 0));
+    view.componentType = static_cast<int>(accessor.numberOr("componentType", 0));
+    const JsonValue* type = accessor.find("type");
+    view.components = type && type->type == JsonValue::String ? componentCount(type->string) : 0;
+    const JsonValue* normalized = accessor.find("normalized");
+    view.normalized = normalized && normalized->boolean;
+    size_t elementSize = componentSize(view.componentType) * view.components;
+    if (elementSize == 0) gltfError("unsupported accessor type", filepath);
+    view.stride = elementSize;
+
+    const JsonValue* viewIndex = accessor.find("bufferView");
+    if (!viewIndex) return view;
+
+    const std::vector<JsonValue>& bufferViews = document.json.list("bufferViews");
+    size_t v = static_cast<size_t>(viewIndex->number);
+    if (v >= bufferViews.size()) gltfError("buffer view index out of range", filepath);
+    const JsonValue& bufferView = bufferViews[v];
+    if (bufferView.numberOr("buffer", 0) != 0) gltfError("only the embedded BIN buffer is supported", filepath);
+
+    size_t viewOffset = static_cast<size_t>(bufferView.numberOr("byteOffset", 0));
+    size_t viewLength = static_cast<size_t>(bufferView.numberOr("byteLength", 0));
+    size_t accessorOffset = static_cast<size_t>(accessor.numberOr("byteOffset", 0));
+    view.stride = static_cast<size_t>(bufferView.numberOr("byteStride", static_cast<double>(elementSize)));
+    if (view.stride < elementSize) gltfError("byteStride smaller than the element", filepath);
+
+    if (viewOffset > document.binSize || viewLength > document.binSize - viewOffset) {
+        gltfError("buffer view outside the BIN chunk", filepath);
+    }
+    // the last element has to end inside the view: offset + (count - 1) * stride + size <= length
+    if (view.count > 0 && (accessorOffset > viewLength || elementSize > viewLength - accessorOffset ||
+                           view.count - 1 > (viewLength - accessorOffset - elementSize) / view.stride)) {
+        gltfError("accessor outside its buffer view", filepath);
+    }
+    view.data = document.bin + viewOffset + accessorOffset;
+    return view;
+}
+
+inline float readComponent(const char* p, int type, bool normalized) {
+    switch (type) {
+        case Byte: {
+            int8_t v;
+            std::memcpy(&v, p, 1);
+            return normalized ? std::max(v / 127.0f, -1.0f) : v;
+        }
+        case UnsignedByte: {
+            uint8_t v;
+            std::memcpy(&v, p, 1);
+            return normalized ? v / 255.0f : v;
+        }
+        case Short: {
+            int16_t v;
+            std::memcpy(&v, p, 2);
+            return normalized ? std::max(v / 32767.0f, -1.0f) : v;
+        }
+        case UnsignedShort: {
+            uint16_t v;
+            std::memcpy(&v, p, 2);
+            return normalized ? v / 65535.0f : v;
+        }
+        case UnsignedInt: {
+            uint32_t v;
+            std::memcpy(&v, p, 4);
+            return static_cast<float>(v);
+        }
+        case Float: {
+            float v;
+            std::memcpy(&v, p, 4);
+            return v;
+        }
+    }
+    return 0.0f;
+}
+
+inline bool aligned(const void* p, size_t alignment) {
+    return reinterpret_cast<uintptr_t>(p) % alignment == 0;
+}
+
+}
+
+// resolves glTF accessors against the mapped file, copying only what can't be used in place
+class GltfSceneBuilder {
+public:
+    GltfSceneBuilder(GltfScene& scene, const GlbDocument& document, const std::string& filepath)
+        : scene(scene), document(document), filepath(filepath) {}
+
+    const float* floats(size_t accessor, int components) {
+        AccessorView view = accessorView(document, accessor, filepath);
+        if (view.components != components) gltfError("unexpected accessor type", filepath);
+
+        if (view.data && view.componentType == Float && view.stride == components * sizeof(float) && aligned(view.data, alignof(float))) {
+            scene.mappedArrays++;
+            return reinterpret_cast<const float*>(view.data);
+        }
+
+        std::vector<float> values(view.count * components, 0.0f);
+        if (view.data) {
+            size_t size = componentSize(view.componentType);
+            parallelFor(0, view.count, [&](size_t i) {
+                const char* element = view.data + i * view.stride;
+                for (int k = 0; k < components; ++k) {
+                    values[i * components + k] = readComponent(element + k * size, view.componentType, view.normalized);
+                }
+            }, 4096);
+        }
+        scene.convertedArrays++;
+        scene.floatStorage.push_back(std::move(values));
+        return scene.floatStorage.back().data();
+    }
+
+    // triangle indices for a primitive, converting strips, fans and narrow index types
+    const uint32_t* indices(const JsonValue& primitive, size_t vertexCount, size_t& triangleCount) {
+        int mode = static_cast<int>(primitive.numberOr("mode", 4));
+        const JsonValue* accessor = primitive.find("indices");
+
+        AccessorView view;
+        if (accessor) {
+            view = accessorView(document, static_cast<size_t>(accessor->number), filepath);
+            if (view.components != 1 || (view.componentType != UnsignedByte && view.componentType != UnsignedShort &&
+                                         view.componentType != UnsignedInt)) {
+                gltfError("bad index accessor", filepath);
+            }
+        }
+        size_t count = accessor ? view.count : vertexCount;
+
+        // the i-th index of the primitive, straight from the accessor
+        auto index = [&](size_t i) -> uint32_t {
+            if (!accessor) return static_cast<uint32_t>(i);
+            if (!view.data) return 0;
+            const char* p = view.data + i * view.stride;
+            if (view.componentType == UnsignedByte) return static_cast<uint8_t>(*p);
+            if (view.componentType == UnsignedShort) {
+                uint16_t v;
+                std::memcpy(&v, p, 2);
+                return v;
+            }
+            uint32_t v;
+            std::memcpy(&v, p, 4);
+            return v;
+        };
+
+        const uint32_t* result = nullptr;
+        if (mode == 4) {
+            triangleCount = count / 3;
+            if (accessor && view.data && view.componentType == UnsignedInt && view.stride == sizeof(uint32_t) &&
+                aligned(view.data, alignof(uint32_t))) {
+                scene.mappedArrays++;
+                result = reinterpret_cast<const uint32_t*>(view.data);
+            } else {
+                std::vector<uint32_t> out(triangleCount * 3);
+                parallelFor(0, out.size(), [&](size_t i) { out[i] = index(i); }, 4096);
+                result = store(std::move(out));
+            }
+        } else if (mode == 5 || mode == 6) {
+            // strips flip every other triangle to keep the winding, fans pivot on the first index
+            triangleCount = count >= 3 ? count - 2 : 0;
+            std::vector<uint32_t> out(triangleCount * 3);
+            parallelFor(0, triangleCount, [&](size_t t) {
+                uint32_t* tri = &out[3 * t];
+                if (mode == 6) {
+                    tri[0] = index(0);
+                    tri[1] = index(t + 1);
+                    tri[2] = index(t + 2);
+                } else if (t % 2 == 0) {
+                    tri[0] = index(t);
+                    tri[1] = index(t + 1);
+                    tri[2] = index(t + 2);
+                } else {
+                    tri[0] = index(t + 1);
+                    tri[1] = index(t);
+                    tri[2] = index(t + 2);
+                }
+            }, 4096);
+            result = store(std::move(out));
+        } else {
+            triangleCount = 0;
+            return nullptr;
+        }
+
+        std::atomic<bool> valid{true};
+        parallelFor(0, triangleCount * 3, [&](size_t i) {
+            if (result[i] >= vertexCount) valid = false;
+        }, 1 << 16);
+        if (!valid) gltfError("index out of range", filepath);
+        return result;
+    }
+
+    void readMeshes() {
+        for (const JsonValue& mesh : document.json.list("meshes")) {
+            GltfMesh out;
+            const JsonValue* name = mesh.find("name");
+            if (name && name->type == JsonValue::String) out.name = name->string;
+
+            for (const JsonValue& primitive : mesh.list("primitives")) {
+                const JsonValue* attributes = primitive.find("attributes");
+                const JsonValue* position = attributes ? attributes->find("POSITION") : nullptr;
+                if (!position) continue;
+
+                GltfPrimitive result;
+                result.vertexCount = accessorView(document, static_cast<size_t>(position->number), filepath).count;
+                result.indices = indices(primitive, result.vertexCount, result.triangleCount);
+                if (!result.indices || result.triangleCount == 0) continue; // points and lines
+
+                result.positions = floats(static_cast<size_t>(position->number), 3);
+                if (const JsonValue* normal = attributes->find("NORMAL")) {
+                    if (accessorView(document, static_cast<size_t>(normal->number), filepath).count < result.vertexCount) {
+                        gltfError("NORMAL shorter than POSITION", filepath);
+                    }
+                    result.normals = floats(static_cast<size_t>(normal->number), 3);
+                }
+                if (const JsonValue* texcoord = attributes->find("TEXCOORD_0")) {
+                    if (accessorView(document, static_cast<size_t>(texcoord->number), filepath).count < result.vertexCount) {
+                        gltfError("TEXCOORD_0 shorter than POSITION", filepath);
+                    }
+                    result.texcoords = floats(static_cast<size_t>(texcoord->number), 2);
+                }
+                out.primitives.push_back(result);
+            }
+            scene.meshes.push_back(std::move(out));
+        }
+    }
+
+    void readNodes() {
+        const std::vector<JsonValue>& nodes = document.json.list("nodes");
+
+        // roots of the default scene, or every node nobody points at when there are no scenes
+        std::vector<size_t> roots;
+        const std::vector<JsonValue>& scenes = document.json.list("scenes");
+        if (!scenes.empty()) {
+            size_t sceneIndex = static_cast<size_t>(document.json.numberOr("scene", 0));
+            if (sceneIndex >= scenes.size()) gltfError("scene index out of range", filepath);
+            for (const JsonValue& node : scenes[sceneIndex].list("nodes")) roots.push_back(static_cast<size_t>(node.number));
+        } else {
+            std::vector<bool> child(nodes.size(), false);
+            for (const JsonValue& node : nodes) {
+                for (const JsonValue& c : node.list("children")) {
+                    if (static_cast<size_t>(c.number) < nodes.size()) child[static_cast<size_t>(c.number)] = true;
+                }
+            }
+            for (size_t n = 0; n < nodes.size(); ++n) {
+                if (!child[n]) roots.push_back(n);
+            }
+        }
+
+        const float identity[12] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0};
+        for (size_t root : roots) visit(nodes, root, identity, 0);
+    }
+
+private:
+    GltfScene& scene;
+    const GlbDocument& document;
+    const std::string& filepath;
+
+    const uint32_t* store(std::vector<uint32_t>&& values) {
+        scene.convertedArrays++;
+        scene.indexStorage.push_back(std::move(values));
+        return scene.indexStorage.back().data();
+    }
+
+    // local transform of a node as a row-major 3x4 matrix: matrix, or translation * rotation * scale
+    static void localTransform(const JsonValue& node, float out[12]) {
+        const std::vector<JsonValue>& matrix = node.list("matrix");
+        if (matrix.size() == 16) {
+            // glTF matrices are column-major
+            for (int r = 0; r < 3; ++r) {
+                for (int c = 0; c < 4; ++c) out[4 * r + c] = static_cast<float>(matrix[4 * c + r].number);
+            }
+            return;
+        }
+
+        float t[3] = {0, 0, 0}, q[4] = {0, 0, 0, 1}, s[3] = {1, 1, 1};
+        const std::vector<JsonValue>& translation = node.list("translation");
+        const std::vector<JsonValue>& rotation = node.list("rotation");
+        const std::vector<JsonValue>& scale = node.list("scale");
+        for (size_t k = 0; k < 3 && translation.size() == 3; ++k) t[k] = static_cast<float>(translation[k].number);
+        for (size_t k = 0; k < 4 && rotation.size() == 4; ++k) q[k] = static_cast<float>(rotation[k].number);
+        for (size_t k = 0; k < 3 && scale.size() == 3; ++k) s[k] = static_cast<float>(scale[k].number);
+
+        float x = q[0], y = q[1], z = q[2], w = q[3];
+        float r[9] = {
+            1 - 2 * (y * y + z * z), 2 * (x * y - z * w), 2 * (x * z + y * w),
+            2 * (x * y + z * w), 1 - 2 * (x * x + z * z), 2 * (y * z - x * w),
+            2 * (x * z - y * w), 2 * (y * z + x * w), 1 - 2 * (x * x + y * y),
+        };
+        for (int row = 0; row < 3; ++row) {
+            for (int c = 0; c < 3; ++c) out[4 * row + c] = r[3 * row + c] * s[c];
+            out[4 * row + 3] = t[row];
+        }
+    }
+
+    void visit(const std::vector<JsonValue>& nodes, size_t index, const float parent[12], size_t depth) {
+        if (index >= nodes.size()) gltfError("node index out of range", filepath);
+        if (depth > nodes.size()) gltfError("node hierarchy has a cycle", filepath);
+        const JsonValue& node = nodes[index];
+
+        float local[12], world[12];
+        localTransform(node, local);
+        for (int r = 0; r < 3; ++r) {
+            for (int c = 0; c < 4; ++c) {
+                world[4 * r + c] = parent[4 * r] * local[c] + parent[4 * r + 1] * local[4 + c] + parent[4 * r + 2] * local[8 + c] +
+                                   (c == 3 ? parent[4 * r + 3] : 0.0f);
+            }
+        }
+
+        if (const JsonValue* mesh = node.find("mesh")) {
+            GltfInstance instance;
+            instance.mesh = static_cast<size_t>(mesh->number);
+            if (instance.mesh >= scene.meshes.size()) gltfError("mesh index out of range", filepath);
+            std::copy(world, world + 12, instance.transform);
+            scene.instances.push_back(instance);
+        }
+        for (const JsonValue& child : node.list("children")) visit(nodes, static_cast<size_t>(child.number), world, depth + 1);
+    }
+};
+
+GltfScene loadGLBScene(const std::string& filepath) {
+    GltfScene scene;
+    scene.file = std::make_unique<MappedFile>(filepath);
+    const char* data = scene.file->data();
+    const size_t size = scene.file->size();
+
+    // 12 byte header, then chunks of (length, type, payload), each 4-byte aligned
+    auto word = [&](size_t offset) {
+        uint32_t value;
+        std::memcpy(&value, data + offset, sizeof(value));
+        return value;
+    };
+    if (size < 20 || std::memcmp(data, "glTF", 4) != 0) gltfError("not a binary glTF file", filepath);
+    if (word(4) != 2) gltfError("unsupported glTF version " + std::to_string(word(4)), filepath);
+
+    const char* json = nullptr;
+    size_t jsonSize = 0;
+    GlbDocument document;
+    size_t offset = 12;
+    size_t end = std::min<size_t>(size, word(8));
+    while (offset + 8 <= end) {
+        size_t length = word(offset);
+        uint32_t type = word(offset + 4);
+        if (length > end - offset - 8) gltfError("truncated chunk", filepath);
+        if (type == 0x4E4F534A && !json) {          // "JSON"
+            json = data + offset + 8;
+            jsonSize = length;
+        } else if (type == 0x004E4942 && !document.bin) {   // "BIN\0"
+            document.bin = data + offset + 8;
+            document.binSize = length;
+        }
+        offset += 8 + ((length + 3) & ~size_t(3));
+    }
+    if (!json) gltfError("missing JSON chunk", filepath);
+
+    document.json = JsonParser(json, json + jsonSize, filepath).parseDocument();
+    for (const JsonValue& buffer : document.json.list("buffers")) {
+        if (buffer.find("uri")) gltfError("external buffers are not supported", filepath);
+    }
+
+    GltfSceneBuilder builder(scene, document, filepath);
+    builder.readMeshes();
+    builder.readNodes();
+    return scene;
+}
+
+const GltfPrimitive* untransformedPrimitive(const GltfScene& scene) {
+    static const float identity[12] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0};
+    if (scene.instances.size() != 1) return nullptr;
+    const GltfInstance& instance = scene.instances[0];
+    if (scene.meshes[instance.mesh].primitives.size() != 1) return nullptr;
+    if (!std::equal(identity, identity + 12, instance.transform)) return nullptr;
+    return &scene.meshes[instance.mesh].primitives[0];
+}
+
+Mesh flattenGLBScene(const GltfScene& scene, float scale, const std::string& filepath) {
+    // one job per (instance, primitive), placed by prefix sums. attributes only survive the
+    // flattening when every primitive has them; primitiveNormals falls back to face normals
+    struct Job {
+        const GltfInstance* instance;
+        const GltfPrimitive* primitive;
+        size_t firstVertex, firstIndex;
+    };
+    std::vector<Job> jobs;
+    size_t vertexCount = 0, indexCount = 0;
+    bool normals = true, texcoords = true;
+    for (const GltfInstance& instance : scene.instances) {
+        for (const GltfPrimitive& primitive : scene.meshes[instance.mesh].primitives) {
+            jobs.push_back({&instance, &primitive, vertexCount, indexCount});
+            vertexCount += primitive.vertexCount;
+            indexCount += primitive.triangleCount * 3;
+            normals = normals && primitive.normals;
+            texcoords = texcoords && primitive.texcoords;
+        }
+    }
+    if (vertexCount > UINT32_MAX) gltfError("scene has more than 2^32 vertices", filepath);
+
+    Mesh mesh;
+    mesh.vertices.resize(vertexCount * 3);
+    mesh.indices.resize(indexCount);
+    if (normals && !jobs.empty()) mesh.normals.resize(vertexCount * 3);
+    if (texcoords && !jobs.empty()) mesh.texcoords.resize(vertexCount * 2);
+
+    for (const Job& job : jobs) {
+        const float* m = job.instance->transform;
+        const GltfPrimitive& primitive = *job.primitive;
+
+        // normals go through the inverse transpose of the upper 3x3. Its cofactor matrix is that
+        // times the determinant, so it needs the determinant's sign to keep normals outward
+        // on mirrored nodes
+        float n[9] = {
+            m[5] * m[10] - m[6] * m[9], m[6] * m[8] - m[4] * m[10], m[4] * m[9] - m[5] * m[8],
+            m[2] * m[9] - m[1] * m[10], m[0] * m[10] - m[2] * m[8], m[1] * m[8] - m[0] * m[9],
+            m[1] * m[6] - m[2] * m[5], m[2] * m[4] - m[0] * m[6], m[0] * m[5] - m[1] * m[4],
+        };
+        bool mirrored = m[0] * n[0] + m[1] * n[1] + m[2] * n[2] < 0.0f;
+        if (mirrored) for (float& c : n) c = -c;
+
+        parallelFor(0, primitive.vertexCount, [&](size_t v) {
+            const float* p = &primitive.positions[3 * v];
+            float* out = &mesh.vertices[3 * (job.firstVertex + v)];
+            for (int r = 0; r < 3; ++r) {
+                out[r] = scale * (m[4 * r] * p[0] + m[4 * r + 1] * p[1] + m[4 * r + 2] * p[2] + m[4 * r + 3]);
+            }
+            if (!mesh.normals.empty()) {
+                const float* a = &primitive.normals[3 * v];
+                float* o = &mesh.normals[3 * (job.firstVertex + v)];
+                float x = n[0] * a[0] + n[1] * a[1] + n[2] * a[2];
+                float y = n[3] * a[0] + n[4] * a[1] + n[5] * a[2];
+                float z = n[6] * a[0] + n[7] * a[1] + n[8] * a[2];
+                float length = std::sqrt(x * x + y * y + z * z);
+                float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+                o[0] = x * inverse;
+                o[1] = y * inverse;
+                o[2] = z * inverse;
+            }
+            if (!mesh.texcoords.empty()) {
+                mesh.texcoords[2 * (job.firstVertex + v)] = primitive.texcoords[2 * v];
+                mesh.texcoords[2 * (job.firstVertex + v) + 1] = primitive.texcoords[2 * v + 1];
+            }
+        }, 4096);
+
+        // a mirrored node turns the winding around, glTF says to turn it back
+        const uint32_t base = static_cast<uint32_t>(job.firstVertex);
+        parallelFor(0, primitive.triangleCount, [&](size_t t) {
+            const uint32_t* in = &primitive.indices[3 * t];
+            unsigned int* out = &mesh.indices[job.firstIndex + 3 * t];
+            out[0] = base + in[0];
+            out[1] = base + (mirrored ? in[2] : in[1]);
+            out[2] = base + (mirrored ? in[1] : in[2]);
+        }, 4096);
+    }
+
+    return mesh;
+}
+
+Mesh loadGLB(const std::string& filepath, float scale) {
+    auto start = std::chrono::steady_clock::now();
+    GltfScene scene = loadGLBScene(filepath);
+    Mesh mesh = flattenGLBScene(scene, scale, filepath);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Parsed " << filepath << ": " << scene.meshes.size() << " meshes, " << scene.instances.size()
+              << " instances flattened in " << seconds * 1000.0 << " ms" << std::endl;
+    std::cout << "Read " << mesh.vertices.size() / 3 << " vertices and " << mesh.indices.size() / 3 << " triangles" << std::endl;
+
+    return mesh;
+}
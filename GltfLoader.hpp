@@ -0,0 +1,71 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include "Mesh.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One triangle primitive of a glTF mesh, in the mesh's own space. Arrays point straight into
+// the mapped .glb when the accessor already is tightly packed float / uint32 data, and into
+// storage owned by the GltfScene when it had to be converted (strides, normalized or small
+// integer types, strips and fans).
+struct GltfPrimitive {
+    const float* positions = nullptr;     // x, y, z per vertex
+    const float* normals = nullptr;       // x, y, z per vertex, null if absent
+    const float* texcoords = nullptr;     // u, v per vertex, null if absent
+    const uint32_t* indices = nullptr;    // three per triangle
+    size_t vertexCount = 0;
+    size_t triangleCount = 0;
+};
+
+struct GltfMesh {
+    std::string name;
+    std::vector<GltfPrimitive> primitives;
+};
+
+// a node that references a mesh, with its world transform as a row-major 3x4 matrix
+struct GltfInstance {
+    size_t mesh = 0;
+    float transform[12] = {1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0};
+};
+
+// A .glb file mapped into memory plus the meshes and mesh instances of its default scene.
+// The views stay valid for as long as the scene does.
+class GltfScene {
+public:
+    std::vector<GltfMesh> meshes;
+    std::vector<GltfInstance> instances;
+    size_t mappedArrays = 0;      // attribute and index arrays the views take from the mapping
+    size_t convertedArrays = 0;   // arrays that needed a copy
+
+    GltfScene() = default;
+    GltfScene(const GltfScene&) = delete;
+    GltfScene& operator=(const GltfScene&) = delete;
+    GltfScene(GltfScene&&) = default;
+    GltfScene& operator=(GltfScene&&) = default;
+
+private:
+    friend class GltfSceneBuilder;
+    friend GltfScene loadGLBScene(const std::string& filepath);
+
+    std::unique_ptr<MappedFile> file;
+    std::vector<std::vector<float>> floatStorage;
+    std::vector<std::vector<uint32_t>> indexStorage;
+};
+
+// Maps a binary glTF 2.0 file and resolves the meshes and node transforms of its default scene.
+// Only the embedded BIN buffer is supported; throws std::runtime_error on anything else.
+GltfScene loadGLBScene(const std::string& filepath);
+
+// The one primitive of a scene that is a single instance, with an identity transform, of a
+// mesh with a single primitive: its views already are the world-space mesh and can be handed
+// to buffer creation as they are (see loadCachedMesh). Null for any other scene.
+const GltfPrimitive* untransformedPrimitive(const GltfScene& scene);
+
+// Every mesh instance copied into one world-space Mesh, transformed by its node's world matrix
+// and scaled; what loadGLB returns. Throws std::runtime_error past 2^32 vertices.
+Mesh flattenGLBScene(const GltfScene& scene, float scale, const std::string& filepath);
@@ -0,0 +1,511 @@
+#include "Lbvh.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+
+namespace {
+
+const float inf = std::numeric_limits<float>::infinity();
+const uint32_t leafFlag = 0x80000000u;  // a child that is a position in the sorted order, not an internal node
+const size_t blockSize = 1 << 16;
+
+struct Box {
+    float lo[3] = {inf, inf, inf};
+    float hi[3] = {-inf, -inf, -inf};
+
+    void grow(const float p[3]) {
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], p[k]);
+            hi[k] = std::max(hi[k], p[k]);
+        }
+    }
+
+    void grow(const Box& b) {
+        for (int k = 0; k < 3; ++k) {
+            lo[k] = std::min(lo[k], b.lo[k]);
+            hi[k] = std::max(hi[k], b.hi[k]);
+        }
+    }
+
+    float area() const {
+        float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+        if (dx < 0.0f || dy < 0.0f || dz < 0.0f) return 0.0f;
+        return 2.0f * (dx * dy + dy * dz + dz * dx);
+    }
+};
+
+// puts two zero bits between each of the low 10 bits
+uint32_t spread10(uint32_t x) {
+    x &= 0x3ff;
+    x = (x | x << 16) & 0x030000ff;
+    x = (x | x << 8) & 0x0300f00f;
+    x = (x | x << 4) & 0x030c30c3;
+    x = (x | x << 2) & 0x09249249;
+    return x;
+}
+
+// the same for the low 21 bits
+uint64_t spread21(uint64_t x) {
+    x &= 0x1fffff;
+    x = (x | x << 32) & 0x1f00000000ffffull;
+    x = (x | x << 16) & 0x1f0000ff0000ffull;
+    x = (x | x << 8) & 0x100f00f00f00f00full;
+    x = (x | x << 4) & 0x10c30c30c30c30c3ull;
+    x = (x | x << 2) & 0x1249249249249249ull;
+    return x;
+}
+
+template <typename Code> struct Morton;
+
+template <> struct Morton<uint32_t> {
+    static const unsigned axisBits = 10;
+    static uint32_t encode(uint32_t x, uint32_t y, uint32_t z) { return spread10(x) << 2 | spread10(y) << 1 | spread10(z); }
+    static int leadingZeros(uint32_t x) { return __builtin_clz(x); }
+};
+
+template <> struct Morton<uint64_t> {
+    static const unsigned axisBits = 21;
+    static uint64_t encode(uint64_t x, uint64_t y, uint64_t z) { return spread21(x) << 2 | spread21(y) << 1 | spread21(z); }
+    static int leadingZeros(uint64_t x) { return __builtin_clzll(x); }
+};
+
+// Stable LSD radix sort of codes and their triangles, a byte per pass. Every pass counts digits
+// per block on all cores, turns the counts into per-block offsets and scatters the blocks in
+// parallel; passes whose digit is the same everywhere are skipped.
+template <typename Code>
+void radixSort(std::vector<Code>& codes, std::vector<uint32_t>& values, unsigned bits) {
+    size_t n = codes.size(), blocks = (n + blockSize - 1) / blockSize;
+    std::vector<Code> codesOut(n);
+    std::vector<uint32_t> valuesOut(n);
+    std::vector<std::array<size_t, 256>> offsets(blocks);
+    for (unsigned shift = 0; shift < bits; shift += 8) {
+        parallelFor(0, blocks, [&](size_t b) {
+            std::array<size_t, 256>& count = offsets[b];
+            count.fill(0);
+            for (size_t i = b * blockSize; i < std::min(n, (b + 1) * blockSize); ++i) count[(codes[i] >> shift) & 0xff]++;
+        });
+        size_t total = 0;
+        bool trivial = false;
+        for (unsigned digit = 0; digit < 256; ++digit) {
+            size_t start = total;
+            for (size_t b = 0; b < blocks; ++b) {
+                size_t count = offsets[b][digit];
+                offsets[b][digit] = total;
+                total += count;
+            }
+            trivial |= total - start == n;
+        }
+        if (trivial) continue;
+        parallelFor(0, blocks, [&](size_t b) {
+            std::array<size_t, 256>& next = offsets[b];
+            for (size_t i = b * blockSize; i < std::min(n, (b + 1) * blockSize); ++i) {
+                size_t to = next[(codes[i] >> shift) & 0xff]++;
+                codesOut[to] = codes[i];
+                valuesOut[to] = values[i];
+            }
+        });
+        codes.swap(codesOut);
+        values.swap(valuesOut);
+    }
+}
+
+class Builder {
+public:
+    Builder(const TriangleGeometry& geometry, const LbvhBuildOptions& options)
+        : geometry(geometry), options(options), treeletSize(std::clamp(options.treeletSize, 3u, 8u)) {}
+
+    void build(Bvh& bvh) {
+        n = geometry.triangleCount;
+        computeBoxes();
+        if (options.mortonBits > 32) {
+            buildTree<uint64_t>();
+        } else {
+            buildTree<uint32_t>();
+        }
+
+        visits.reset(new std::atomic<uint32_t>[n - 1]);
+        bottomUp([&](uint32_t node) { update(node); });
+        for (unsigned pass = 0; pass < options.restructurePasses; ++pass) {
+            // later passes only look at larger subtrees, the small ones have settled
+            size_t smallest = static_cast<size_t>(treeletSize) << pass;
+            bottomUp([&](uint32_t node) {
+                if (count[node] >= smallest) restructure(node);
+                update(node);
+            });
+        }
+        emit(bvh);
+    }
+
+private:
+    const TriangleGeometry& geometry;
+    const LbvhBuildOptions& options;
+    const unsigned treeletSize;
+    size_t n = 0;
+
+    std::vector<Box> triangleBoxes;
+    Box centroidBounds;
+    std::vector<uint32_t> order;  // triangles along the Morton curve
+
+    // internal nodes of the radix tree, 0 is the root; children are internal node indices or
+    // leafFlag | position in `order`
+    std::vector<std::array<uint32_t, 2>> children;
+    std::vector<uint32_t> parent, leafParent;
+    std::vector<Box> boxes;
+    std::vector<float> cost;       // SAH cost of the subtree, not divided by the root area
+    std::vector<uint32_t> count;   // triangles in the subtree
+    std::vector<uint8_t> height;   // longest path down to a triangle
+    std::vector<uint8_t> collapse; // the subtree is cheaper as one leaf
+    std::unique_ptr<std::atomic<uint32_t>[]> visits;
+
+    void computeBoxes() {
+        triangleBoxes.resize(n);
+        std::vector<Box> partial((n + blockSize - 1) / blockSize);
+        parallelFor(0, partial.size(), [&](size_t b) {
+            for (size_t t = b * blockSize; t < std::min(n, (b + 1) * blockSize); ++t) {
+                Box& box = triangleBoxes[t];
+                for (int k = 0; k < 3; ++k) box.grow(geometry.vertex(geometry.indices[3 * t + k]));
+                float center[3] = {0.5f * (box.lo[0] + box.hi[0]), 0.5f * (box.lo[1] + box.hi[1]), 0.5f * (box.lo[2] + box.hi[2])};
+                partial[b].grow(center);
+            }
+        });
+        for (const Box& box : partial) centroidBounds.grow(box);
+    }
+
+    template <typename Code>
+    void buildTree() {
+        // codes on a grid over the centroid bounds, each axis on its own scale
+        const float cells = static_cast<float>(1u << Morton<Code>::axisBits);
+        float scale[3];
+        for (int k = 0; k < 3; ++k) {
+            float extent = centroidBounds.hi[k] - centroidBounds.lo[k];
+            scale[k] = extent > 0.0f ? cells / extent : 0.0f;
+        }
+        std::vector<Code> codes(n);
+        order.resize(n);
+        parallelFor(0, n, [&](size_t t) {
+            const Box& box = triangleBoxes[t];
+            Code cell[3];
+            for (int k = 0; k < 3; ++k) {
+                float x = (0.5f * (box.lo[k] + box.hi[k]) - centroidBounds.lo[k]) * scale[k];
+                cell[k] = static_cast<Code>(std::clamp(x, 0.0f, cells - 1.0f));
+            }
+            codes[t] = Morton<Code>::encode(cell[0], cell[1], cell[2]);
+            order[t] = static_cast<uint32_t>(t);
+        }, 4096);
+        radixSort(codes, order, 3 * Morton<Code>::axisBits);
+
+        children.resize(n - 1);
+        parent.resize(n - 1);
+        leafParent.resize(n);
+        parent[0] = UINT32_MAX;
+        const int64_t size = static_cast<int64_t>(n);
+        // length of the common prefix of two sorted codes; equal codes are told apart by their
+        // positions, so every key is unique
+        auto delta = [&](int64_t i, int64_t j) -> int {
+            if (j < 0 || j >= size) return -1;
+            Code a = codes[i], b = codes[j];
+            if (a == b) return static_cast<int>(8 * sizeof(Code)) + __builtin_clz(static_cast<uint32_t>(i ^ j));
+            return Morton<Code>::leadingZeros(a ^ b);
+        };
+        parallelFor(0, n - 1, [&](size_t node) {
+            int64_t i = static_cast<int64_t>(node);
+            // the range of keys under node i runs from i towards the neighbour with the longer prefix
+            int64_t d = delta(i, i + 1) > delta(i, i - 1) ? 1 : -1;
+            int minimum = delta(i, i - d);
+            int64_t bound = 2;
+            while (delta(i, i + bound * d) > minimum) bound *= 2;
+            int64_t length = 0;
+            for (int64_t step = bound / 2; step >= 1; step /= 2) {
+                if (delta(i, i + (length + step) * d) > minimum) length += step;
+            }
+            int64_t j = i + length * d;
+
+            // the split is where the prefix of the whole range ends
+            int prefix = delta(i, j);
+            int64_t split = 0;
+            for (int64_t divisor = 2;; divisor *= 2) {
+                int64_t step = (length + divisor - 1) / divisor;
+                if (delta(i, i + (split + step) * d) > prefix) split += step;
+                if (step <= 1) break;
+            }
+            int64_t gamma = i + split * d + std::min<int64_t>(d, 0);
+
+            uint32_t left = static_cast<uint32_t>(gamma), right = static_cast<uint32_t>(gamma + 1);
+            bool leftLeaf = std::min(i, j) == gamma, rightLeaf = std::max(i, j) == gamma + 1;
+            children[node] = {leftLeaf ? leafFlag | left : left, rightLeaf ? leafFlag | right : right};
+            (leftLeaf ? leafParent[left] : parent[left]) = static_cast<uint32_t>(node);
+            (rightLeaf ? leafParent[right] : parent[right]) = static_cast<uint32_t>(node);
+        }, 1024);
+
+        boxes.resize(n - 1);
+        cost.resize(n - 1);
+        count.resize(n - 1);
+        height.resize(n - 1);
+        collapse.resize(n - 1);
+    }
+
+    const Box& boxOf(uint32_t child) const {
+        return child & leafFlag ? triangleBoxes[order[child & ~leafFlag]] : boxes[child];
+    }
+
+    float costOf(uint32_t child) const {
+        return child & leafFlag ? options.intersectionCost * boxOf(child).area() : cost[child];
+    }
+
+    uint32_t countOf(uint32_t child) const {
+        return child & leafFlag ? 1 : count[child];
+    }
+
+    unsigned heightOf(uint32_t child) const {
+        return child & leafFlag ? 0 : height[child];
+    }
+
+    void setParent(uint32_t child, uint32_t node) {
+        (child & leafFlag ? leafParent[child & ~leafFlag] : parent[child]) = node;
+    }
+
+    // a node from its children, which must be up to date
+    void update(uint32_t node) {
+        uint32_t left = children[node][0], right = children[node][1];
+        Box box = boxOf(left);
+        box.grow(boxOf(right));
+        boxes[node] = box;
+        count[node] = countOf(left) + countOf(right);
+        height[node] = static_cast<uint8_t>(std::min(255u, 1 + std::max(heightOf(left), heightOf(right))));
+        float area = box.area();
+        float split = options.traversalCost * area + costOf(left) + costOf(right);
+        float leaf = count[node] <= options.maxLeafSize ? options.intersectionCost * area * count[node] : inf;
+        collapse[node] = leaf <= split;
+        cost[node] = std::min(leaf, split);
+    }
+
+    // Calls visit(node) for every internal node once both its children have been visited, on
+    // all cores: every triangle walks up, and the second one to arrive at a node goes on.
+    template <typename Visit>
+    void bottomUp(Visit&& visit) {
+        for (size_t i = 0; i < n - 1; ++i) visits[i].store(0, std::memory_order_relaxed);
+        parallelFor(0, n, [&](size_t leaf) {
+            uint32_t node = leafParent[leaf];
+            for (;;) {
+                if (visits[node].fetch_add(1, std::memory_order_acq_rel) == 0) return;
+                visit(node);
+                if (node == 0) return;
+                node = parent[node];
+            }
+        }, 1024);
+    }
+
+    // Opens the subtree under `root` into up to treeletSize subtrees, largest box first, finds
+    // the cheapest binary tree over them by trying every split of every subset, and rebuilds
+    // the treelet from its own internal nodes when that beats the current one.
+    void restructure(uint32_t root) {
+        uint32_t leaves[8] = {children[root][0], children[root][1]};
+        uint32_t internals[8] = {root};
+        unsigned leafCount = 2, internalCount = 1;
+        while (leafCount < treeletSize) {
+            int widest = -1;
+            float widestArea = -1.0f;
+            for (unsigned s = 0; s < leafCount; ++s) {
+                if (leaves[s] & leafFlag) continue;
+                float area = boxes[leaves[s]].area();
+                if (area > widestArea) {
+                    widestArea = area;
+                    widest = static_cast<int>(s);
+                }
+            }
+            if (widest < 0) break;
+            uint32_t opened = leaves[widest];
+            internals[internalCount++] = opened;
+            leaves[widest] = children[opened][0];
+            leaves[leafCount++] = children[opened][1];
+        }
+        if (leafCount < 3) return;
+
+        // subsets in increasing order see all of their own subsets first
+        const unsigned full = (1u << leafCount) - 1;
+        Box subsetBox[256];
+        float subsetCost[256];
+        uint32_t subsetCount[256];
+        uint8_t partition[256];
+        for (unsigned set = 1; set <= full; ++set) {
+            unsigned lowest = set & (0u - set);
+            if (set == lowest) {
+                unsigned s = static_cast<unsigned>(__builtin_ctz(set));
+                subsetBox[set] = boxOf(leaves[s]);
+                subsetCost[set] = costOf(leaves[s]);
+                subsetCount[set] = countOf(leaves[s]);
+                continue;
+            }
+            subsetBox[set] = subsetBox[set ^ lowest];
+            subsetBox[set].grow(subsetBox[lowest]);
+            subsetCount[set] = subsetCount[set ^ lowest] + subsetCount[lowest];
+            // each split once: the side holding the lowest member
+            float best = inf;
+            unsigned bestPart = lowest;
+            for (unsigned part = (set - 1) & set; part; part = (part - 1) & set) {
+                if (!(part & lowest)) continue;
+                float c = subsetCost[part] + subsetCost[set ^ part];
+                if (c < best) {
+                    best = c;
+                    bestPart = part;
+                }
+            }
+            float area = subsetBox[set].area();
+            float leaf = subsetCount[set] <= options.maxLeafSize ? options.intersectionCost * area * subsetCount[set] : inf;
+            subsetCost[set] = std::min(leaf, options.traversalCost * area + best);
+            partition[set] = static_cast<uint8_t>(bestPart);
+        }
+        if (!(subsetCost[full] < cost[root] * 0.9999f)) return;
+
+        unsigned nextInternal = 1;
+        auto rebuild = [&](auto& self, unsigned set, uint32_t node) -> void {
+            unsigned sides[2] = {partition[set], set ^ partition[set]};
+            for (int c = 0; c < 2; ++c) {
+                uint32_t child;
+                if ((sides[c] & (sides[c] - 1)) == 0) {
+                    child = leaves[__builtin_ctz(sides[c])];
+                } else {
+                    child = internals[nextInternal++];
+                    self(self, sides[c], child);
+                }
+                children[node][c] = child;
+                setParent(child, node);
+            }
+            update(node);
+        };
+        rebuild(rebuild, full, root);
+    }
+
+    // triangles under an internal node, in tree order; `stack` is scratch space
+    void gather(uint32_t node, std::vector<uint32_t>& triangles, std::vector<uint32_t>& stack) const {
+        stack.assign(1, node);
+        while (!stack.empty()) {
+            uint32_t child = stack.back();
+            stack.pop_back();
+            if (child & leafFlag) {
+                triangles.push_back(order[child & ~leafFlag]);
+            } else {
+                stack.push_back(children[child][1]);
+                stack.push_back(children[child][0]);
+            }
+        }
+    }
+
+    static void setBounds(BvhNode& node, const Box& box) {
+        std::copy(box.lo, box.lo + 3, node.boundsMin);
+        std::copy(box.hi, box.hi + 3, node.boundsMax);
+    }
+
+    void makeLeaf(Bvh& bvh, uint32_t index, const uint32_t* triangles, uint32_t size, const Box& box) const {
+        BvhNode& node = bvh.nodes[index];
+        setBounds(node, box);
+        node.first = static_cast<uint32_t>(bvh.primitives.size());
+        node.count = size;
+        bvh.primitives.insert(bvh.primitives.end(), triangles, triangles + size);
+    }
+
+    // halves a run of triangles down to leaves, for subtrees too deep for the traversal stack
+    void emitBalanced(Bvh& bvh, uint32_t index, const std::vector<uint32_t>& triangles) const {
+        struct Range {
+            uint32_t index, begin, end;
+        };
+        std::vector<Range> stack = {{index, 0, static_cast<uint32_t>(triangles.size())}};
+        while (!stack.empty()) {
+            Range range = stack.back();
+            stack.pop_back();
+            Box box;
+            for (uint32_t i = range.begin; i < range.end; ++i) box.grow(triangleBoxes[triangles[i]]);
+            uint32_t size = range.end - range.begin;
+            if (size <= std::max(1u, options.maxLeafSize)) {
+                makeLeaf(bvh, range.index, &triangles[range.begin], size, box);
+                continue;
+            }
+            BvhNode& node = bvh.nodes[range.index];
+            setBounds(node, box);
+            node.first = static_cast<uint32_t>(bvh.nodes.size());
+            node.count = 0;
+            uint32_t middle = range.begin + size / 2;
+            stack.push_back({node.first + 1, middle, range.end});
+            stack.push_back({node.first, range.begin, middle});
+            bvh.nodes.resize(bvh.nodes.size() + 2);
+        }
+    }
+
+    // the radix tree in BvhNode layout: depth first, so every subtree owns a contiguous run of
+    // primitives and children come after their parents
+    void emit(Bvh& bvh) const {
+        bvh.nodes.reserve(2 * n);
+        bvh.nodes.assign(1, BvhNode());
+        bvh.primitives.reserve(n);
+        struct Item {
+            uint32_t child, index;
+            unsigned depth;
+        };
+        std::vector<Item> stack = {{0, 0, 0}};
+        std::vector<uint32_t> triangles, scratch;
+        while (!stack.empty()) {
+            Item item = stack.back();
+            stack.pop_back();
+            if (item.child & leafFlag) {
+                uint32_t triangle = order[item.child & ~leafFlag];
+                makeLeaf(bvh, item.index, &triangle, 1, triangleBoxes[triangle]);
+                continue;
+            }
+            bool tooDeep = item.depth >= bvhMaxDepth / 2 && height[item.child] > bvhMaxDepth / 2;
+            if (collapse[item.child] || tooDeep) {
+                triangles.clear();
+                gather(item.child, triangles, scratch);
+                if (tooDeep) {
+                    emitBalanced(bvh, item.index, triangles);
+                } else {
+                    makeLeaf(bvh, item.index, triangles.data(), static_cast<uint32_t>(triangles.size()), boxes[item.child]);
+                }
+                continue;
+            }
+            BvhNode& node = bvh.nodes[item.index];
+            setBounds(node, boxes[item.child]);
+            node.first = static_cast<uint32_t>(bvh.nodes.size());
+            node.count = 0;
+            stack.push_back({children[item.child][1], node.first + 1, item.depth + 1});
+            stack.push_back({children[item.child][0], node.first, item.depth + 1});
+            bvh.nodes.resize(bvh.nodes.size() + 2);
+        }
+    }
+};
+
+}
+
+Bvh buildLbvh(const TriangleGeometry& geometry, const LbvhBuildOptions& options) {
+    auto start = std::chrono::steady_clock::now();
+    Bvh bvh;
+    if (geometry.triangleCount < 2) {
+        // no radix tree: an empty leaf whose inverted bounds no ray enters, or one triangle
+        BvhNode root = {{inf, inf, inf}, 0, {-inf, -inf, -inf}, 0};
+        if (geometry.triangleCount == 1) {
+            for (int k = 0; k < 3; ++k) {
+                const float* v = geometry.vertex(geometry.indices[k]);
+                for (int a = 0; a < 3; ++a) {
+                    root.boundsMin[a] = std::min(root.boundsMin[a], v[a]);
+                    root.boundsMax[a] = std::max(root.boundsMax[a], v[a]);
+                }
+            }
+            root.count = 1;
+            bvh.primitives.assign(1, 0);
+        }
+        bvh.nodes.assign(1, root);
+    } else {
+        Builder(geometry, options).build(bvh);
+    }
+    bvh.stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    BvhBuildOptions costs;
+    costs.maxLeafSize = options.maxLeafSize;
+    costs.traversalCost = options.traversalCost;
+    costs.intersectionCost = options.intersectionCost;
+    updateBvhStats(bvh, costs);
+    return bvh;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Bvh.hpp"
+
+// Linear BVH for geometry that changes every frame, after Karras 2012: triangle centroids are
+// sorted along a Morton curve with a parallel radix sort and every internal node of the binary
+// radix tree over the sorted codes is found independently. Building is a few linear passes, so
+// it takes milliseconds where the SAH build takes seconds, for a tree that traces slower.
+// Treelet restructuring (Karras and Aila 2013) wins back much of the difference: every
+// treelet of up to seven subtrees is rearranged into its cheapest topology by the SAH.
+struct LbvhBuildOptions {
+    unsigned mortonBits = 30;       // 30 (10 per axis) or 63 (21 per axis), for very large or uneven scenes
+    unsigned restructurePasses = 0; // treelet rounds, each one about as expensive as the rest of the build
+    unsigned treeletSize = 7;       // subtrees per treelet, 3 to 8; the search grows with 3^treeletSize
+    unsigned maxLeafSize = 8;       // subtrees up to this size become leaves where the SAH prefers it
+    float traversalCost = 1.0f;
+    float intersectionCost = 1.0f;
+};
+
+// a tree in the same layout as buildBvh's, usable everywhere one of those is
+Bvh buildLbvh(const TriangleGeometry& geometry, const LbvhBuildOptions& options = {});
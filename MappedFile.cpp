@@ -0,0 +1,51 @@
+#include "MappedFile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdexcept>
+#include <utility>
+
+MappedFile::MappedFile(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("Failed to open file: " + path);
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        throw std::runtime_error("Failed to stat file: " + path);
+    }
+
+    length = static_cast<size_t>(info.st_size);
+    if (length > 0) {
+        ptr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED) {
+            ptr = nullptr;
+            close(fd);
+            throw std::runtime_error("Failed to map file: " + path);
+        }
+    }
+
+    // the mapping keeps the file alive on its own
+    close(fd);
+}
+
+MappedFile::~MappedFile() {
+    if (ptr) munmap(ptr, length);
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+    : ptr(std::exchange(other.ptr, nullptr)), length(std::exchange(other.length, 0)) {}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        if (ptr) munmap(ptr, length);
+        ptr = std::exchange(other.ptr, nullptr);
+        length = std::exchange(other.length, 0);
+    }
+    return *this;
+}
@@ -0,0 +1,84 @@
+#include "Mesh.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+std::vector<float> primitiveNormals(const Mesh& mesh) {
+    return primitiveNormals(mesh.vertices.data(), mesh.normals.empty() ? nullptr : mesh.normals.data(),
+                            mesh.indices.data(), mesh.indices.size() / 3);
+}
+
+std::vector<float> primitiveNormals(const float* vertices, const float* normals, const unsigned int* indices,
+                                    size_t triangles) {
+    std::vector<float> data(triangles * 9);
+
+    parallelFor(0, triangles, [&](size_t t) {
+        const unsigned int* tri = &indices[3 * t];
+        float* out = &data[9 * t];
+
+        if (normals) {
+            for (int k = 0; k < 3; ++k) {
+                out[3 * k + 0] = normals[3 * tri[k] + 0];
+                out[3 * k + 1] = normals[3 * tri[k] + 1];
+                out[3 * k + 2] = normals[3 * tri[k] + 2];
+            }
+            return;
+        }
+
+        const float* a = &vertices[3 * tri[0]];
+        const float* b = &vertices[3 * tri[1]];
+        const float* c = &vertices[3 * tri[2]];
+        float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+        if (length > 0.0f) {
+            n[0] /= length; n[1] /= length; n[2] /= length;
+        }
+        for (int k = 0; k < 3; ++k) {
+            out[3 * k + 0] = n[0];
+            out[3 * k + 1] = n[1];
+            out[3 * k + 2] = n[2];
+        }
+    }, 4096);
+
+    return data;
+}
+
+void meshBounds(const Mesh& mesh, float boundsMin[3], float boundsMax[3]) {
+    meshBounds(mesh.vertices.data(), mesh.vertices.size() / 3, boundsMin, boundsMax);
+}
+
+void meshBounds(const float* vertices, size_t vertexCount, float boundsMin[3], float boundsMax[3]) {
+    const float inf = std::numeric_limits<float>::infinity();
+    size_t blockSize = 1 << 16;
+    size_t blocks = (vertexCount + blockSize - 1) / blockSize;
+    std::vector<float> partial(blocks * 6);
+
+    parallelFor(0, blocks, [&](size_t b) {
+        float* lo = &partial[6 * b];
+        float* hi = lo + 3;
+        lo[0] = lo[1] = lo[2] = inf;
+        hi[0] = hi[1] = hi[2] = -inf;
+        size_t last = std::min(vertexCount, (b + 1) * blockSize);
+        for (size_t v = b * blockSize; v < last; ++v) {
+            for (int k = 0; k < 3; ++k) {
+                lo[k] = std::min(lo[k], vertices[3 * v + k]);
+                hi[k] = std::max(hi[k], vertices[3 * v + k]);
+            }
+        }
+    });
+
+    for (int k = 0; k < 3; ++k) {
+        boundsMin[k] = blocks ? inf : 0.0f;
+        boundsMax[k] = blocks ? -inf : 0.0f;
+    }
+    for (size_t b = 0; b < blocks; ++b) {
+        for (int k = 0; k < 3; ++k) {
+            boundsMin[k] = std::min(boundsMin[k], partial[6 * b + k]);
+            boundsMax[k] = std::max(boundsMax[k], partial[6 * b + 3 + k]);
+        }
+    }
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// indexed triangle mesh. attributes are per vertex, three indices per triangle
+struct Mesh {
+    std::vector<float> vertices;    // x, y, z positions
+    std::vector<float> normals;     // x, y, z normals
+    std::vector<float> texcoords;   // u, v texture coordinates
+    std::vector<unsigned int> indices; // Face indices
+};
+
+// Three normals per triangle, the per-primitive layout compute_kernel reads.
+// Meshes without vertex normals get their flat face normal instead.
+std::vector<float> primitiveNormals(const Mesh& mesh);
+// the same over arrays that aren't in a Mesh, such as mapped ones; normals may be null
+std::vector<float> primitiveNormals(const float* vertices, const float* normals, const unsigned int* indices,
+                                    size_t triangleCount);
+
+// axis-aligned bounds of all vertex positions
+void meshBounds(const Mesh& mesh, float boundsMin[3], float boundsMax[3]);
+void meshBounds(const float* vertices, size_t vertexCount, float boundsMin[3], float boundsMax[3]);
@@ -0,0 +1,302 @@
+#include "MeshCache.hpp"
+#include "MeshLoader.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+// Layout of a .cmesh file, little endian:
+//   CMeshHeader
+//   sections, each starting on a 16 KiB boundary (the Apple silicon page size) so they
+//   can be wrapped by no-copy buffers, and zero padded to the next boundary
+const char cmeshMagic[8] = {'C', 'O', 'B', 'M', 'E', 'S', 'H', '\0'};
+const uint32_t cmeshVersion = 1;
+// part of the key: bump whenever loadMesh gives a different mesh for the same file and scale
+// (2: loads go through loadMesh, which picks the loader by extension;
+//  3: mirrored glTF nodes keep their winding and normals, PLY faces are checked against the
+//     vertex count)
+const uint32_t cmeshLoaderVersion = 3;
+const uint64_t cmeshAlignment = 16384;
+
+enum CMeshSection {
+    SectionVertices,
+    SectionNormals,
+    SectionTexcoords,
+    SectionIndices,
+    SectionPrimitiveNormals,
+    SectionCount
+};
+
+struct CMeshHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+
+    // cache key: the source file and every loader option that changes the output
+    uint64_t sourceSize;
+    uint64_t sourceHash;
+    float scale;
+
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t loaderVersion;
+
+    uint64_t vertexCount;
+    uint64_t triangleCount;
+    uint64_t offsets[SectionCount];
+    uint64_t sizes[SectionCount];
+};
+
+inline uint64_t mix(uint64_t h) {
+    h ^= h >> 33; h *= 0xFF51AFD7ED558CCDull;
+    h ^= h >> 33; h *= 0xC4CEB9FE1A85EC53ull;
+    h ^= h >> 33;
+    return h;
+}
+
+// four independent lanes so the multiply chains overlap
+uint64_t hashBlock(const unsigned char* data, size_t size, uint64_t seed) {
+    const uint64_t k = 0x9E3779B97F4A7C15ull;
+    uint64_t lanes[4] = {seed, seed ^ k, seed + k, seed - k};
+    size_t i = 0;
+    for (; i + 32 <= size; i += 32) {
+        for (int l = 0; l < 4; ++l) {
+            uint64_t word;
+            std::memcpy(&word, data + i + 8 * l, 8);
+            lanes[l] = (lanes[l] ^ word) * k;
+            lanes[l] ^= lanes[l] >> 29;
+        }
+    }
+    uint64_t h = mix(lanes[0]) ^ mix(lanes[1] + 1) ^ mix(lanes[2] + 2) ^ mix(lanes[3] + 3);
+    for (; i < size; ++i) h = (h ^ data[i]) * k;
+    return mix(h ^ size);
+}
+
+uint64_t alignUp(uint64_t value) {
+    return (value + cmeshAlignment - 1) / cmeshAlignment * cmeshAlignment;
+}
+
+std::string cachePath(const std::string& filepath) {
+    return filepath + ".cmesh";
+}
+
+bool isGLB(const std::string& filepath) {
+    size_t dot = filepath.find_last_of('.');
+    if (dot == std::string::npos) return false;
+    std::string extension = filepath.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return extension == "glb";
+}
+
+// maps the cache and checks it against the key. returns false on any mismatch
+bool openCache(const std::string& path, uint64_t sourceSize, uint64_t sourceHash, float scale, CachedMesh& out,
+               std::unique_ptr<MappedFile>& file) {
+    try {
+        file = std::make_unique<MappedFile>(path);
+    } catch (const std::exception&) {
+        return false;
+    }
+
+    if (file->size() < sizeof(CMeshHeader)) return false;
+    CMeshHeader header;
+    std::memcpy(&header, file->data(), sizeof(header));
+
+    if (std::memcmp(header.magic, cmeshMagic, sizeof(cmeshMagic)) != 0) return false;
+    if (header.version != cmeshVersion || header.headerSize != sizeof(CMeshHeader)) return false;
+    if (header.sourceSize != sourceSize || header.sourceHash != sourceHash) return false;
+    if (std::memcmp(&header.scale, &scale, sizeof(float)) != 0) return false;
+    if (header.loaderVersion != cmeshLoaderVersion) return false;
+
+    // counts first, so a damaged one can't wrap the sizes around
+    if (header.vertexCount > file->size() / (3 * sizeof(float)) ||
+        header.triangleCount > file->size() / (3 * sizeof(unsigned int))) {
+        return false;
+    }
+    const uint64_t expected[SectionCount] = {
+        header.vertexCount * 3 * sizeof(float),
+        header.vertexCount * 3 * sizeof(float),
+        header.vertexCount * 2 * sizeof(float),
+        header.triangleCount * 3 * sizeof(unsigned int),
+        header.triangleCount * 9 * sizeof(float),
+    };
+    for (int s = 0; s < SectionCount; ++s) {
+        if (header.sizes[s] != 0 && header.sizes[s] != expected[s]) return false;
+        if (header.offsets[s] % cmeshAlignment != 0) return false;
+        if (header.offsets[s] > file->size() || header.sizes[s] > file->size() - header.offsets[s]) return false;
+    }
+    if (header.sizes[SectionVertices] != expected[SectionVertices] ||
+        header.sizes[SectionIndices] != expected[SectionIndices] ||
+        header.sizes[SectionPrimitiveNormals] != expected[SectionPrimitiveNormals]) {
+        return false;
+    }
+
+    auto section = [&](int s) -> const char* {
+        return header.sizes[s] ? file->data() + header.offsets[s] : nullptr;
+    };
+    out.vertices = reinterpret_cast<const float*>(section(SectionVertices));
+    out.normals = reinterpret_cast<const float*>(section(SectionNormals));
+    out.texcoords = reinterpret_cast<const float*>(section(SectionTexcoords));
+    out.indices = reinterpret_cast<const unsigned int*>(section(SectionIndices));
+    out.primitiveNormals = reinterpret_cast<const float*>(section(SectionPrimitiveNormals));
+
+    // indices go straight to BLAS creation and traversal, so none may point past the vertices
+    std::atomic<bool> valid{true};
+    size_t indexCount = 3 * header.triangleCount;
+    parallelFor(0, indexCount, [&](size_t i) {
+        if (out.indices[i] >= header.vertexCount) valid = false;
+    }, 1 << 16);
+    if (!valid) return false;
+
+    out.vertexCount = header.vertexCount;
+    out.triangleCount = header.triangleCount;
+    std::memcpy(out.boundsMin, header.boundsMin, sizeof(header.boundsMin));
+    std::memcpy(out.boundsMax, header.boundsMax, sizeof(header.boundsMax));
+    return true;
+}
+
+// writes to a temporary file and renames it over the cache, so readers never see half a file
+void writeCache(const std::string& path, const CMeshHeader& key, const CachedMesh& mesh) {
+    CMeshHeader header = key;
+    header.vertexCount = mesh.vertexCount;
+    header.triangleCount = mesh.triangleCount;
+    std::memcpy(header.boundsMin, mesh.boundsMin, sizeof(header.boundsMin));
+    std::memcpy(header.boundsMax, mesh.boundsMax, sizeof(header.boundsMax));
+
+    const void* data[SectionCount] = {mesh.vertices, mesh.normals, mesh.texcoords, mesh.indices, mesh.primitiveNormals};
+    const uint64_t sizes[SectionCount] = {
+        mesh.vertexCount * 3 * sizeof(float),
+        mesh.normals ? mesh.vertexCount * 3 * sizeof(float) : 0,
+        mesh.texcoords ? mesh.vertexCount * 2 * sizeof(float) : 0,
+        mesh.triangleCount * 3 * sizeof(unsigned int),
+        mesh.triangleCount * 9 * sizeof(float),
+    };
+    uint64_t offset = alignUp(sizeof(CMeshHeader));
+    for (int s = 0; s < SectionCount; ++s) {
+        header.offsets[s] = offset;
+        header.sizes[s] = sizes[s];
+        offset = alignUp(offset + sizes[s]);
+    }
+
+    std::string temp = path + ".tmp";
+    std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        std::cerr << "Warning: could not write mesh cache " << path << std::endl;
+        return;
+    }
+
+    static const char zeros[cmeshAlignment] = {};
+    uint64_t written = 0;
+    auto pad = [&](uint64_t to) {
+        out.write(zeros, static_cast<std::streamsize>(to - written));
+        written = to;
+    };
+
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    written = sizeof(header);
+    for (int s = 0; s < SectionCount; ++s) {
+        pad(header.offsets[s]);
+        if (sizes[s]) out.write(static_cast<const char*>(data[s]), static_cast<std::streamsize>(sizes[s]));
+        written += sizes[s];
+    }
+    pad(offset);
+    out.close();
+
+    if (!out || std::rename(temp.c_str(), path.c_str()) != 0) {
+        std::remove(temp.c_str());
+        std::cerr << "Warning: could not write mesh cache " << path << std::endl;
+    }
+}
+
+}
+
+uint64_t contentHash(const void* data, size_t size) {
+    const size_t blockSize = 1 << 20;
+    size_t blocks = (size + blockSize - 1) / blockSize;
+    std::vector<uint64_t> hashes(blocks);
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+    parallelFor(0, blocks, [&](size_t b) {
+        size_t first = b * blockSize;
+        hashes[b] = hashBlock(bytes + first, std::min(blockSize, size - first), b);
+    });
+
+    uint64_t h = mix(size + 0x9E3779B97F4A7C15ull);
+    for (uint64_t blockHash : hashes) h = mix(h ^ blockHash) + 0x9E3779B97F4A7C15ull;
+    return h;
+}
+
+CachedMesh loadCachedMesh(const std::string& filepath, float scale) {
+    auto start = std::chrono::steady_clock::now();
+
+    CMeshHeader key = {};
+    std::memcpy(key.magic, cmeshMagic, sizeof(cmeshMagic));
+    key.version = cmeshVersion;
+    key.headerSize = sizeof(CMeshHeader);
+    key.scale = scale;
+    key.loaderVersion = cmeshLoaderVersion;
+    {
+        MappedFile source(filepath);
+        key.sourceSize = source.size();
+        key.sourceHash = contentHash(source.data(), source.size());
+    }
+
+    CachedMesh result;
+    std::string path = cachePath(filepath);
+    if (openCache(path, key.sourceSize, key.sourceHash, scale, result, result.file)) {
+        result.fromCache = true;
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Mapped mesh cache " << path << " in " << ms << " ms" << std::endl;
+        return result;
+    }
+    result.file.reset();
+
+    // cache miss, do the full load and write the cache for next time. A .glb whose default
+    // scene already is the world-space mesh skips the flattening copy: its views are handed on
+    // as they are, straight from the mapping wherever the accessors allowed it
+    if (isGLB(filepath)) {
+        auto scene = std::make_unique<GltfScene>(loadGLBScene(filepath));
+        const GltfPrimitive* primitive = untransformedPrimitive(*scene);
+        if (primitive && scale == 1.0f) {
+            result.vertices = primitive->positions;
+            result.normals = primitive->normals;
+            result.texcoords = primitive->texcoords;
+            result.indices = primitive->indices;
+            result.vertexCount = primitive->vertexCount;
+            result.triangleCount = primitive->triangleCount;
+            result.triangleNormals = primitiveNormals(result.vertices, result.normals, result.indices, result.triangleCount);
+            result.primitiveNormals = result.triangleNormals.data();
+            meshBounds(result.vertices, result.vertexCount, result.boundsMin, result.boundsMax);
+            std::cout << "Using " << filepath << " in place: " << scene->mappedArrays << " arrays mapped, "
+                      << scene->convertedArrays << " converted" << std::endl;
+            result.scene = std::move(scene);
+            writeCache(path, key, result);
+            return result;
+        }
+        result.mesh = flattenGLBScene(*scene, scale, filepath);
+    } else {
+        result.mesh = loadMesh(filepath, scale);
+    }
+    result.triangleNormals = primitiveNormals(result.mesh);
+    meshBounds(result.mesh, result.boundsMin, result.boundsMax);
+
+    const Mesh& mesh = result.mesh;
+    result.vertices = mesh.vertices.data();
+    result.normals = mesh.normals.empty() ? nullptr : mesh.normals.data();
+    result.texcoords = mesh.texcoords.empty() ? nullptr : mesh.texcoords.data();
+    result.indices = mesh.indices.data();
+    result.primitiveNormals = result.triangleNormals.data();
+    result.vertexCount = mesh.vertices.size() / 3;
+    result.triangleCount = mesh.indices.size() / 3;
+
+    writeCache(path, key, result);
+    return result;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "GltfLoader.hpp"
+#include "MappedFile.hpp"
+#include "Mesh.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+// Mesh data ready for buffer creation. On a warm start the arrays point straight
+// into the mapped .cmesh file; after a miss they point into the freshly loaded mesh, or
+// into the mapped .glb when it needs no flattening (see untransformedPrimitive).
+struct CachedMesh {
+    const float* vertices = nullptr;          // x, y, z per vertex
+    const float* normals = nullptr;           // x, y, z per vertex, null if the source has none
+    const float* texcoords = nullptr;         // u, v per vertex, null if the source has none
+    const unsigned int* indices = nullptr;    // three per triangle
+    const float* primitiveNormals = nullptr;  // nine per triangle, see primitiveNormals()
+    size_t vertexCount = 0;
+    size_t triangleCount = 0;
+    float boundsMin[3] = {0.0f, 0.0f, 0.0f};
+    float boundsMax[3] = {0.0f, 0.0f, 0.0f};
+    bool fromCache = false;
+
+    CachedMesh() = default;
+    CachedMesh(const CachedMesh&) = delete;
+    CachedMesh& operator=(const CachedMesh&) = delete;
+    CachedMesh(CachedMesh&&) = default;
+    CachedMesh& operator=(CachedMesh&&) = default;
+
+private:
+    friend CachedMesh loadCachedMesh(const std::string& filepath, float scale);
+
+    // storage behind the pointers, only one of them is ever used besides triangleNormals
+    std::unique_ptr<MappedFile> file;
+    std::unique_ptr<GltfScene> scene;
+    Mesh mesh;
+    std::vector<float> triangleNormals;
+};
+
+// Loads a mesh through its binary cache at `filepath + ".cmesh"`. The cache is keyed on
+// the content hash of the source file, the loader options and the loader's version, so an
+// edited source, a different scale or a changed loader rebuilds it, as does a damaged file.
+// A cache that can't be written only costs a warning.
+CachedMesh loadCachedMesh(const std::string& filepath, float scale = 1.0);
+
+// 64-bit hash of a block of memory, computed on all cores. stable across runs and thread counts
+uint64_t contentHash(const void* data, size_t size);
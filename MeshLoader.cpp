@@ -0,0 +1,723 @@
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include "MeshLoader.hpp"
+#include "MappedFile.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <climits>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+
+// a relative (negative) index can only be resolved once the attribute counts
+// of all earlier chunks are known, so we remember where it went and patch it later
+struct Fixup {
+    size_t slot;        // position in ObjChunk::corners
+    long long local;    // index relative to the first attribute of the chunk
+};
+
+// one newline-aligned slice of the file, parsed independently of the others
+struct ObjChunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+
+    std::vector<float> positions;   // x, y, z
+    std::vector<float> normals;     // x, y, z
+    std::vector<float> texcoords;   // u, v
+
+    // three corners per (triangulated) face, each corner is (v, vt, vn). -1 marks a missing vt/vn
+    std::vector<int> corners;
+    std::vector<Fixup> fixups;
+
+    // first corner of every quad, the diagonal is picked once all positions are known
+    std::vector<size_t> quads;
+};
+
+// one reference of an 'f' record, resolved as far as the chunk can on its own
+struct Corner {
+    long long index[3];  // v, vt, vn
+    bool relative[3];
+};
+
+inline bool isBlank(char c) { return c == ' ' || c == '\t'; }
+
+inline const char* skipBlank(const char* p, const char* end) {
+    while (p < end && isBlank(*p)) ++p;
+    return p;
+}
+
+inline const char* tokenEnd(const char* p, const char* end) {
+    while (p < end && !isBlank(*p) && *p != '\r') ++p;
+    return p;
+}
+
+// same number grammar as tinyobj so both paths agree on every value
+float parseFloat(const char*& p, const char* end, double fallback = 0.0) {
+    p = skipBlank(p, end);
+    const char* last = tokenEnd(p, end);
+    double value = fallback;
+    tinyobj::tryParseDouble(p, last, &value);
+    p = last;
+    return static_cast<float>(value);
+}
+
+// parses an optionally signed integer, returns false if there are no digits
+bool parseIndex(const char*& p, const char* end, long long& out) {
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+')) {
+        negative = (*p == '-');
+        ++p;
+    }
+    if (p >= end || *p < '0' || *p > '9') return false;
+
+    long long value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + (*p - '0');
+        ++p;
+    }
+    out = negative ? -value : value;
+    return true;
+}
+
+// resolves a raw 1-based (or negative, relative) OBJ index against the chunk-local count
+void resolveIndex(long long raw, size_t count, long long& index, bool& relative) {
+    relative = raw < 0;
+    if (raw > 0) index = raw - 1;
+    else if (raw < 0) index = static_cast<long long>(count) + raw;
+    else index = -1;
+}
+
+// parses "v", "v/vt", "v//vn" or "v/vt/vn"
+bool parseCorner(const char*& p, const char* end, const ObjChunk& chunk, Corner& corner) {
+    long long raw[3] = {0, 0, 0};
+    if (!parseIndex(p, end, raw[0]) || raw[0] == 0) return false;
+
+    if (p < end && *p == '/') {
+        ++p;
+        if (p < end && *p != '/') {
+            if (!parseIndex(p, end, raw[1])) return false;
+        }
+        if (p < end && *p == '/') {
+            ++p;
+            if (!parseIndex(p, end, raw[2])) return false;
+        }
+    }
+
+    resolveIndex(raw[0], chunk.positions.size() / 3, corner.index[0], corner.relative[0]);
+    resolveIndex(raw[1], chunk.texcoords.size() / 2, corner.index[1], corner.relative[1]);
+    resolveIndex(raw[2], chunk.normals.size() / 3, corner.index[2], corner.relative[2]);
+    return true;
+}
+
+// indices that don't fit the corner storage become INT_MAX, which fails the range check on merge
+inline int storeIndex(long long index) {
+    return index > INT_MAX || index < -1 ? INT_MAX : static_cast<int>(index);
+}
+
+void emitCorner(ObjChunk& chunk, const Corner& corner) {
+    for (int a = 0; a < 3; ++a) {
+        if (corner.relative[a]) {
+            chunk.fixups.push_back({chunk.corners.size(), corner.index[a]});
+            chunk.corners.push_back(-1);
+        } else {
+            chunk.corners.push_back(storeIndex(corner.index[a]));
+        }
+    }
+}
+
+void parseChunk(ObjChunk& chunk) {
+    std::vector<Corner> polygon;
+    const char* line = chunk.begin;
+
+    while (line < chunk.end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', chunk.end - line));
+        if (!lineEnd) lineEnd = chunk.end;
+
+        const char* p = skipBlank(line, lineEnd);
+        size_t left = lineEnd - p;
+
+        if (left >= 2 && p[0] == 'v' && isBlank(p[1])) {
+            p += 2;
+            chunk.positions.push_back(parseFloat(p, lineEnd));
+            chunk.positions.push_back(parseFloat(p, lineEnd));
+            chunk.positions.push_back(parseFloat(p, lineEnd));
+        } else if (left >= 3 && p[0] == 'v' && p[1] == 'n' && isBlank(p[2])) {
+            p += 3;
+            chunk.normals.push_back(parseFloat(p, lineEnd));
+            chunk.normals.push_back(parseFloat(p, lineEnd));
+            chunk.normals.push_back(parseFloat(p, lineEnd));
+        } else if (left >= 3 && p[0] == 'v' && p[1] == 't' && isBlank(p[2])) {
+            p += 3;
+            chunk.texcoords.push_back(parseFloat(p, lineEnd));
+            chunk.texcoords.push_back(parseFloat(p, lineEnd));
+        } else if (left >= 2 && p[0] == 'f' && isBlank(p[1])) {
+            p += 2;
+            polygon.clear();
+            for (;;) {
+                p = skipBlank(p, lineEnd);
+                if (p >= lineEnd || *p == '\r') break;
+                Corner corner;
+                if (!parseCorner(p, lineEnd, chunk, corner)) {
+                    throw std::runtime_error("Failed to load OBJ file: malformed face '" +
+                                             std::string(line, lineEnd) + "'");
+                }
+                polygon.push_back(corner);
+            }
+
+            // quads are split along their shorter diagonal during merge, like tinyobj does.
+            // larger polygons are fanned, which is fine for the convex faces scanners write
+            if (polygon.size() == 4) chunk.quads.push_back(chunk.corners.size());
+            for (size_t v = 1; v + 1 < polygon.size(); ++v) {
+                emitCorner(chunk, polygon[0]);
+                emitCorner(chunk, polygon[v]);
+                emitCorner(chunk, polygon[v + 1]);
+            }
+        }
+        // anything else (comments, groups, materials, lines, points) is ignored
+
+        line = lineEnd + 1;
+    }
+}
+
+// splits [data, data + size) into roughly equal pieces that end right after a newline
+std::vector<ObjChunk> splitChunks(const char* data, size_t size) {
+    const size_t minChunk = 1 << 20;
+    size_t count = std::max<size_t>(1, std::min<size_t>(threadCount() * 8, size / minChunk));
+
+    std::vector<ObjChunk> chunks;
+    const char* begin = data;
+    const char* end = data + size;
+    for (size_t i = 1; i <= count && begin < end; ++i) {
+        const char* split = (i == count) ? end : data + size * i / count;
+        if (split < begin) continue;
+        if (split < end) {
+            const char* newline = static_cast<const char*>(std::memchr(split, '\n', end - split));
+            split = newline ? newline + 1 : end;
+        }
+        ObjChunk chunk;
+        chunk.begin = begin;
+        chunk.end = split;
+        chunks.push_back(std::move(chunk));
+        begin = split;
+    }
+    return chunks;
+}
+
+// 64-bit mix of a corner's (v, vt, vn) triple. the top bits pick the weld partition, the low bits the table slot
+inline uint64_t hashCorner(const int* corner) {
+    uint64_t h = static_cast<uint32_t>(corner[0]) * 0x9E3779B97F4A7C15ull;
+    h ^= (static_cast<uint64_t>(static_cast<uint32_t>(corner[1])) << 32) | static_cast<uint32_t>(corner[2]);
+    h ^= h >> 30; h *= 0xBF58476D1CE4E5B9ull;
+    h ^= h >> 27; h *= 0x94D049BB133111EBull;
+    h ^= h >> 31;
+    return h;
+}
+
+inline bool sameCorner(const int* a, const int* b) {
+    return a[0] == b[0] && a[1] == b[1] && a[2] == b[2];
+}
+
+// Welds face corners into unique (position, texcoord, normal) vertices and a real index buffer.
+// Corners are bucketed by hash into partitions of about a million entries, and every partition
+// is welded on its own with a small open-addressing table, so the tables in flight stay bounded
+// by the thread count rather than the mesh size.
+Mesh weldCorners(const std::vector<int>& corners, const std::vector<float>& positions,
+                 const std::vector<float>& normals, const std::vector<float>& texcoords,
+                 float scale, const std::string& filepath) {
+    const size_t cornerCount = corners.size() / 3;
+    if (cornerCount >= UINT32_MAX) {
+        throw std::runtime_error("Failed to load OBJ file: too many face corners in " + filepath);
+    }
+
+    const long long positionCount = static_cast<long long>(positions.size() / 3);
+    const long long normalCount = static_cast<long long>(normals.size() / 3);
+    const long long texcoordCount = static_cast<long long>(texcoords.size() / 2);
+
+    unsigned partitionBits = 0;
+    while (partitionBits < 16 && ((size_t(1) << partitionBits) < threadCount() * 4 || (cornerCount >> partitionBits) > (1 << 20))) {
+        ++partitionBits;
+    }
+    const size_t partitions = size_t(1) << partitionBits;
+    auto partitionOf = [&](const int* corner) {
+        return partitionBits ? static_cast<size_t>(hashCorner(corner) >> (64 - partitionBits)) : 0;
+    };
+
+    // counting sort of corner ids by partition, in blocks so both passes run in parallel
+    const size_t blockSize = 1 << 16;
+    const size_t blocks = (cornerCount + blockSize - 1) / blockSize;
+    std::vector<uint32_t> offsets(blocks * partitions, 0);
+
+    parallelFor(0, blocks, [&](size_t b) {
+        uint32_t* count = &offsets[b * partitions];
+        size_t last = std::min(cornerCount, (b + 1) * blockSize);
+        for (size_t g = b * blockSize; g < last; ++g) {
+            const int* corner = &corners[3 * g];
+            if (corner[0] < 0 || corner[0] >= positionCount || corner[1] >= texcoordCount || corner[2] >= normalCount) {
+                throw std::runtime_error("Failed to load OBJ file: face index out of range in " + filepath);
+            }
+            count[partitionOf(corner)]++;
+        }
+    });
+
+    std::vector<size_t> partitionStart(partitions + 1, 0);
+    size_t running = 0;
+    for (size_t p = 0; p < partitions; ++p) {
+        partitionStart[p] = running;
+        for (size_t b = 0; b < blocks; ++b) {
+            uint32_t count = offsets[b * partitions + p];
+            offsets[b * partitions + p] = static_cast<uint32_t>(running);
+            running += count;
+        }
+    }
+    partitionStart[partitions] = running;
+
+    std::vector<uint32_t> sorted(cornerCount);
+    parallelFor(0, blocks, [&](size_t b) {
+        uint32_t* offset = &offsets[b * partitions];
+        size_t last = std::min(cornerCount, (b + 1) * blockSize);
+        for (size_t g = b * blockSize; g < last; ++g) {
+            sorted[offset[partitionOf(&corners[3 * g])]++] = static_cast<uint32_t>(g);
+        }
+    });
+    std::vector<uint32_t>().swap(offsets);
+
+    // weld every partition, recording the first corner of each unique vertex
+    Mesh mesh;
+    mesh.indices.resize(cornerCount);
+    std::vector<std::vector<uint32_t>> uniques(partitions);
+
+    parallelFor(0, partitions, [&](size_t p) {
+        size_t first = partitionStart[p], last = partitionStart[p + 1];
+        size_t capacity = 16;
+        while (capacity < 2 * (last - first)) capacity <<= 1;
+        const uint32_t empty = UINT32_MAX;
+        std::vector<uint32_t> table(capacity, empty);
+        std::vector<uint32_t>& unique = uniques[p];
+
+        for (size_t s = first; s < last; ++s) {
+            uint32_t g = sorted[s];
+            const int* corner = &corners[3 * g];
+            size_t slot = hashCorner(corner) & (capacity - 1);
+            for (;;) {
+                uint32_t id = table[slot];
+                if (id == empty) {
+                    id = static_cast<uint32_t>(unique.size());
+                    table[slot] = id;
+                    unique.push_back(g);
+                    mesh.indices[g] = id;
+                    break;
+                }
+                if (sameCorner(corner, &corners[3 * unique[id]])) {
+                    mesh.indices[g] = id;
+                    break;
+                }
+                slot = (slot + 1) & (capacity - 1);
+            }
+        }
+    }, 1);
+
+    std::vector<size_t> vertexBase(partitions + 1, 0);
+    for (size_t p = 0; p < partitions; ++p) vertexBase[p + 1] = vertexBase[p] + uniques[p].size();
+    const size_t vertexCount = vertexBase[partitions];
+
+    // emit the unique vertices and turn partition-local ids into global indices.
+    // corners missing a normal or texcoord get zeros when the rest of the file has them
+    mesh.vertices.resize(vertexCount * 3);
+    if (normalCount) mesh.normals.resize(vertexCount * 3, 0.0f);
+    if (texcoordCount) mesh.texcoords.resize(vertexCount * 2, 0.0f);
+
+    parallelFor(0, partitions, [&](size_t p) {
+        const std::vector<uint32_t>& unique = uniques[p];
+        for (size_t local = 0; local < unique.size(); ++local) {
+            const int* corner = &corners[3 * unique[local]];
+            size_t out = vertexBase[p] + local;
+            long long v = corner[0], vt = corner[1], vn = corner[2];
+
+            // Vertex positions
+            mesh.vertices[3 * out + 0] = scale * positions[3 * v + 0];
+            mesh.vertices[3 * out + 1] = scale * positions[3 * v + 1];
+            mesh.vertices[3 * out + 2] = scale * positions[3 * v + 2];
+
+            // Normals
+            if (vn >= 0) {
+                mesh.normals[3 * out + 0] = normals[3 * vn + 0];
+                mesh.normals[3 * out + 1] = normals[3 * vn + 1];
+                mesh.normals[3 * out + 2] = normals[3 * vn + 2];
+            }
+
+            // Texture coordinates
+            if (vt >= 0) {
+                mesh.texcoords[2 * out + 0] = texcoords[2 * vt + 0];
+                mesh.texcoords[2 * out + 1] = texcoords[2 * vt + 1];
+            }
+        }
+
+        const uint32_t base = static_cast<uint32_t>(vertexBase[p]);
+        for (size_t s = partitionStart[p]; s < partitionStart[p + 1]; ++s) {
+            mesh.indices[sorted[s]] += base;
+        }
+    }, 1);
+
+    return mesh;
+}
+
+// record counts from a quick byte scan, used to size the streaming loader's arrays
+struct ObjCounts {
+    size_t positions = 0;
+    size_t normals = 0;
+    size_t texcoords = 0;
+    size_t triangles = 0;
+};
+
+// Counts v/vn/vt records and triangles (n - 2 per face) without parsing any numbers.
+// Reads through a small buffer rather than a mapping so it doesn't add to the resident set.
+ObjCounts countRecords(const std::string& filepath) {
+    FILE* file = std::fopen(filepath.c_str(), "rb");
+    if (!file) {
+        throw std::runtime_error("Failed to load OBJ file: cannot open " + filepath);
+    }
+
+    ObjCounts counts;
+    std::vector<char> buffer(1 << 20);
+    char prefix[2] = {0, 0};    // first two non-blank characters of the line
+    int prefixLength = 0;
+    bool inFace = false, inToken = false;
+    size_t faceTokens = 0;
+
+    auto endLine = [&]() {
+        if (prefixLength >= 1 && prefix[0] == 'f' && faceTokens >= 3) counts.triangles += faceTokens - 2;
+        prefixLength = 0;
+        inFace = inToken = false;
+        faceTokens = 0;
+    };
+
+    size_t read;
+    while ((read = std::fread(buffer.data(), 1, buffer.size(), file)) > 0) {
+        for (size_t i = 0; i < read; ++i) {
+            char c = buffer[i];
+            if (c == '\n') {
+                endLine();
+                continue;
+            }
+            if (inFace) {
+                bool blank = isBlank(c) || c == '\r';
+                if (!blank && !inToken) faceTokens++;
+                inToken = !blank;
+                continue;
+            }
+            if (prefixLength < 2) {
+                if (prefixLength == 0 && isBlank(c)) continue;
+                prefix[prefixLength++] = c;
+                if (prefixLength == 2) {
+                    if (prefix[0] == 'v' && isBlank(prefix[1])) counts.positions++;
+                    else if (prefix[0] == 'v' && prefix[1] == 'n') counts.normals++;
+                    else if (prefix[0] == 'v' && prefix[1] == 't') counts.texcoords++;
+                    else if (prefix[0] == 'f' && isBlank(prefix[1])) inFace = true;
+                }
+            }
+        }
+    }
+    endLine();
+    std::fclose(file);
+    return counts;
+}
+
+// everything the streaming callbacks write into
+struct StreamState {
+    float scale = 1.0f;
+    bool hasNormals = false;
+    bool hasTexcoords = false;
+
+    // raw attributes, faces refer back to these
+    std::vector<float> positions;
+    std::vector<float> normals;
+    std::vector<float> texcoords;
+
+    Mesh mesh;
+    std::vector<int> sources;       // (v, vt, vn) of every output vertex
+    std::vector<uint32_t> table;    // open-addressing weld table into `sources`
+    std::vector<uint32_t> polygon;  // scratch for the face being read, kept across faces
+    std::string error;
+};
+
+void growWeldTable(StreamState& state) {
+    size_t capacity = std::max<size_t>(state.table.size() * 2, 1024);
+    std::vector<uint32_t>(capacity, UINT32_MAX).swap(state.table);
+    size_t vertexCount = state.sources.size() / 3;
+    for (size_t id = 0; id < vertexCount; ++id) {
+        size_t slot = hashCorner(&state.sources[3 * id]) & (capacity - 1);
+        while (state.table[slot] != UINT32_MAX) slot = (slot + 1) & (capacity - 1);
+        state.table[slot] = static_cast<uint32_t>(id);
+    }
+}
+
+// returns the output vertex for a resolved corner, creating it on first use
+uint32_t streamVertex(StreamState& state, const int* corner) {
+    if (2 * (state.sources.size() / 3 + 1) > state.table.size()) growWeldTable(state);
+
+    size_t mask = state.table.size() - 1;
+    size_t slot = hashCorner(corner) & mask;
+    for (;;) {
+        uint32_t id = state.table[slot];
+        if (id == UINT32_MAX) break;
+        if (sameCorner(corner, &state.sources[3 * id])) return id;
+        slot = (slot + 1) & mask;
+    }
+
+    uint32_t id = static_cast<uint32_t>(state.sources.size() / 3);
+    state.table[slot] = id;
+    state.sources.insert(state.sources.end(), corner, corner + 3);
+
+    Mesh& mesh = state.mesh;
+    const float* position = &state.positions[3 * corner[0]];
+    mesh.vertices.push_back(state.scale * position[0]);
+    mesh.vertices.push_back(state.scale * position[1]);
+    mesh.vertices.push_back(state.scale * position[2]);
+    if (state.hasNormals) {
+        const float zero[3] = {0.0f, 0.0f, 0.0f};
+        const float* normal = corner[2] >= 0 ? &state.normals[3 * corner[2]] : zero;
+        mesh.normals.insert(mesh.normals.end(), normal, normal + 3);
+    }
+    if (state.hasTexcoords) {
+        const float zero[2] = {0.0f, 0.0f};
+        const float* texcoord = corner[1] >= 0 ? &state.texcoords[2 * corner[1]] : zero;
+        mesh.texcoords.insert(mesh.texcoords.end(), texcoord, texcoord + 2);
+    }
+    return id;
+}
+
+void streamPosition(void* user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z, tinyobj::real_t) {
+    std::vector<float>& positions = static_cast<StreamState*>(user)->positions;
+    positions.push_back(x);
+    positions.push_back(y);
+    positions.push_back(z);
+}
+
+void streamNormal(void* user, tinyobj::real_t x, tinyobj::real_t y, tinyobj::real_t z) {
+    std::vector<float>& normals = static_cast<StreamState*>(user)->normals;
+    normals.push_back(x);
+    normals.push_back(y);
+    normals.push_back(z);
+}
+
+void streamTexcoord(void* user, tinyobj::real_t u, tinyobj::real_t v, tinyobj::real_t) {
+    std::vector<float>& texcoords = static_cast<StreamState*>(user)->texcoords;
+    texcoords.push_back(u);
+    texcoords.push_back(v);
+}
+
+void streamFace(void* user, tinyobj::index_t* indices, int count) {
+    StreamState& state = *static_cast<StreamState*>(user);
+    if (!state.error.empty() || count < 3) return;
+
+    // resolve the raw 1-based / relative indices against what has been read so far
+    const long long sizes[3] = {
+        static_cast<long long>(state.positions.size() / 3),
+        static_cast<long long>(state.texcoords.size() / 2),
+        static_cast<long long>(state.normals.size() / 3),
+    };
+    std::vector<uint32_t>& polygon = state.polygon;
+    polygon.resize(count);
+    for (int i = 0; i < count; ++i) {
+        const int raw[3] = {indices[i].vertex_index, indices[i].texcoord_index, indices[i].normal_index};
+        int corner[3];
+        for (int a = 0; a < 3; ++a) {
+            long long index = raw[a] > 0 ? raw[a] - 1 : (raw[a] < 0 ? sizes[a] + raw[a] : -1);
+            if (index >= sizes[a] || index < -1 || (a == 0 && index < 0)) {
+                state.error = "face index out of range";
+                return;
+            }
+            corner[a] = static_cast<int>(index);
+        }
+        polygon[i] = streamVertex(state, corner);
+    }
+
+    std::vector<unsigned int>& out = state.mesh.indices;
+    if (count == 4) {
+        // shorter diagonal, same choice as tinyobj and loadOBJ
+        const int* c = &state.sources[0];
+        const float* p0 = &state.positions[3 * c[3 * polygon[0]]];
+        const float* p1 = &state.positions[3 * c[3 * polygon[1]]];
+        const float* p2 = &state.positions[3 * c[3 * polygon[2]]];
+        const float* p3 = &state.positions[3 * c[3 * polygon[3]]];
+        float sqr02 = 0.0f, sqr13 = 0.0f;
+        for (int k = 0; k < 3; ++k) {
+            float e02 = p2[k] - p0[k];
+            float e13 = p3[k] - p1[k];
+            sqr02 += e02 * e02;
+            sqr13 += e13 * e13;
+        }
+        if (sqr02 < sqr13) {
+            out.insert(out.end(), {polygon[0], polygon[1], polygon[2], polygon[0], polygon[2], polygon[3]});
+        } else {
+            out.insert(out.end(), {polygon[0], polygon[1], polygon[3], polygon[1], polygon[2], polygon[3]});
+        }
+        return;
+    }
+    for (int v = 1; v + 1 < count; ++v) {
+        out.insert(out.end(), {polygon[0], polygon[v], polygon[v + 1]});
+    }
+}
+
+}
+
+Mesh loadOBJ(const std::string& filepath, float scale) {
+    auto start = std::chrono::steady_clock::now();
+
+    MappedFile file(filepath);
+    std::vector<ObjChunk> chunks = splitChunks(file.data(), file.size());
+
+    // parse every chunk on its own
+    parallelFor(0, chunks.size(), [&](size_t c) { parseChunk(chunks[c]); });
+
+    // prefix sums give each chunk its place in the merged arrays
+    size_t chunkCount = chunks.size();
+    std::vector<size_t> positionBase(chunkCount + 1, 0), normalBase(chunkCount + 1, 0);
+    std::vector<size_t> texcoordBase(chunkCount + 1, 0), cornerBase(chunkCount + 1, 0);
+    for (size_t c = 0; c < chunkCount; ++c) {
+        positionBase[c + 1] = positionBase[c] + chunks[c].positions.size() / 3;
+        normalBase[c + 1] = normalBase[c] + chunks[c].normals.size() / 3;
+        texcoordBase[c + 1] = texcoordBase[c] + chunks[c].texcoords.size() / 2;
+        cornerBase[c + 1] = cornerBase[c] + chunks[c].corners.size() / 3;
+    }
+
+    // merge attributes and corners, freeing each chunk as soon as it's copied
+    std::vector<float> positions(positionBase[chunkCount] * 3);
+    std::vector<float> normals(normalBase[chunkCount] * 3);
+    std::vector<float> texcoords(texcoordBase[chunkCount] * 2);
+    std::vector<int> corners(cornerBase[chunkCount] * 3);
+    parallelFor(0, chunkCount, [&](size_t c) {
+        ObjChunk& chunk = chunks[c];
+        std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + positionBase[c] * 3);
+        std::copy(chunk.normals.begin(), chunk.normals.end(), normals.begin() + normalBase[c] * 3);
+        std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + texcoordBase[c] * 2);
+        std::vector<float>().swap(chunk.positions);
+        std::vector<float>().swap(chunk.normals);
+        std::vector<float>().swap(chunk.texcoords);
+
+        // patch relative indices now that the chunk offsets are known
+        const size_t bases[3] = {positionBase[c], texcoordBase[c], normalBase[c]};
+        for (const Fixup& fixup : chunk.fixups) {
+            long long resolved = static_cast<long long>(bases[fixup.slot % 3]) + fixup.local;
+            chunk.corners[fixup.slot] = resolved < 0 ? INT_MAX : storeIndex(resolved);
+        }
+        std::copy(chunk.corners.begin(), chunk.corners.end(), corners.begin() + cornerBase[c] * 3);
+        std::vector<int>().swap(chunk.corners);
+        std::vector<Fixup>().swap(chunk.fixups);
+    });
+
+    // quads come out of the parser as [0, 1, 2], [0, 2, 3]. switch to [0, 1, 3], [1, 2, 3] when 1-3 is shorter
+    const long long positionCount = static_cast<long long>(positionBase[chunkCount]);
+    parallelFor(0, chunkCount, [&](size_t c) {
+        for (size_t q : chunks[c].quads) {
+            int* quad = &corners[cornerBase[c] * 3 + q];
+            long long v0 = quad[0], v1 = quad[3], v2 = quad[6], v3 = quad[15];
+            if (v0 < 0 || v1 < 0 || v2 < 0 || v3 < 0) continue;
+            if (v0 >= positionCount || v1 >= positionCount || v2 >= positionCount || v3 >= positionCount) continue;
+
+            float sqr02 = 0.0f, sqr13 = 0.0f;
+            for (int k = 0; k < 3; ++k) {
+                float e02 = positions[3 * v2 + k] - positions[3 * v0 + k];
+                float e13 = positions[3 * v3 + k] - positions[3 * v1 + k];
+                sqr02 += e02 * e02;
+                sqr13 += e13 * e13;
+            }
+            if (sqr02 < sqr13) continue;
+
+            int c0[3], c1[3], c2[3], c3[3];
+            std::copy(quad + 0, quad + 3, c0);
+            std::copy(quad + 3, quad + 6, c1);
+            std::copy(quad + 6, quad + 9, c2);
+            std::copy(quad + 15, quad + 18, c3);
+            const int* order[6] = {c0, c1, c3, c1, c2, c3};
+            for (int k = 0; k < 6; ++k) std::copy(order[k], order[k] + 3, quad + 3 * k);
+        }
+    });
+    std::vector<ObjChunk>().swap(chunks);
+
+    Mesh mesh = weldCorners(corners, positions, normals, texcoords, scale, filepath);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double megabytes = file.size() / (1024.0 * 1024.0);
+    std::cout << "Parsed " << filepath << ": " << megabytes << " MB in " << seconds * 1000.0 << " ms ("
+              << megabytes / seconds << " MB/s, " << chunkCount << " chunks on " << threadCount() << " threads)" << std::endl;
+    std::cout << "Welded " << corners.size() / 3 << " face corners into " << mesh.vertices.size() / 3 << " vertices" << std::endl;
+
+    return mesh;
+}
+
+Mesh loadOBJStreaming(const std::string& filepath, float scale) {
+    auto start = std::chrono::steady_clock::now();
+
+    // size everything once, so nothing reallocates (and briefly doubles) while streaming
+    ObjCounts counts = countRecords(filepath);
+
+    StreamState state;
+    state.scale = scale;
+    state.hasNormals = counts.normals > 0;
+    state.hasTexcoords = counts.texcoords > 0;
+    state.positions.reserve(counts.positions * 3);
+    state.normals.reserve(counts.normals * 3);
+    state.texcoords.reserve(counts.texcoords * 2);
+
+    // scans usually have one vertex per position, seams and splits get a bit of slack
+    size_t expectedVertices = counts.positions + counts.positions / 8;
+    state.mesh.vertices.reserve(expectedVertices * 3);
+    if (state.hasNormals) state.mesh.normals.reserve(expectedVertices * 3);
+    if (state.hasTexcoords) state.mesh.texcoords.reserve(expectedVertices * 2);
+    state.mesh.indices.reserve(counts.triangles * 3);
+    state.sources.reserve(expectedVertices * 3);
+    size_t capacity = 1024;
+    while (capacity < 2 * expectedVertices) capacity <<= 1;
+    state.table.assign(capacity, UINT32_MAX);
+
+    tinyobj::callback_t callback;
+    callback.vertex_cb = streamPosition;
+    callback.normal_cb = streamNormal;
+    callback.texcoord_cb = streamTexcoord;
+    callback.index_cb = streamFace;
+
+    std::ifstream stream(filepath);
+    if (!stream) {
+        throw std::runtime_error("Failed to load OBJ file: cannot open " + filepath);
+    }
+    std::string warn, err;
+    bool success = tinyobj::LoadObjWithCallback(stream, callback, &state, nullptr, &warn, &err);
+
+    if (!warn.empty()) {
+        std::cerr << "Warning: " << warn << std::endl;
+    }
+    if (!success) {
+        throw std::runtime_error("Failed to load OBJ file: " + err);
+    }
+    if (!state.error.empty()) {
+        throw std::runtime_error("Failed to load OBJ file: " + state.error + " in " + filepath);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Streamed " << filepath << ": " << state.mesh.indices.size() / 3 << " triangles, "
+              << state.mesh.vertices.size() / 3 << " vertices in " << seconds * 1000.0 << " ms" << std::endl;
+
+    return std::move(state.mesh);
+}
+
+Mesh loadMesh(const std::string& filepath, float scale) {
+    std::string extension;
+    size_t dot = filepath.find_last_of('.');
+    if (dot != std::string::npos) extension = filepath.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (extension == "ply") return loadPLY(filepath, scale);
+    if (extension == "glb") return loadGLB(filepath, scale);
+    return loadOBJ(filepath, scale);
+}
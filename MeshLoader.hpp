@@ -0,0 +1,28 @@
+#pragma once
+
+#include "Mesh.hpp"
+
+#include <string>
+
+// Loads a Wavefront OBJ into a Mesh. The file is memory-mapped, split into
+// newline-aligned chunks and parsed on all cores; throughput is printed once done.
+// Face corners are welded into unique vertices, so `indices` is a real index buffer.
+Mesh loadOBJ(const std::string& filepath, float scale = 1.0);
+
+// Same result as loadOBJ (up to vertex order), streamed through tinyobj::LoadObjWithCallback.
+// Welded vertices are written straight into arrays sized by a quick pre-scan, so peak memory
+// stays close to the final mesh. Use it when memory, not load time, is the limit.
+Mesh loadOBJStreaming(const std::string& filepath, float scale = 1.0);
+
+// Loads a PLY (ascii, binary little or big endian) into a Mesh. Binary bodies are read in place
+// from the memory map; polygons are fan-triangulated on all cores. PLY vertices are already
+// shared, so no welding happens. Keeps x/y/z, nx/ny/nz and u/v (or s/t) vertex properties.
+Mesh loadPLY(const std::string& filepath, float scale = 1.0);
+
+// Loads the default scene of a binary glTF 2.0 (.glb) file, flattened into one world-space Mesh:
+// every mesh instance is transformed by its node's world matrix, which copies every array. See
+// GltfLoader.hpp for the per-mesh views that point straight into the mapped file.
+Mesh loadGLB(const std::string& filepath, float scale = 1.0);
+
+// Picks the loader by file extension: .ply goes to loadPLY, .glb to loadGLB, everything else to loadOBJ.
+Mesh loadMesh(const std::string& filepath, float scale = 1.0);
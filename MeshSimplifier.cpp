@@ -0,0 +1,526 @@
+#include "MeshSimplifier.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <queue>
+
+namespace {
+
+// symmetric 4x4 plane quadric, upper triangle
+struct Quadric {
+    double a2 = 0, ab = 0, ac = 0, ad = 0, b2 = 0, bc = 0, bd = 0, c2 = 0, cd = 0, d2 = 0;
+
+    static Quadric plane(double a, double b, double c, double d, double weight) {
+        Quadric q;
+        q.a2 = weight * a * a; q.ab = weight * a * b; q.ac = weight * a * c; q.ad = weight * a * d;
+        q.b2 = weight * b * b; q.bc = weight * b * c; q.bd = weight * b * d;
+        q.c2 = weight * c * c; q.cd = weight * c * d;
+        q.d2 = weight * d * d;
+        return q;
+    }
+
+    void add(const Quadric& o) {
+        a2 += o.a2; ab += o.ab; ac += o.ac; ad += o.ad;
+        b2 += o.b2; bc += o.bc; bd += o.bd;
+        c2 += o.c2; cd += o.cd;
+        d2 += o.d2;
+    }
+
+    double error(const double p[3]) const {
+        double x = p[0], y = p[1], z = p[2];
+        return a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x +
+               b2 * y * y + 2 * bc * y * z + 2 * bd * y +
+               c2 * z * z + 2 * cd * z + d2;
+    }
+
+    // point of least error, false when the system is (nearly) singular
+    bool optimum(double p[3]) const {
+        double det = a2 * (b2 * c2 - bc * bc) - ab * (ab * c2 - bc * ac) + ac * (ab * bc - b2 * ac);
+        double scale = std::fabs(a2) + std::fabs(b2) + std::fabs(c2);
+        if (std::fabs(det) <= 1e-12 * scale * scale * scale) return false;
+        double inv = 1.0 / det;
+        p[0] = -inv * (ad * (b2 * c2 - bc * bc) - bd * (ab * c2 - ac * bc) + cd * (ab * bc - ac * b2));
+        p[1] = -inv * (a2 * (bd * c2 - cd * bc) - ab * (ad * c2 - cd * ac) + ac * (ad * bc - bd * ac));
+        p[2] = -inv * (a2 * (b2 * cd - bc * bd) - ab * (ab * cd - bc * ad) + ac * (ab * bd - b2 * ad));
+        return true;
+    }
+};
+
+inline void sub(const double a[3], const double b[3], double out[3]) {
+    out[0] = a[0] - b[0];
+    out[1] = a[1] - b[1];
+    out[2] = a[2] - b[2];
+}
+
+inline void cross(const double a[3], const double b[3], double out[3]) {
+    out[0] = a[1] * b[2] - a[2] * b[1];
+    out[1] = a[2] * b[0] - a[0] * b[2];
+    out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+inline double dot(const double a[3], const double b[3]) { return a[0] * b[0] + a[1] * b[1] + a[2] * b[2]; }
+
+const uint32_t locked = UINT32_MAX;
+const uint32_t unset = UINT32_MAX;
+const size_t maxValence = 64;
+
+// an evaluated edge collapse
+struct Candidate {
+    double cost;
+    uint32_t a, b;
+    double position[3];
+};
+
+// queue entry for a collapse, kept small since clusters queue millions of them. it's stale once
+// either vertex changed, which the sum of their (only ever growing) versions tells. stale entries
+// are re-evaluated when they come up rather than re-queued on every change: collapse costs only
+// grow as quadrics accumulate, so the queue order stays right
+struct QueuedEdge {
+    float cost;
+    uint32_t a, b;
+    uint32_t versions;
+
+    bool operator>(const QueuedEdge& o) const { return cost > o.cost; }
+};
+
+class Simplifier {
+public:
+
+    // position-welded copy of the input, so attribute seams don't stop collapses
+    explicit Simplifier(const Mesh& mesh) {
+        size_t vertexCount = mesh.vertices.size() / 3;
+        std::vector<uint32_t> order(vertexCount), remap(vertexCount);
+        for (size_t v = 0; v < vertexCount; ++v) order[v] = static_cast<uint32_t>(v);
+        const float* p = mesh.vertices.data();
+        auto less = [p](uint32_t a, uint32_t b) {
+            return std::lexicographical_compare(p + 3 * a, p + 3 * a + 3, p + 3 * b, p + 3 * b + 3);
+        };
+        std::sort(order.begin(), order.end(), less);
+        for (size_t i = 0; i < vertexCount; ++i) {
+            uint32_t v = order[i];
+            if (i == 0 || less(order[i - 1], v)) {
+                positions.insert(positions.end(), {p[3 * v], p[3 * v + 1], p[3 * v + 2]});
+            }
+            remap[v] = static_cast<uint32_t>(positions.size() / 3 - 1);
+        }
+
+        triangles.reserve(mesh.indices.size());
+        for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3) {
+            uint32_t a = remap[mesh.indices[i]], b = remap[mesh.indices[i + 1]], c = remap[mesh.indices[i + 2]];
+            if (a == b || b == c || a == c) continue;
+            triangles.insert(triangles.end(), {a, b, c});
+        }
+        computeQuadrics();
+    }
+
+    // collapses until about targetTriangles are left. can be called again with a lower target,
+    // the quadrics keep measuring against the original surface
+    void reduce(size_t targetTriangles) {
+        // enough clusters for every thread, and small enough that their queues stay cache friendly
+        const size_t cellsWanted = std::max<size_t>(threadCount() * 8, triangles.size() / 3 / 16384);
+        int resolution = std::max(1, static_cast<int>(std::lround(std::cbrt(static_cast<double>(cellsWanted)))));
+        // within half a percent is close enough, another round over the whole mesh costs more than it's worth
+        const size_t closeEnough = targetTriangles + targetTriangles / 200;
+        for (int round = 0; round < 12 && triangles.size() / 3 > closeEnough; ++round) {
+            // two rounds per grid, the second one shifted by half a cell, then a coarser grid
+            bool shifted = round % 2 == 1;
+            int res = std::max(1, resolution >> (round / 2));
+            size_t before = triangles.size();
+            collapseRound(targetTriangles, res, shifted && res > 1);
+            // a single cluster that got less than a hundredth of the way has run out of legal collapses
+            if (res == 1 && (before - triangles.size()) * 100 < before - 3 * targetTriangles) break;
+        }
+    }
+
+    // the current triangles as a compact Mesh, with smooth vertex normals if asked for
+    Mesh extract(bool normals) const {
+        Mesh out;
+        std::vector<uint32_t> index(positions.size() / 3, unset);
+        out.indices.reserve(triangles.size());
+        for (uint32_t v : triangles) {
+            if (index[v] == unset) {
+                index[v] = static_cast<uint32_t>(out.vertices.size() / 3);
+                for (int k = 0; k < 3; ++k) out.vertices.push_back(static_cast<float>(positions[3 * v + k]));
+            }
+            out.indices.push_back(index[v]);
+        }
+        if (!normals) return out;
+
+        out.normals.assign(out.vertices.size(), 0.0f);
+        for (size_t t = 0; t < out.indices.size(); t += 3) {
+            const float* a = &out.vertices[3 * out.indices[t]];
+            const float* b = &out.vertices[3 * out.indices[t + 1]];
+            const float* c = &out.vertices[3 * out.indices[t + 2]];
+            float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+            float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+            float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+            for (int k = 0; k < 3; ++k) {
+                for (int j = 0; j < 3; ++j) out.normals[3 * out.indices[t + k] + j] += n[j];
+            }
+        }
+        parallelFor(0, out.normals.size() / 3, [&](size_t v) {
+            float* n = &out.normals[3 * v];
+            float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (length > 0.0f) {
+                n[0] /= length;
+                n[1] /= length;
+                n[2] /= length;
+            }
+        }, 4096);
+        return out;
+    }
+
+private:
+    std::vector<double> positions;   // x, y, z per position-welded vertex
+    std::vector<Quadric> quadrics;
+    std::vector<uint32_t> triangles; // three per live triangle
+
+    std::vector<uint32_t> adjacencyStart, adjacency;  // triangles around each vertex
+    std::vector<uint32_t> owner;                       // cluster that may move the vertex, or locked
+    std::vector<uint32_t> version;
+    std::vector<uint8_t> dead, removed;
+    std::vector<uint32_t> mergedInto;                  // where a dead vertex went
+    std::vector<uint32_t> refStart, refCount;          // triangles around a vertex in its cluster's refs
+
+    const double* position(uint32_t v) const { return &positions[3 * v]; }
+
+    void buildAdjacency() {
+        size_t vertexCount = positions.size() / 3;
+        adjacencyStart.assign(vertexCount + 1, 0);
+        for (uint32_t v : triangles) adjacencyStart[v + 1]++;
+        for (size_t v = 0; v < vertexCount; ++v) adjacencyStart[v + 1] += adjacencyStart[v];
+        adjacency.resize(triangles.size());
+        std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+        for (size_t i = 0; i < triangles.size(); ++i) adjacency[fill[triangles[i]]++] = static_cast<uint32_t>(i / 3);
+    }
+
+    // area-weighted face planes, plus heavy planes standing on every open border edge
+    void computeQuadrics() {
+        buildAdjacency();
+        size_t vertexCount = positions.size() / 3;
+        quadrics.assign(vertexCount, Quadric());
+
+        parallelFor(0, vertexCount, [&](size_t v) {
+            Quadric q;
+            for (uint32_t i = adjacencyStart[v]; i < adjacencyStart[v + 1]; ++i) {
+                const uint32_t* tri = &triangles[3 * adjacency[i]];
+                double e1[3], e2[3], n[3];
+                sub(position(tri[1]), position(tri[0]), e1);
+                sub(position(tri[2]), position(tri[0]), e2);
+                cross(e1, e2, n);
+                double length = std::sqrt(dot(n, n));
+                if (length == 0.0) continue;
+                for (double& c : n) c /= length;
+                q.add(Quadric::plane(n[0], n[1], n[2], -dot(n, position(tri[0])), 0.5 * length));
+
+                // an edge from v is a border if no other triangle around v has it
+                for (int k = 0; k < 3; ++k) {
+                    uint32_t from = tri[k], to = tri[(k + 1) % 3];
+                    if (from != v && to != v) continue;
+                    uint32_t other = from == v ? to : from;
+                    bool shared = false;
+                    for (uint32_t j = adjacencyStart[v]; j < adjacencyStart[v + 1] && !shared; ++j) {
+                        if (j == i) continue;
+                        const uint32_t* t = &triangles[3 * adjacency[j]];
+                        shared = t[0] == other || t[1] == other || t[2] == other;
+                    }
+                    if (shared) continue;
+
+                    double edge[3], side[3];
+                    sub(position(to), position(from), edge);
+                    cross(edge, n, side);
+                    double sideLength = std::sqrt(dot(side, side));
+                    if (sideLength == 0.0) continue;
+                    for (double& c : side) c /= sideLength;
+                    q.add(Quadric::plane(side[0], side[1], side[2], -dot(side, position(from)), 10.0 * dot(edge, edge)));
+                }
+            }
+            quadrics[v] = q;
+        }, 1024);
+    }
+
+    // best place for the merged vertex: the quadric optimum if it's sane, else an endpoint or the midpoint
+    Candidate evaluate(uint32_t a, uint32_t b) const {
+        Quadric q = quadrics[a];
+        q.add(quadrics[b]);
+
+        Candidate c;
+        c.a = a;
+        c.b = b;
+
+        const double* pa = position(a);
+        const double* pb = position(b);
+        double mid[3] = {(pa[0] + pb[0]) * 0.5, (pa[1] + pb[1]) * 0.5, (pa[2] + pb[2]) * 0.5};
+        double edge[3];
+        sub(pb, pa, edge);
+        double edgeSquared = dot(edge, edge);
+
+        double p[3];
+        if (q.optimum(p)) {
+            double offset[3];
+            sub(p, mid, offset);
+            if (dot(offset, offset) <= 4.0 * edgeSquared) {
+                std::copy(p, p + 3, c.position);
+                c.cost = q.error(p);
+                return c;
+            }
+        }
+        const double* options[3] = {pa, pb, mid};
+        c.cost = 1e300;
+        for (const double* option : options) {
+            double cost = q.error(option);
+            if (cost < c.cost) {
+                c.cost = cost;
+                std::copy(option, option + 3, c.position);
+            }
+        }
+        return c;
+    }
+
+    struct Cluster {
+        std::vector<uint32_t> triangles;  // indices of its triangles
+        std::vector<uint32_t> refs;
+        size_t live = 0;
+        size_t target = 0;
+    };
+
+    // live triangles around an owned vertex
+    template<typename F>
+    void forEachTriangle(const Cluster& cluster, uint32_t v, F&& fn) const {
+        for (uint32_t i = refStart[v], end = refStart[v] + refCount[v]; i < end; ++i) {
+            uint32_t t = cluster.refs[i];
+            if (!removed[t]) fn(t);
+        }
+    }
+
+    void neighbours(const Cluster& cluster, uint32_t v, std::vector<uint32_t>& out) const {
+        out.clear();
+        forEachTriangle(cluster, v, [&](uint32_t t) {
+            for (int k = 0; k < 3; ++k) {
+                if (triangles[3 * t + k] != v) out.push_back(triangles[3 * t + k]);
+            }
+        });
+        std::sort(out.begin(), out.end());
+        out.erase(std::unique(out.begin(), out.end()), out.end());
+    }
+
+    // rejects collapses that fold a triangle over or pinch the surface into a non-manifold
+    bool allowed(const Cluster& cluster, const Candidate& c, std::vector<uint32_t>& ringA, std::vector<uint32_t>& ringB) const {
+        neighbours(cluster, c.a, ringA);
+        neighbours(cluster, c.b, ringB);
+        // triangle soups would otherwise grow fans of thousands of triangles that make every
+        // later check crawl, and nothing of a surface is left to preserve there anyway
+        if (ringA.size() + ringB.size() > maxValence) return false;
+        size_t common = 0, shared = 0;
+        for (size_t i = 0, j = 0; i < ringA.size() && j < ringB.size();) {
+            if (ringA[i] < ringB[j]) ++i;
+            else if (ringB[j] < ringA[i]) ++j;
+            else { ++common; ++i; ++j; }
+        }
+        forEachTriangle(cluster, c.a, [&](uint32_t t) {
+            const uint32_t* tri = &triangles[3 * t];
+            if (tri[0] == c.b || tri[1] == c.b || tri[2] == c.b) ++shared;
+        });
+        if (shared == 0 || common != shared) return false;
+
+        bool ok = true;
+        for (uint32_t v : {c.a, c.b}) {
+            uint32_t other = v == c.a ? c.b : c.a;
+            forEachTriangle(cluster, v, [&](uint32_t t) {
+                if (!ok) return;
+                const uint32_t* tri = &triangles[3 * t];
+                if (tri[0] == other || tri[1] == other || tri[2] == other) return;
+                const double* p[3];
+                const double* q[3];
+                for (int k = 0; k < 3; ++k) {
+                    p[k] = position(tri[k]);
+                    q[k] = tri[k] == v ? c.position : p[k];
+                }
+                double e1[3], e2[3], before[3], after[3];
+                sub(p[1], p[0], e1);
+                sub(p[2], p[0], e2);
+                cross(e1, e2, before);
+                sub(q[1], q[0], e1);
+                sub(q[2], q[0], e2);
+                cross(e1, e2, after);
+                double d = dot(before, after);
+                if (d <= 0.2 * std::sqrt(dot(before, before) * dot(after, after))) ok = false;
+            });
+        }
+        return ok;
+    }
+
+    void collapseCluster(Cluster& cluster, uint32_t id) {
+        // per-cluster triangle lists for the vertices this cluster owns
+        for (uint32_t t : cluster.triangles) {
+            for (int k = 0; k < 3; ++k) {
+                uint32_t v = triangles[3 * t + k];
+                if (owner[v] != id || refStart[v] != unset) continue;
+                refStart[v] = static_cast<uint32_t>(cluster.refs.size());
+                refCount[v] = adjacencyStart[v + 1] - adjacencyStart[v];
+                cluster.refs.insert(cluster.refs.end(), adjacency.begin() + adjacencyStart[v], adjacency.begin() + adjacencyStart[v + 1]);
+            }
+        }
+
+        auto queued = [&](uint32_t a, uint32_t b) {
+            return QueuedEdge{static_cast<float>(evaluate(a, b).cost), a, b, version[a] + version[b]};
+        };
+        std::vector<QueuedEdge> initial;
+        initial.reserve(cluster.triangles.size() * 3 / 2);
+        for (uint32_t t : cluster.triangles) {
+            for (int k = 0; k < 3; ++k) {
+                uint32_t a = triangles[3 * t + k], b = triangles[3 * t + (k + 1) % 3];
+                if (a < b && owner[a] == id && owner[b] == id) initial.push_back(queued(a, b));
+            }
+        }
+        std::priority_queue<QueuedEdge, std::vector<QueuedEdge>, std::greater<QueuedEdge>> queue(std::greater<QueuedEdge>(), std::move(initial));
+
+        auto alive = [&](uint32_t v) {
+            while (dead[v]) v = mergedInto[v];
+            return v;
+        };
+
+        std::vector<uint32_t> ringA, ringB;
+        while (cluster.live > cluster.target && !queue.empty()) {
+            QueuedEdge edge = queue.top();
+            queue.pop();
+            uint32_t a = alive(edge.a), b = alive(edge.b);
+            if (a == b) continue;
+            if (a != edge.a || b != edge.b || version[a] + version[b] != edge.versions) {
+                queue.push(queued(std::min(a, b), std::max(a, b)));
+                continue;
+            }
+            Candidate c = evaluate(a, b);
+            if (!allowed(cluster, c, ringA, ringB)) continue;
+
+            // b merges into a
+            std::copy(c.position, c.position + 3, &positions[3 * c.a]);
+            quadrics[c.a].add(quadrics[c.b]);
+            dead[c.b] = 1;
+            mergedInto[c.b] = c.a;
+            version[c.a]++;
+            version[c.b]++;
+
+            uint32_t start = static_cast<uint32_t>(cluster.refs.size());
+            forEachTriangle(cluster, c.a, [&](uint32_t t) {
+                const uint32_t* tri = &triangles[3 * t];
+                if (tri[0] == c.b || tri[1] == c.b || tri[2] == c.b) {
+                    removed[t] = 1;
+                    cluster.live--;
+                } else {
+                    cluster.refs.push_back(t);
+                }
+            });
+            forEachTriangle(cluster, c.b, [&](uint32_t t) {
+                uint32_t* tri = &triangles[3 * t];
+                for (int k = 0; k < 3; ++k) {
+                    if (tri[k] == c.b) tri[k] = c.a;
+                }
+                cluster.refs.push_back(t);
+            });
+            refStart[c.a] = start;
+            refCount[c.a] = static_cast<uint32_t>(cluster.refs.size()) - start;
+        }
+    }
+
+    void collapseRound(size_t targetTriangles, int res, bool shifted) {
+        size_t vertexCount = positions.size() / 3;
+        size_t triangleCount = triangles.size() / 3;
+        buildAdjacency();
+
+        // grid over the bounds, cluster of a triangle is the cell of its centroid
+        double lo[3] = {1e300, 1e300, 1e300}, hi[3] = {-1e300, -1e300, -1e300};
+        for (uint32_t v : triangles) {
+            for (int k = 0; k < 3; ++k) {
+                lo[k] = std::min(lo[k], positions[3 * v + k]);
+                hi[k] = std::max(hi[k], positions[3 * v + k]);
+            }
+        }
+        double cell[3];
+        for (int k = 0; k < 3; ++k) cell[k] = std::max((hi[k] - lo[k]) / res, 1e-30);
+        const int cellsPerAxis = res + (shifted ? 1 : 0);
+
+        std::vector<uint32_t> triangleCell(triangleCount);
+        parallelFor(0, triangleCount, [&](size_t t) {
+            int index[3];
+            for (int k = 0; k < 3; ++k) {
+                double centroid = (positions[3 * triangles[3 * t] + k] + positions[3 * triangles[3 * t + 1] + k] +
+                                   positions[3 * triangles[3 * t + 2] + k]) / 3.0;
+                double x = (centroid - lo[k]) / cell[k] + (shifted ? 0.5 : 0.0);
+                index[k] = std::min(cellsPerAxis - 1, std::max(0, static_cast<int>(x)));
+            }
+            triangleCell[t] = static_cast<uint32_t>((index[2] * cellsPerAxis + index[1]) * cellsPerAxis + index[0]);
+        }, 4096);
+
+        // non-empty cells become clusters
+        std::vector<uint32_t> cellCluster(static_cast<size_t>(cellsPerAxis) * cellsPerAxis * cellsPerAxis, unset);
+        std::vector<Cluster> clusters;
+        for (size_t t = 0; t < triangleCount; ++t) {
+            uint32_t& id = cellCluster[triangleCell[t]];
+            if (id == unset) {
+                id = static_cast<uint32_t>(clusters.size());
+                clusters.emplace_back();
+            }
+            triangleCell[t] = id;
+            clusters[id].triangles.push_back(static_cast<uint32_t>(t));
+        }
+
+        // a vertex is free to move only if all its triangles are in one cluster
+        owner.assign(vertexCount, locked);
+        parallelFor(0, vertexCount, [&](size_t v) {
+            uint32_t first = adjacencyStart[v], last = adjacencyStart[v + 1];
+            if (first == last) return;
+            uint32_t id = triangleCell[adjacency[first]];
+            for (uint32_t i = first + 1; i < last; ++i) {
+                if (triangleCell[adjacency[i]] != id) return;
+            }
+            owner[v] = id;
+        }, 4096);
+
+        version.resize(vertexCount, 0);
+        dead.resize(vertexCount, 0);
+        mergedInto.resize(vertexCount, 0);
+        removed.assign(triangleCount, 0);
+        refStart.assign(vertexCount, unset);
+        refCount.assign(vertexCount, 0);
+
+        double keep = static_cast<double>(targetTriangles) / triangleCount;
+        for (Cluster& cluster : clusters) {
+            cluster.live = cluster.triangles.size();
+            cluster.target = static_cast<size_t>(std::ceil(cluster.live * keep));
+        }
+        parallelFor(0, clusters.size(), [&](size_t c) {
+            collapseCluster(clusters[c], static_cast<uint32_t>(c));
+            std::vector<uint32_t>().swap(clusters[c].refs);
+        });
+
+        size_t out = 0;
+        for (size_t t = 0; t < triangleCount; ++t) {
+            if (removed[t]) continue;
+            std::copy(&triangles[3 * t], &triangles[3 * t] + 3, &triangles[3 * out]);
+            out++;
+        }
+        triangles.resize(out * 3);
+    }
+};
+
+}
+
+Mesh simplifyMesh(const Mesh& mesh, size_t targetTriangles) {
+    Simplifier simplifier(mesh);
+    simplifier.reduce(targetTriangles);
+    return simplifier.extract(!mesh.normals.empty());
+}
+
+std::vector<Mesh> buildLODChain(const Mesh& mesh, const std::vector<float>& fractions) {
+    Simplifier simplifier(mesh);
+    std::vector<Mesh> levels;
+    size_t triangles = mesh.indices.size() / 3;
+    for (float fraction : fractions) {
+        simplifier.reduce(std::max<size_t>(1, static_cast<size_t>(triangles * fraction)));
+        levels.push_back(simplifier.extract(!mesh.normals.empty()));
+    }
+    return levels;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "Mesh.hpp"
+
+#include <cstddef>
+#include <vector>
+
+// Quadric error metric simplification (Garland-Heckbert edge collapses) down to about
+// `targetTriangles`. The mesh is cut into spatial clusters that are collapsed in parallel with
+// the vertices they share pinned; later rounds shift and coarsen the clusters so the seams get
+// simplified too. Open borders are held in place by extra boundary quadrics.
+// The result keeps positions and, when the input has normals, smooth area-weighted vertex
+// normals. Texture coordinates are dropped, LODs are for preview tracing.
+Mesh simplifyMesh(const Mesh& mesh, size_t targetTriangles);
+
+// One LOD per fraction of the input triangle count, finest first. Collapsing simply carries on
+// from one level to the next, so the chain costs about as much as its coarsest level alone
+// and every level is measured against the original surface.
+std::vector<Mesh> buildLODChain(const Mesh& mesh, const std::vector<float>& fractions = {0.5f, 0.1f, 0.01f});
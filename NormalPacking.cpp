@@ -0,0 +1,42 @@
+#include "NormalPacking.hpp"
+#include "Parallel.hpp"
+
+std::vector<uint32_t> packPrimitiveNormals(const float* normals, size_t triangleCount) {
+    std::vector<uint32_t> packed(triangleCount * 3);
+    parallelFor(0, packed.size(), [&](size_t i) {
+        packed[i] = encodeOctahedral(&normals[3 * i]);
+    }, 4096);
+    return packed;
+}
+
+NormalPackingError measurePackingError(const float* normals, const uint32_t* packed, size_t normalCount) {
+    const double toDegrees = 180.0 / 3.14159265358979323846;
+    NormalPackingError error;
+    double sum = 0.0, sumSquares = 0.0;
+    size_t measured = 0;
+
+    for (size_t i = 0; i < normalCount; ++i) {
+        const float* n = &normals[3 * i];
+        if (n[0] == 0.0f && n[1] == 0.0f && n[2] == 0.0f) continue;
+
+        // atan2 of |cross| and dot stays accurate for the tiny angles acos loses near 1
+        float d[3];
+        decodeOctahedral(packed[i], d);
+        double cx = double(n[1]) * d[2] - double(n[2]) * d[1];
+        double cy = double(n[2]) * d[0] - double(n[0]) * d[2];
+        double cz = double(n[0]) * d[1] - double(n[1]) * d[0];
+        double dot = double(n[0]) * d[0] + double(n[1]) * d[1] + double(n[2]) * d[2];
+        double degrees = std::atan2(std::sqrt(cx * cx + cy * cy + cz * cz), dot) * toDegrees;
+
+        sum += degrees;
+        sumSquares += degrees * degrees;
+        error.maxDegrees = std::max(error.maxDegrees, degrees);
+        measured++;
+    }
+
+    if (measured) {
+        error.meanDegrees = sum / measured;
+        error.rmsDegrees = std::sqrt(sumSquares / measured);
+    }
+    return error;
+}
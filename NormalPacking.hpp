@@ -0,0 +1,74 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Octahedral unit-vector encoding, two snorm16 components in one uint32 (x in the low half).
+// compute_kernel decodes the same layout with unpack_snorm2x16_to_float, so decodeOctahedral
+// is the CPU reference for what the GPU sees.
+
+inline float octSign(float v) { return v >= 0.0f ? 1.0f : -1.0f; }
+
+inline float fromSnorm16(int16_t v) {
+    return std::max(v / 32767.0f, -1.0f);
+}
+
+inline void decodeOctahedral(uint32_t packed, float n[3]) {
+    float x = fromSnorm16(static_cast<int16_t>(packed & 0xFFFF));
+    float y = fromSnorm16(static_cast<int16_t>(packed >> 16));
+    float z = 1.0f - std::fabs(x) - std::fabs(y);
+    float t = std::max(-z, 0.0f);
+    x += x >= 0.0f ? -t : t;
+    y += y >= 0.0f ? -t : t;
+    float length = std::sqrt(x * x + y * y + z * z);
+    n[0] = x / length;
+    n[1] = y / length;
+    n[2] = z / length;
+}
+
+// Projects onto the octahedron, then tries the four floor/ceil roundings of the two
+// components and keeps whichever decodes closest to the input.
+inline uint32_t encodeOctahedral(const float n[3]) {
+    float sum = std::fabs(n[0]) + std::fabs(n[1]) + std::fabs(n[2]);
+    if (sum == 0.0f) return 0; // degenerate normal, decodes to +z
+    float x = n[0] / sum, y = n[1] / sum;
+    if (n[2] < 0.0f) {
+        float ox = x;
+        x = (1.0f - std::fabs(y)) * octSign(ox);
+        y = (1.0f - std::fabs(ox)) * octSign(y);
+    }
+
+    float sx = std::clamp(x, -1.0f, 1.0f) * 32767.0f;
+    float sy = std::clamp(y, -1.0f, 1.0f) * 32767.0f;
+    uint32_t best = 0;
+    float bestDot = -2.0f;
+    for (int i = 0; i < 4; ++i) {
+        int16_t qx = static_cast<int16_t>((i & 1) ? std::ceil(sx) : std::floor(sx));
+        int16_t qy = static_cast<int16_t>((i & 2) ? std::ceil(sy) : std::floor(sy));
+        uint32_t packed = static_cast<uint16_t>(qx) | (static_cast<uint32_t>(static_cast<uint16_t>(qy)) << 16);
+        float d[3];
+        decodeOctahedral(packed, d);
+        float dot = d[0] * n[0] + d[1] * n[1] + d[2] * n[2];
+        if (dot > bestDot) {
+            bestDot = dot;
+            best = packed;
+        }
+    }
+    return best;
+}
+
+// Packs per-primitive float normals (nine floats per triangle, see primitiveNormals)
+// into three uint32 per triangle: 12 bytes instead of 36.
+std::vector<uint32_t> packPrimitiveNormals(const float* normals, size_t triangleCount);
+
+// angular error of the packed normals against the float ones they were made from
+struct NormalPackingError {
+    double meanDegrees = 0.0;
+    double rmsDegrees = 0.0;
+    double maxDegrees = 0.0;
+};
+
+NormalPackingError measurePackingError(const float* normals, const uint32_t* packed, size_t normalCount);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// number of worker threads to use for parallel work
+inline unsigned threadCount() {
+    unsigned n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+}
+
+// runs fn(i) for every i in [begin, end) on all cores.
+// indices are handed out in blocks of `grain` so cheap bodies don't fight over the counter.
+// the calling thread takes part, and the first exception thrown by any worker is rethrown here.
+template<typename F>
+void parallelFor(size_t begin, size_t end, F&& fn, size_t grain = 1) {
+    if (begin >= end) return;
+    grain = std::max<size_t>(grain, 1);
+
+    size_t blocks = (end - begin + grain - 1) / grain;
+    unsigned workers = static_cast<unsigned>(std::min<size_t>(threadCount(), blocks));
+
+    std::atomic<size_t> next{begin};
+    std::exception_ptr failure;
+    std::mutex failureLock;
+
+    auto work = [&]() {
+        try {
+            for (;;) {
+                size_t first = next.fetch_add(grain);
+                if (first >= end) break;
+                size_t last = std::min(first + grain, end);
+                for (size_t i = first; i < last; ++i) fn(i);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(failureLock);
+            if (!failure) failure = std::current_exception();
+            next = end; // stop handing out work
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (unsigned t = 1; t < workers; ++t) threads.emplace_back(work);
+    work();
+    for (auto& thread : threads) thread.join();
+
+    if (failure) std::rethrow_exception(failure);
+}
@@ -0,0 +1,620 @@
+#include "tiny_obj_loader.h"
+
+#include "MeshLoader.hpp"
+#include "MappedFile.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+enum class PlyFormat { Ascii, BinaryLittleEndian, BinaryBigEndian };
+
+enum class PlyType { Int8, UInt8, Int16, UInt16, Int32, UInt32, Float32, Float64 };
+
+struct PlyProperty {
+    std::string name;
+    PlyType type = PlyType::Float32;      // value type, item type for lists
+    bool isList = false;
+    PlyType countType = PlyType::UInt8;   // type of the list length
+};
+
+struct PlyElement {
+    std::string name;
+    size_t count = 0;
+    std::vector<PlyProperty> properties;
+    size_t recordSize = 0;   // bytes per binary record, 0 if the record holds a list
+};
+
+struct PlyHeader {
+    PlyFormat format = PlyFormat::Ascii;
+    std::vector<PlyElement> elements;
+    size_t bodyOffset = 0;
+};
+
+[[noreturn]] void plyError(const std::string& what, const std::string& filepath) {
+    throw std::runtime_error("Failed to load PLY file: " + what + " in " + filepath);
+}
+
+size_t typeSize(PlyType type) {
+    switch (type) {
+        case PlyType::Int8: case PlyType::UInt8: return 1;
+        case PlyType::Int16: case PlyType::UInt16: return 2;
+        case PlyType::Int32: case PlyType::UInt32: case PlyType::Float32: return 4;
+        case PlyType::Float64: return 8;
+    }
+    return 0;
+}
+
+// both the original names and the sized ones newer exporters write
+bool parseType(const std::string& name, PlyType& type) {
+    static const std::pair<const char*, PlyType> names[] = {
+        {"char", PlyType::Int8}, {"int8", PlyType::Int8},
+        {"uchar", PlyType::UInt8}, {"uint8", PlyType::UInt8},
+        {"short", PlyType::Int16}, {"int16", PlyType::Int16},
+        {"ushort", PlyType::UInt16}, {"uint16", PlyType::UInt16},
+        {"int", PlyType::Int32}, {"int32", PlyType::Int32},
+        {"uint", PlyType::UInt32}, {"uint32", PlyType::UInt32},
+        {"float", PlyType::Float32}, {"float32", PlyType::Float32},
+        {"double", PlyType::Float64}, {"float64", PlyType::Float64},
+    };
+    for (const auto& entry : names) {
+        if (name == entry.first) {
+            type = entry.second;
+            return true;
+        }
+    }
+    return false;
+}
+
+PlyHeader parseHeader(const char* data, size_t size, const std::string& filepath) {
+    if (size < 4 || std::memcmp(data, "ply", 3) != 0 || (data[3] != '\n' && data[3] != '\r')) {
+        plyError("missing 'ply' magic", filepath);
+    }
+
+    PlyHeader header;
+    bool haveFormat = false, haveEnd = false;
+    size_t offset = 0;
+    while (offset < size && !haveEnd) {
+        const char* line = data + offset;
+        const char* newline = static_cast<const char*>(std::memchr(line, '\n', size - offset));
+        if (!newline) break;
+        offset = newline + 1 - data;
+
+        std::istringstream words(std::string(line, newline));
+        std::string keyword;
+        words >> keyword;
+        if (keyword == "format") {
+            std::string format;
+            words >> format;
+            if (format == "ascii") header.format = PlyFormat::Ascii;
+            else if (format == "binary_little_endian") header.format = PlyFormat::BinaryLittleEndian;
+            else if (format == "binary_big_endian") header.format = PlyFormat::BinaryBigEndian;
+            else plyError("unknown format '" + format + "'", filepath);
+            haveFormat = true;
+        } else if (keyword == "element") {
+            PlyElement element;
+            if (!(words >> element.name >> element.count)) plyError("bad element line", filepath);
+            header.elements.push_back(std::move(element));
+        } else if (keyword == "property") {
+            if (header.elements.empty()) plyError("property before any element", filepath);
+            PlyProperty property;
+            std::string type;
+            words >> type;
+            if (type == "list") {
+                std::string countType, itemType;
+                words >> countType >> itemType;
+                property.isList = true;
+                if (!parseType(countType, property.countType) || !parseType(itemType, property.type)) {
+                    plyError("unknown list type '" + countType + " " + itemType + "'", filepath);
+                }
+            } else if (!parseType(type, property.type)) {
+                plyError("unknown property type '" + type + "'", filepath);
+            }
+            if (!(words >> property.name)) plyError("unnamed property", filepath);
+            header.elements.back().properties.push_back(std::move(property));
+        } else if (keyword == "end_header") {
+            haveEnd = true;
+        }
+        // comment, obj_info and anything else we don't know are skipped
+    }
+    if (!haveFormat || !haveEnd) plyError("incomplete header", filepath);
+    header.bodyOffset = offset;
+
+    for (PlyElement& element : header.elements) {
+        size_t recordSize = 0;
+        for (const PlyProperty& property : element.properties) {
+            if (property.isList) {
+                recordSize = 0;
+                break;
+            }
+            recordSize += typeSize(property.type);
+        }
+        element.recordSize = recordSize;
+    }
+    return header;
+}
+
+// where the attributes we keep sit in a vertex record, -1 if absent
+struct VertexLayout {
+    int position[3] = {-1, -1, -1};
+    int normal[3] = {-1, -1, -1};
+    int texcoord[2] = {-1, -1};
+
+    bool hasNormals() const { return normal[0] >= 0 && normal[1] >= 0 && normal[2] >= 0; }
+    bool hasTexcoords() const { return texcoord[0] >= 0 && texcoord[1] >= 0; }
+};
+
+VertexLayout vertexLayout(const PlyElement& element) {
+    VertexLayout layout;
+    for (size_t i = 0; i < element.properties.size(); ++i) {
+        const PlyProperty& property = element.properties[i];
+        if (property.isList) continue;
+        const std::string& n = property.name;
+        int index = static_cast<int>(i);
+        if (n == "x") layout.position[0] = index;
+        else if (n == "y") layout.position[1] = index;
+        else if (n == "z") layout.position[2] = index;
+        else if (n == "nx") layout.normal[0] = index;
+        else if (n == "ny") layout.normal[1] = index;
+        else if (n == "nz") layout.normal[2] = index;
+        else if (n == "u" || n == "s" || n == "texture_u" || n == "texture_s") layout.texcoord[0] = index;
+        else if (n == "v" || n == "t" || n == "texture_v" || n == "texture_t") layout.texcoord[1] = index;
+    }
+    return layout;
+}
+
+int faceIndexProperty(const PlyElement& element) {
+    for (size_t i = 0; i < element.properties.size(); ++i) {
+        const PlyProperty& property = element.properties[i];
+        if (property.isList && (property.name == "vertex_indices" || property.name == "vertex_index")) {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+// a face index as read, anything from a float type included. NaN and values past uint32 can't
+// be cast, so they are rejected here and the vertex count is checked by emitPolygon
+inline uint32_t faceIndex(double value, const std::string& filepath) {
+    if (!(value >= 0.0 && value <= double(UINT32_MAX))) plyError("face index out of range", filepath);
+    return static_cast<uint32_t>(value);
+}
+
+// the same for a list length
+inline size_t listLength(double value, const std::string& filepath) {
+    if (!(value >= 0.0 && value <= double(UINT32_MAX))) plyError("list length out of range", filepath);
+    return static_cast<size_t>(value);
+}
+
+// fan-triangulates one polygon, rejecting indices outside the vertex array
+inline void emitPolygon(const uint32_t* polygon, size_t corners, size_t vertexCount, unsigned int* out,
+                        const std::string& filepath) {
+    for (size_t k = 0; k < corners; ++k) {
+        if (polygon[k] >= vertexCount) plyError("face index out of range", filepath);
+    }
+    for (size_t k = 2; k < corners; ++k) {
+        *out++ = polygon[0];
+        *out++ = polygon[k - 1];
+        *out++ = polygon[k];
+    }
+}
+
+inline size_t polygonTriangles(size_t corners) { return corners >= 3 ? corners - 2 : 0; }
+
+// ---------------------------------------------------------------------------------------------
+// binary bodies, read in place from the mapping
+
+inline bool hostIsLittleEndian() {
+    const uint16_t one = 1;
+    unsigned char low;
+    std::memcpy(&low, &one, 1);
+    return low == 1;
+}
+
+template<typename T>
+inline T loadValue(const char* p, bool swap) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, p, sizeof(T));
+    if (swap) std::reverse(bytes, bytes + sizeof(T));
+    T value;
+    std::memcpy(&value, bytes, sizeof(T));
+    return value;
+}
+
+inline double readValue(const char* p, PlyType type, bool swap) {
+    switch (type) {
+        case PlyType::Int8: return static_cast<int8_t>(*p);
+        case PlyType::UInt8: return static_cast<uint8_t>(*p);
+        case PlyType::Int16: return loadValue<int16_t>(p, swap);
+        case PlyType::UInt16: return loadValue<uint16_t>(p, swap);
+        case PlyType::Int32: return loadValue<int32_t>(p, swap);
+        case PlyType::UInt32: return loadValue<uint32_t>(p, swap);
+        case PlyType::Float32: return loadValue<float>(p, swap);
+        case PlyType::Float64: return loadValue<double>(p, swap);
+    }
+    return 0.0;
+}
+
+// reads a list length, rejecting negative and non-finite ones
+inline size_t readCount(const char* p, PlyType type, bool swap, const std::string& filepath) {
+    return listLength(readValue(p, type, swap), filepath);
+}
+
+// one element's slice of the body. records with lists have a per-record start offset,
+// fixed-size ones are found by multiplication
+struct PlySection {
+    size_t begin = 0;
+    size_t end = 0;
+    std::vector<size_t> records;
+
+    size_t record(const PlyElement& element, size_t i) const {
+        return element.recordSize ? begin + i * element.recordSize : records[i];
+    }
+};
+
+// walks the list lengths of every record, the only serial pass over a binary body
+PlySection locateSection(const char* data, size_t size, size_t begin, const PlyElement& element, bool swap,
+                         const std::string& filepath) {
+    PlySection section;
+    section.begin = begin;
+    if (element.recordSize) {
+        if (element.count > (size - begin) / element.recordSize) plyError("truncated '" + element.name + "' section", filepath);
+        section.end = begin + element.count * element.recordSize;
+        return section;
+    }
+
+    section.records.resize(element.count);
+    size_t offset = begin;
+    for (size_t i = 0; i < element.count; ++i) {
+        section.records[i] = offset;
+        for (const PlyProperty& property : element.properties) {
+            if (!property.isList) {
+                offset += typeSize(property.type);
+                continue;
+            }
+            size_t countSize = typeSize(property.countType);
+            if (offset + countSize > size) plyError("truncated '" + element.name + "' section", filepath);
+            size_t count = readCount(data + offset, property.countType, swap, filepath);
+            if (count > (size - offset - countSize) / typeSize(property.type)) {
+                plyError("truncated '" + element.name + "' section", filepath);
+            }
+            offset += countSize + count * typeSize(property.type);
+        }
+        if (offset > size) plyError("truncated '" + element.name + "' section", filepath);
+    }
+    section.end = offset;
+    return section;
+}
+
+// start of property `index` within the record at `offset`
+size_t propertyOffset(const char* data, size_t offset, const PlyElement& element, int index, bool swap,
+                      const std::string& filepath) {
+    for (int i = 0; i < index; ++i) {
+        const PlyProperty& property = element.properties[i];
+        if (property.isList) {
+            size_t count = readCount(data + offset, property.countType, swap, filepath);
+            offset += typeSize(property.countType) + count * typeSize(property.type);
+        } else {
+            offset += typeSize(property.type);
+        }
+    }
+    return offset;
+}
+
+void readBinaryVertices(const char* data, const PlyElement& element, const PlySection& section, bool swap,
+                        float scale, Mesh& mesh, const std::string& filepath) {
+    VertexLayout layout = vertexLayout(element);
+    bool normals = layout.hasNormals(), texcoords = layout.hasTexcoords();
+    mesh.vertices.resize(element.count * 3);
+    if (normals) mesh.normals.resize(element.count * 3);
+    if (texcoords) mesh.texcoords.resize(element.count * 2);
+
+    // byte offset of every property inside a fixed-size record
+    std::vector<size_t> fixedOffsets(element.properties.size(), 0);
+    for (size_t i = 1; i < fixedOffsets.size(); ++i) {
+        fixedOffsets[i] = fixedOffsets[i - 1] + typeSize(element.properties[i - 1].type);
+    }
+
+    parallelFor(0, element.count, [&](size_t v) {
+        size_t record = section.record(element, v);
+        auto read = [&](int index) -> float {
+            if (index < 0) return 0.0f;
+            size_t at = element.recordSize ? record + fixedOffsets[index]
+                                           : propertyOffset(data, record, element, index, swap, filepath);
+            return static_cast<float>(readValue(data + at, element.properties[index].type, swap));
+        };
+        for (int k = 0; k < 3; ++k) mesh.vertices[3 * v + k] = scale * read(layout.position[k]);
+        if (normals) {
+            for (int k = 0; k < 3; ++k) mesh.normals[3 * v + k] = read(layout.normal[k]);
+        }
+        if (texcoords) {
+            for (int k = 0; k < 2; ++k) mesh.texcoords[2 * v + k] = read(layout.texcoord[k]);
+        }
+    }, 4096);
+}
+
+// true if every face of a list-only record layout is a triangle, which lets the face
+// section be indexed by multiplication instead of walked. scanners almost always write these
+bool allTriangles(const char* data, size_t size, size_t begin, const PlyElement& element, int listIndex, bool swap,
+                  size_t& recordSize) {
+    recordSize = 0;
+    for (size_t i = 0; i < element.properties.size(); ++i) {
+        const PlyProperty& property = element.properties[i];
+        if (static_cast<int>(i) == listIndex) recordSize += typeSize(property.countType) + 3 * typeSize(property.type);
+        else if (property.isList) return false;
+        else recordSize += typeSize(property.type);
+    }
+    if (element.count > (size - begin) / recordSize) return false;
+
+    size_t countOffset = 0;
+    for (int i = 0; i < listIndex; ++i) countOffset += typeSize(element.properties[i].type);
+
+    std::atomic<bool> uniform{true};
+    const PlyType countType = element.properties[listIndex].countType;
+    parallelFor(0, element.count, [&](size_t f) {
+        if (!uniform.load(std::memory_order_relaxed)) return;
+        if (readValue(data + begin + f * recordSize + countOffset, countType, swap) != 3.0) uniform = false;
+    }, 1 << 16);
+    return uniform;
+}
+
+void readBinaryFaces(const char* data, size_t size, size_t begin, const PlyElement& element, bool swap,
+                     size_t vertexCount, Mesh& mesh, size_t& sectionEnd, const std::string& filepath) {
+    int listIndex = faceIndexProperty(element);
+    if (listIndex < 0) plyError("face element without vertex_indices", filepath);
+    const PlyProperty& list = element.properties[listIndex];
+    const size_t countSize = typeSize(list.countType), itemSize = typeSize(list.type);
+
+    auto readPolygon = [&](size_t at, size_t corners, unsigned int* out) {
+        uint32_t polygon[64];
+        std::vector<uint32_t> large;
+        uint32_t* p = polygon;
+        if (corners > 64) {
+            large.resize(corners);
+            p = large.data();
+        }
+        for (size_t k = 0; k < corners; ++k) {
+            p[k] = faceIndex(readValue(data + at + k * itemSize, list.type, swap), filepath);
+        }
+        emitPolygon(p, corners, vertexCount, out, filepath);
+    };
+
+    size_t triangleRecord = 0;
+    if (allTriangles(data, size, begin, element, listIndex, swap, triangleRecord)) {
+        size_t listOffset = 0;
+        for (int i = 0; i < listIndex; ++i) listOffset += typeSize(element.properties[i].type);
+        mesh.indices.resize(element.count * 3);
+        parallelFor(0, element.count, [&](size_t f) {
+            readPolygon(begin + f * triangleRecord + listOffset + countSize, 3, &mesh.indices[3 * f]);
+        }, 4096);
+        sectionEnd = begin + element.count * triangleRecord;
+        return;
+    }
+
+    // mixed polygons: walk the records once, then triangulate every face in parallel
+    PlySection section = locateSection(data, size, begin, element, swap, filepath);
+    std::vector<size_t> lists(element.count), firstTriangle(element.count + 1, 0);
+    for (size_t f = 0; f < element.count; ++f) {
+        lists[f] = propertyOffset(data, section.record(element, f), element, listIndex, swap, filepath);
+        size_t corners = readCount(data + lists[f], list.countType, swap, filepath);
+        firstTriangle[f + 1] = firstTriangle[f] + polygonTriangles(corners);
+    }
+    mesh.indices.resize(firstTriangle[element.count] * 3);
+    parallelFor(0, element.count, [&](size_t f) {
+        size_t corners = readCount(data + lists[f], list.countType, swap, filepath);
+        readPolygon(lists[f] + countSize, corners, &mesh.indices[3 * firstTriangle[f]]);
+    }, 1024);
+    sectionEnd = section.end;
+}
+
+void readBinaryBody(const char* data, size_t size, const PlyHeader& header, float scale, Mesh& mesh,
+                    const std::string& filepath) {
+    const bool swap = (header.format == PlyFormat::BinaryLittleEndian) != hostIsLittleEndian();
+    size_t vertexCount = 0;
+    size_t offset = header.bodyOffset;
+    for (const PlyElement& element : header.elements) {
+        if (element.name == "vertex") {
+            PlySection section = locateSection(data, size, offset, element, swap, filepath);
+            readBinaryVertices(data, element, section, swap, scale, mesh, filepath);
+            vertexCount = element.count;
+            offset = section.end;
+        } else if (element.name == "face") {
+            readBinaryFaces(data, size, offset, element, swap, vertexCount, mesh, offset, filepath);
+        } else {
+            offset = locateSection(data, size, offset, element, swap, filepath).end;
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------------------------
+// ASCII bodies, one record per line, parsed in newline-aligned chunks like loadOBJ
+
+struct PlyTextChunk {
+    const char* begin = nullptr;
+    const char* end = nullptr;
+    size_t firstRecord = 0;
+    size_t records = 0;
+    std::vector<unsigned int> triangles;
+};
+
+inline bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline bool blankLine(const char* p, const char* end) {
+    while (p < end && isSpace(*p)) ++p;
+    return p == end;
+}
+
+// next whitespace separated number on the line, false when the line runs out
+inline bool nextNumber(const char*& p, const char* end, double& value) {
+    while (p < end && isSpace(*p)) ++p;
+    if (p == end) return false;
+    const char* last = p;
+    while (last < end && !isSpace(*last)) ++last;
+    value = 0.0;
+    tinyobj::ParseDouble(p, last, &value);
+    p = last;
+    return true;
+}
+
+std::vector<PlyTextChunk> splitTextChunks(const char* data, size_t size) {
+    const size_t minChunk = 1 << 20;
+    size_t count = std::max<size_t>(1, std::min<size_t>(threadCount() * 8, size / minChunk));
+
+    std::vector<PlyTextChunk> chunks;
+    const char* begin = data;
+    const char* end = data + size;
+    for (size_t i = 1; i <= count && begin < end; ++i) {
+        const char* split = (i == count) ? end : data + size * i / count;
+        if (split < begin) continue;
+        if (split < end) {
+            const char* newline = static_cast<const char*>(std::memchr(split, '\n', end - split));
+            split = newline ? newline + 1 : end;
+        }
+        PlyTextChunk chunk;
+        chunk.begin = begin;
+        chunk.end = split;
+        chunks.push_back(std::move(chunk));
+        begin = split;
+    }
+    return chunks;
+}
+
+template<typename F>
+void forEachLine(const char* begin, const char* end, F&& fn) {
+    const char* line = begin;
+    while (line < end) {
+        const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', end - line));
+        if (!lineEnd) lineEnd = end;
+        if (!blankLine(line, lineEnd)) fn(line, lineEnd);
+        line = lineEnd + 1;
+    }
+}
+
+void readAsciiBody(const char* data, size_t size, const PlyHeader& header, float scale, Mesh& mesh,
+                   const std::string& filepath) {
+    std::vector<PlyTextChunk> chunks = splitTextChunks(data + header.bodyOffset, size - header.bodyOffset);
+
+    // count records per chunk, so every chunk knows which element its lines belong to
+    parallelFor(0, chunks.size(), [&](size_t c) {
+        forEachLine(chunks[c].begin, chunks[c].end, [&](const char*, const char*) { chunks[c].records++; });
+    });
+    for (size_t c = 1; c < chunks.size(); ++c) {
+        chunks[c].firstRecord = chunks[c - 1].firstRecord + chunks[c - 1].records;
+    }
+
+    std::vector<size_t> elementFirst(header.elements.size() + 1, 0);
+    const PlyElement* vertexElement = nullptr;
+    size_t vertexElementIndex = 0;
+    for (size_t e = 0; e < header.elements.size(); ++e) {
+        elementFirst[e + 1] = elementFirst[e] + header.elements[e].count;
+        if (header.elements[e].name == "vertex") {
+            vertexElement = &header.elements[e];
+            vertexElementIndex = e;
+        }
+    }
+    size_t totalRecords = chunks.empty() ? 0 : chunks.back().firstRecord + chunks.back().records;
+    if (totalRecords < elementFirst.back()) plyError("truncated body", filepath);
+
+    const size_t vertexCount = vertexElement ? vertexElement->count : 0;
+    VertexLayout layout = vertexElement ? vertexLayout(*vertexElement) : VertexLayout();
+    const bool normals = layout.hasNormals(), texcoords = layout.hasTexcoords();
+    mesh.vertices.resize(vertexCount * 3);
+    if (normals) mesh.normals.resize(vertexCount * 3);
+    if (texcoords) mesh.texcoords.resize(vertexCount * 2);
+
+    parallelFor(0, chunks.size(), [&](size_t c) {
+        PlyTextChunk& chunk = chunks[c];
+        size_t record = chunk.firstRecord;
+        size_t e = 0;
+        std::vector<double> values;
+        std::vector<uint32_t> polygon;
+
+        forEachLine(chunk.begin, chunk.end, [&](const char* p, const char* end) {
+            size_t r = record++;
+            while (e < header.elements.size() && r >= elementFirst[e + 1]) ++e;
+            if (e == header.elements.size()) return;   // trailing lines past the last element
+            const PlyElement& element = header.elements[e];
+            bool isVertex = e == vertexElementIndex && vertexElement;
+            bool isFace = element.name == "face";
+            if (!isVertex && !isFace) return;
+
+            // scalars go to `values` in property order, the face index list to `polygon`
+            values.assign(element.properties.size(), 0.0);
+            polygon.clear();
+            for (size_t i = 0; i < element.properties.size(); ++i) {
+                const PlyProperty& property = element.properties[i];
+                double value = 0.0;
+                if (!nextNumber(p, end, value)) plyError("short '" + element.name + "' record", filepath);
+                if (!property.isList) {
+                    values[i] = value;
+                    continue;
+                }
+                bool indices = isFace && (property.name == "vertex_indices" || property.name == "vertex_index");
+                for (size_t k = 0, n = listLength(value, filepath); k < n; ++k) {
+                    if (!nextNumber(p, end, value)) plyError("short '" + element.name + "' record", filepath);
+                    if (indices) polygon.push_back(faceIndex(value, filepath));
+                }
+            }
+
+            if (isVertex) {
+                size_t v = r - elementFirst[e];
+                for (int k = 0; k < 3; ++k) {
+                    mesh.vertices[3 * v + k] = layout.position[k] >= 0 ? scale * static_cast<float>(values[layout.position[k]]) : 0.0f;
+                }
+                if (normals) {
+                    for (int k = 0; k < 3; ++k) mesh.normals[3 * v + k] = static_cast<float>(values[layout.normal[k]]);
+                }
+                if (texcoords) {
+                    for (int k = 0; k < 2; ++k) mesh.texcoords[2 * v + k] = static_cast<float>(values[layout.texcoord[k]]);
+                }
+            } else {
+                size_t first = chunk.triangles.size();
+                chunk.triangles.resize(first + 3 * polygonTriangles(polygon.size()));
+                emitPolygon(polygon.data(), polygon.size(), vertexCount, chunk.triangles.data() + first, filepath);
+            }
+        });
+    });
+
+    // faces come out in file order, chunk by chunk
+    std::vector<size_t> triangleBase(chunks.size() + 1, 0);
+    for (size_t c = 0; c < chunks.size(); ++c) triangleBase[c + 1] = triangleBase[c] + chunks[c].triangles.size();
+    mesh.indices.resize(triangleBase[chunks.size()]);
+    parallelFor(0, chunks.size(), [&](size_t c) {
+        std::copy(chunks[c].triangles.begin(), chunks[c].triangles.end(), mesh.indices.begin() + triangleBase[c]);
+        std::vector<unsigned int>().swap(chunks[c].triangles);
+    });
+}
+
+}
+
+Mesh loadPLY(const std::string& filepath, float scale) {
+    auto start = std::chrono::steady_clock::now();
+
+    MappedFile file(filepath);
+    PlyHeader header = parseHeader(file.data(), file.size(), filepath);
+
+    Mesh mesh;
+    if (header.format == PlyFormat::Ascii) {
+        readAsciiBody(file.data(), file.size(), header, scale, mesh, filepath);
+    } else {
+        readBinaryBody(file.data(), file.size(), header, scale, mesh, filepath);
+    }
+
+    static const char* formatNames[] = {"ascii", "binary little endian", "binary big endian"};
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double megabytes = file.size() / (1024.0 * 1024.0);
+    std::cout << "Parsed " << filepath << ": " << megabytes << " MB in " << seconds * 1000.0 << " ms ("
+              << megabytes / seconds << " MB/s, " << formatNames[static_cast<int>(header.format)] << " on "
+              << threadCount() << " threads)" << std::endl;
+    std::cout << "Read " << mesh.vertices.size() / 3 << " vertices and " << mesh.indices.size() / 3 << " triangles" << std::endl;
+
+    return mesh;
+}
@@ -0,0 +1,483 @@
+#include "SceneGenerator.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+
+const float pi = 3.14159265358979f;
+
+// splitmix64 finalizer
+uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+// Counter based generator. Every object draws from its own (seed, stream) pair, so objects can
+// be made in any order on any number of threads. std:: distributions aren't the same across
+// standard libraries, hence the hand rolled conversions.
+struct Random {
+    uint64_t state;
+
+    Random(uint64_t seed, uint64_t stream) : state(mix(seed + mix(stream))) {}
+
+    uint64_t next() {
+        state += 0x9e3779b97f4a7c15ULL;
+        return mix(state);
+    }
+
+    float uniform() { return static_cast<float>(next() >> 40) * (1.0f / 16777216.0f); }
+    float range(float lo, float hi) { return lo + (hi - lo) * uniform(); }
+
+    // uniformly distributed unit vector
+    void direction(float d[3]) {
+        float z = range(-1.0f, 1.0f), phi = range(0.0f, 2.0f * pi);
+        float r = std::sqrt(std::max(0.0f, 1.0f - z * z));
+        d[0] = r * std::cos(phi);
+        d[1] = r * std::sin(phi);
+        d[2] = z;
+    }
+};
+
+// stream bases, so the parts of a mixed scene don't copy each other's random numbers
+const uint64_t streamSpheres = 1ULL << 40;
+const uint64_t streamTerrain = 2ULL << 40;
+const uint64_t streamInstances = 3ULL << 40;
+const uint64_t streamSlivers = 4ULL << 40;
+
+struct Box {
+    float lo[3];
+    float hi[3];
+
+    float extent(int axis) const { return hi[axis] - lo[axis]; }
+};
+
+const Box unitBox = {{-1.0f, -1.0f, -1.0f}, {1.0f, 1.0f, 1.0f}};
+const Box groundBox = {{-1.0f, -1.0f, -1.0f}, {1.0f, 0.0f, 1.0f}};
+
+inline void normalize(float v[3]) {
+    float length = std::sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+    if (length > 0.0f) {
+        v[0] /= length;
+        v[1] /= length;
+        v[2] /= length;
+    }
+}
+
+// room for a new part at the end of the mesh, filled in place by the generators
+struct Part {
+    float* vertices;
+    float* normals;
+    unsigned int* indices;
+    unsigned int firstVertex;
+};
+
+Part grow(Mesh& mesh, size_t vertexCount, size_t triangleCount) {
+    size_t vertexStart = mesh.vertices.size(), indexStart = mesh.indices.size();
+    if (vertexStart / 3 + vertexCount > UINT32_MAX) {
+        throw std::runtime_error("Failed to generate scene: too many vertices for 32-bit indices");
+    }
+    mesh.vertices.resize(vertexStart + vertexCount * 3);
+    mesh.normals.resize(vertexStart + vertexCount * 3);
+    mesh.indices.resize(indexStart + triangleCount * 3);
+    return {mesh.vertices.data() + vertexStart, mesh.normals.data() + vertexStart, mesh.indices.data() + indexStart,
+            static_cast<unsigned int>(vertexStart / 3)};
+}
+
+// value noise on an integer lattice, smoothly interpolated, in [-1, 1]
+float lattice(int64_t x, int64_t z, uint64_t seed) {
+    uint64_t h = mix(seed ^ mix(static_cast<uint64_t>(x) * 0x9e3779b97f4a7c15ULL + static_cast<uint64_t>(z)));
+    return static_cast<float>(h >> 40) * (2.0f / 16777216.0f) - 1.0f;
+}
+
+float valueNoise(float x, float z, uint64_t seed) {
+    float fx = std::floor(x), fz = std::floor(z);
+    int64_t ix = static_cast<int64_t>(fx), iz = static_cast<int64_t>(fz);
+    float tx = x - fx, tz = z - fz;
+    tx = tx * tx * (3.0f - 2.0f * tx);
+    tz = tz * tz * (3.0f - 2.0f * tz);
+    float a = lattice(ix, iz, seed), b = lattice(ix + 1, iz, seed);
+    float c = lattice(ix, iz + 1, seed), d = lattice(ix + 1, iz + 1, seed);
+    return (a + (b - a) * tx) * (1.0f - tz) + (c + (d - c) * tx) * tz;
+}
+
+float fractalNoise(float x, float z, uint64_t seed, int octaves) {
+    float sum = 0.0f, amplitude = 0.5f, total = 0.0f;
+    for (int o = 0; o < octaves; ++o) {
+        sum += amplitude * valueNoise(x, z, seed + o);
+        total += amplitude;
+        x *= 2.03f;
+        z *= 2.03f;
+        amplitude *= 0.5f;
+    }
+    return sum / total;
+}
+
+// UV sphere with `rings` latitude bands and twice as many segments around:
+// 2 + (rings - 1) * segments vertices and 2 * segments * (rings - 1) triangles
+size_t sphereRings(size_t triangles) {
+    return std::max<size_t>(3, static_cast<size_t>(std::lround((1.0 + std::sqrt(1.0 + triangles)) / 2.0)));
+}
+
+size_t sphereVertices(size_t rings) { return 2 + (rings - 1) * 2 * rings; }
+size_t sphereTriangles(size_t rings) { return 4 * rings * (rings - 1); }
+
+// unit sphere, counter-clockwise seen from outside. positions equal normals
+void writeSphere(size_t rings, float* normals, unsigned int* indices, unsigned int first) {
+    size_t segments = 2 * rings;
+    size_t bottom = 1 + (rings - 1) * segments;
+    float* n = normals;
+    *n++ = 0.0f; *n++ = 1.0f; *n++ = 0.0f;
+    for (size_t i = 1; i < rings; ++i) {
+        float theta = pi * i / rings;
+        for (size_t j = 0; j < segments; ++j) {
+            float phi = 2.0f * pi * j / segments;
+            *n++ = std::sin(theta) * std::cos(phi);
+            *n++ = std::cos(theta);
+            *n++ = std::sin(theta) * std::sin(phi);
+        }
+    }
+    *n++ = 0.0f; *n++ = -1.0f; *n++ = 0.0f;
+
+    auto ring = [&](size_t i, size_t j) { return first + static_cast<unsigned int>(1 + (i - 1) * segments + j % segments); };
+    unsigned int* out = indices;
+    for (size_t j = 0; j < segments; ++j) {
+        *out++ = first; *out++ = ring(1, j + 1); *out++ = ring(1, j);
+    }
+    for (size_t i = 1; i + 1 < rings; ++i) {
+        for (size_t j = 0; j < segments; ++j) {
+            *out++ = ring(i, j); *out++ = ring(i, j + 1); *out++ = ring(i + 1, j);
+            *out++ = ring(i, j + 1); *out++ = ring(i + 1, j + 1); *out++ = ring(i + 1, j);
+        }
+    }
+    for (size_t j = 0; j < segments; ++j) {
+        *out++ = ring(rings - 1, j); *out++ = ring(rings - 1, j + 1); *out++ = first + static_cast<unsigned int>(bottom);
+    }
+}
+
+void addSpheres(Mesh& mesh, size_t triangles, uint64_t seed, const Box& box) {
+    size_t count = std::max<size_t>(1, triangles / 4096);
+    size_t rings = sphereRings(triangles / count);
+    size_t vertices = sphereVertices(rings), faces = sphereTriangles(rings);
+    Part part = grow(mesh, count * vertices, count * faces);
+
+    float smallest = std::min({box.extent(0), box.extent(1), box.extent(2)});
+    float spread = std::cbrt(static_cast<float>(count));
+    parallelFor(0, count, [&](size_t s) {
+        Random rng(seed, streamSpheres + s);
+        float radius = rng.range(0.25f, 1.0f) * 0.5f * smallest / spread;
+        float center[3];
+        for (int k = 0; k < 3; ++k) center[k] = rng.range(box.lo[k] + radius, box.hi[k] - radius);
+
+        float* normals = part.normals + 3 * s * vertices;
+        float* positions = part.vertices + 3 * s * vertices;
+        writeSphere(rings, normals, part.indices + 3 * s * faces, part.firstVertex + static_cast<unsigned int>(s * vertices));
+        for (size_t v = 0; v < vertices; ++v) {
+            for (int k = 0; k < 3; ++k) positions[3 * v + k] = center[k] + radius * normals[3 * v + k];
+        }
+    }, 16);
+}
+
+void addTerrain(Mesh& mesh, size_t triangles, uint64_t seed, const Box& box) {
+    size_t n = std::max<size_t>(2, static_cast<size_t>(std::lround(std::sqrt(triangles / 2.0))) + 1);
+    Part part = grow(mesh, n * n, 2 * (n - 1) * (n - 1));
+    uint64_t noiseSeed = Random(seed, streamTerrain).next();
+
+    parallelFor(0, n, [&](size_t j) {
+        for (size_t i = 0; i < n; ++i) {
+            float u = static_cast<float>(i) / (n - 1), v = static_cast<float>(j) / (n - 1);
+            float* p = part.vertices + 3 * (j * n + i);
+            p[0] = box.lo[0] + u * box.extent(0);
+            p[1] = box.lo[1] + box.extent(1) * (0.5f + 0.5f * fractalNoise(4.0f * u, 4.0f * v, noiseSeed, 8));
+            p[2] = box.lo[2] + v * box.extent(2);
+        }
+    }, 16);
+
+    // normals from central differences, one-sided at the border
+    parallelFor(0, n, [&](size_t j) {
+        for (size_t i = 0; i < n; ++i) {
+            const float* left = part.vertices + 3 * (j * n + (i > 0 ? i - 1 : i));
+            const float* right = part.vertices + 3 * (j * n + (i + 1 < n ? i + 1 : i));
+            const float* back = part.vertices + 3 * ((j > 0 ? j - 1 : j) * n + i);
+            const float* front = part.vertices + 3 * ((j + 1 < n ? j + 1 : j) * n + i);
+            float* normal = part.normals + 3 * (j * n + i);
+            normal[0] = -(right[1] - left[1]) / (right[0] - left[0]);
+            normal[1] = 1.0f;
+            normal[2] = -(front[1] - back[1]) / (front[2] - back[2]);
+            normalize(normal);
+        }
+    }, 16);
+
+    parallelFor(0, n - 1, [&](size_t j) {
+        unsigned int* out = part.indices + 6 * j * (n - 1);
+        for (size_t i = 0; i + 1 < n; ++i) {
+            unsigned int a = part.firstVertex + static_cast<unsigned int>(j * n + i), b = a + 1;
+            unsigned int c = a + static_cast<unsigned int>(n), d = c + 1;
+            *out++ = a; *out++ = c; *out++ = b;
+            *out++ = b; *out++ = c; *out++ = d;
+        }
+    }, 16);
+}
+
+// a lumpy, squashed sphere of about `triangles` triangles with smooth normals, radius about 1
+Mesh makeRock(size_t triangles, uint64_t seed) {
+    size_t rings = sphereRings(triangles);
+    Mesh rock;
+    Part part = grow(rock, sphereVertices(rings), sphereTriangles(rings));
+    writeSphere(rings, part.normals, part.indices, 0);
+
+    // a few random waves along random directions keep it seamless
+    Random rng(seed, streamInstances);
+    float directions[6][3], frequency[6], phase[6];
+    for (int k = 0; k < 6; ++k) {
+        rng.direction(directions[k]);
+        frequency[k] = rng.range(2.0f, 6.0f);
+        phase[k] = rng.range(0.0f, 2.0f * pi);
+    }
+    size_t vertexCount = rock.vertices.size() / 3;
+    for (size_t v = 0; v < vertexCount; ++v) {
+        const float* n = part.normals + 3 * v;
+        float r = 1.0f;
+        for (int k = 0; k < 6; ++k) {
+            float along = n[0] * directions[k][0] + n[1] * directions[k][1] + n[2] * directions[k][2];
+            r += 0.06f * std::sin(frequency[k] * along + phase[k]);
+        }
+        part.vertices[3 * v + 0] = r * n[0];
+        part.vertices[3 * v + 1] = 0.6f * r * n[1];
+        part.vertices[3 * v + 2] = r * n[2];
+    }
+
+    // area-weighted vertex normals of the displaced surface
+    std::fill(rock.normals.begin(), rock.normals.end(), 0.0f);
+    for (size_t t = 0; t < rock.indices.size(); t += 3) {
+        const float* a = &rock.vertices[3 * rock.indices[t]];
+        const float* b = &rock.vertices[3 * rock.indices[t + 1]];
+        const float* c = &rock.vertices[3 * rock.indices[t + 2]];
+        float e1[3] = {b[0] - a[0], b[1] - a[1], b[2] - a[2]};
+        float e2[3] = {c[0] - a[0], c[1] - a[1], c[2] - a[2]};
+        float n[3] = {e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0]};
+        for (int k = 0; k < 3; ++k) {
+            for (int j = 0; j < 3; ++j) rock.normals[3 * rock.indices[t + k] + j] += n[j];
+        }
+    }
+    for (size_t v = 0; v < vertexCount; ++v) normalize(&rock.normals[3 * v]);
+    return rock;
+}
+
+ScatteredInstances scatter(size_t triangles, uint64_t seed, const Box& box) {
+    ScatteredInstances scene;
+    size_t baseTriangles = std::clamp<size_t>(static_cast<size_t>(2.0 * std::sqrt(static_cast<double>(triangles))), 80, 8192);
+    scene.base = makeRock(baseTriangles, seed);
+    size_t count = std::max<size_t>(1, triangles / (scene.base.indices.size() / 3));
+    scene.transforms.resize(count);
+
+    float spacing = std::sqrt(box.extent(0) * box.extent(2) / count);
+    // the rock reaches at most 1.4 from its center in any orientation
+    float largest = std::min({box.extent(0), box.extent(1), box.extent(2)}) / 2.8f;
+    parallelFor(0, count, [&](size_t i) {
+        Random rng(seed, streamInstances + 1 + i);
+        float scale = std::min(largest, spacing * rng.range(0.25f, 0.5f));
+
+        // uniformly random rotation from a random unit quaternion (Shoemake)
+        float u1 = rng.uniform(), u2 = rng.range(0.0f, 2.0f * pi), u3 = rng.range(0.0f, 2.0f * pi);
+        float x = std::sqrt(1.0f - u1) * std::sin(u2), y = std::sqrt(1.0f - u1) * std::cos(u2);
+        float z = std::sqrt(u1) * std::sin(u3), w = std::sqrt(u1) * std::cos(u3);
+        float* m = scene.transforms[i].data();
+        m[0] = scale * (1 - 2 * (y * y + z * z)); m[1] = scale * 2 * (x * y - z * w);     m[2] = scale * 2 * (x * z + y * w);
+        m[4] = scale * 2 * (x * y + z * w);     m[5] = scale * (1 - 2 * (x * x + z * z)); m[6] = scale * 2 * (y * z - x * w);
+        m[8] = scale * 2 * (x * z - y * w);     m[9] = scale * 2 * (y * z + x * w);     m[10] = scale * (1 - 2 * (x * x + y * y));
+
+        // resting on the floor of the box
+        m[3] = rng.range(box.lo[0] + 1.4f * scale, box.hi[0] - 1.4f * scale);
+        m[7] = box.lo[1] + 1.4f * scale;
+        m[11] = rng.range(box.lo[2] + 1.4f * scale, box.hi[2] - 1.4f * scale);
+    }, 64);
+    return scene;
+}
+
+void addInstances(Mesh& mesh, size_t triangles, uint64_t seed, const Box& box) {
+    ScatteredInstances scene = scatter(triangles, seed, box);
+    const Mesh& base = scene.base;
+    size_t vertices = base.vertices.size() / 3, faces = base.indices.size() / 3;
+    Part part = grow(mesh, scene.transforms.size() * vertices, scene.transforms.size() * faces);
+
+    parallelFor(0, scene.transforms.size(), [&](size_t i) {
+        const float* m = scene.transforms[i].data();
+        float* positions = part.vertices + 3 * i * vertices;
+        float* normals = part.normals + 3 * i * vertices;
+        for (size_t v = 0; v < vertices; ++v) {
+            const float* p = &base.vertices[3 * v];
+            const float* n = &base.normals[3 * v];
+            for (int r = 0; r < 3; ++r) {
+                positions[3 * v + r] = m[4 * r] * p[0] + m[4 * r + 1] * p[1] + m[4 * r + 2] * p[2] + m[4 * r + 3];
+                // uniform scale, so the linear part turns normals correctly up to length
+                normals[3 * v + r] = m[4 * r] * n[0] + m[4 * r + 1] * n[1] + m[4 * r + 2] * n[2];
+            }
+            normalize(&normals[3 * v]);
+        }
+        unsigned int offset = part.firstVertex + static_cast<unsigned int>(i * vertices);
+        unsigned int* indices = part.indices + 3 * i * faces;
+        for (size_t k = 0; k < 3 * faces; ++k) indices[k] = base.indices[k] + offset;
+    }, 16);
+}
+
+// Ribbons between two parallel edges, triangulated across their length: every triangle is as
+// long as the ribbon and only a sliver wide, like the caps and fans CAD exporters produce.
+void addSlivers(Mesh& mesh, size_t triangles, uint64_t seed, const Box& box) {
+    const size_t perRibbon = std::clamp<size_t>(triangles & ~size_t(1), 2, 64);
+    size_t count = std::max<size_t>(1, triangles / perRibbon);
+    size_t steps = perRibbon / 2, vertices = 2 * (steps + 1);
+    Part part = grow(mesh, count * vertices, count * perRibbon);
+
+    float smallest = std::min({box.extent(0), box.extent(1), box.extent(2)});
+    float spread = std::cbrt(static_cast<float>(count));
+    parallelFor(0, count, [&](size_t s) {
+        Random rng(seed, streamSlivers + s);
+        float across[3], along[3], normal[3];
+        rng.direction(across);
+        rng.direction(along);
+        // length direction orthogonal to the one the ribbon grows in
+        float d = along[0] * across[0] + along[1] * across[1] + along[2] * across[2];
+        for (int k = 0; k < 3; ++k) along[k] -= d * across[k];
+        normalize(along);
+        normal[0] = along[1] * across[2] - along[2] * across[1];
+        normal[1] = along[2] * across[0] - along[0] * across[2];
+        normal[2] = along[0] * across[1] - along[1] * across[0];
+
+        // long against their width, but short enough that not every ribbon crosses every other
+        float length = smallest * std::min(0.6f, rng.range(0.5f, 1.5f) / spread);
+        float step = length * std::pow(10.0f, rng.range(-3.0f, -1.5f));
+        float width = step * steps;
+        float start[3];
+        for (int k = 0; k < 3; ++k) {
+            float half = 0.5f * (std::fabs(across[k]) * width + std::fabs(along[k]) * length);
+            start[k] = rng.range(box.lo[k] + half, box.hi[k] - half) - 0.5f * (across[k] * width + along[k] * length);
+        }
+
+        float* positions = part.vertices + 3 * s * vertices;
+        float* normals = part.normals + 3 * s * vertices;
+        for (size_t i = 0; i <= steps; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                positions[6 * i + k] = start[k] + i * step * across[k];
+                positions[6 * i + 3 + k] = positions[6 * i + k] + length * along[k];
+                normals[6 * i + k] = normal[k];
+                normals[6 * i + 3 + k] = normal[k];
+            }
+        }
+        unsigned int first = part.firstVertex + static_cast<unsigned int>(s * vertices);
+        unsigned int* out = part.indices + 3 * s * perRibbon;
+        for (size_t i = 0; i < steps; ++i) {
+            unsigned int a = first + static_cast<unsigned int>(2 * i), b = a + 1, c = a + 2, e = a + 3;
+            *out++ = a; *out++ = b; *out++ = c;
+            *out++ = c; *out++ = b; *out++ = e;
+        }
+    }, 256);
+}
+
+}
+
+const char* sceneKindName(SceneKind kind) {
+    switch (kind) {
+        case SceneKind::Spheres: return "spheres";
+        case SceneKind::Terrain: return "terrain";
+        case SceneKind::Instances: return "instances";
+        case SceneKind::Slivers: return "slivers";
+        case SceneKind::Mixed: return "mixed";
+    }
+    return "unknown";
+}
+
+SceneSpec parseSceneSpec(const std::string& text) {
+    auto fail = [&](const std::string& what) {
+        return std::runtime_error("Failed to parse scene spec: " + what + " in '" + text + "'");
+    };
+    std::vector<std::string> fields;
+    size_t start = 0;
+    for (;;) {
+        size_t end = text.find(':', start);
+        fields.push_back(text.substr(start, end == std::string::npos ? std::string::npos : end - start));
+        if (end == std::string::npos) break;
+        start = end + 1;
+    }
+    if (fields.size() > 3) throw fail("too many fields");
+
+    SceneSpec spec;
+    bool known = false;
+    for (SceneKind kind : {SceneKind::Spheres, SceneKind::Terrain, SceneKind::Instances, SceneKind::Slivers, SceneKind::Mixed}) {
+        if (fields[0] == sceneKindName(kind)) {
+            spec.kind = kind;
+            known = true;
+        }
+    }
+    if (!known) throw fail("unknown scene '" + fields[0] + "'");
+
+    if (fields.size() > 1) {
+        std::string count = fields[1];
+        double multiplier = 1.0;
+        if (!count.empty()) {
+            char suffix = static_cast<char>(std::tolower(static_cast<unsigned char>(count.back())));
+            if (suffix == 'k') multiplier = 1e3;
+            if (suffix == 'm') multiplier = 1e6;
+            if (multiplier != 1.0) count.pop_back();
+        }
+        size_t used = 0;
+        double value = 0.0;
+        try {
+            value = std::stod(count, &used);
+        } catch (const std::exception&) {
+            used = 0;
+        }
+        if (used == 0 || used != count.size() || value * multiplier < 1.0) throw fail("bad triangle count '" + fields[1] + "'");
+        spec.triangles = static_cast<size_t>(value * multiplier);
+    }
+    if (fields.size() > 2) {
+        size_t used = 0;
+        try {
+            spec.seed = std::stoull(fields[2], &used);
+        } catch (const std::exception&) {
+            used = 0;
+        }
+        if (used == 0 || used != fields[2].size()) throw fail("bad seed '" + fields[2] + "'");
+    }
+    return spec;
+}
+
+Mesh generateScene(const SceneSpec& spec) {
+    Mesh mesh;
+    size_t triangles = std::max<size_t>(1, spec.triangles);
+    switch (spec.kind) {
+        case SceneKind::Spheres: addSpheres(mesh, triangles, spec.seed, unitBox); break;
+        case SceneKind::Terrain: addTerrain(mesh, triangles, spec.seed, unitBox); break;
+        case SceneKind::Instances: addInstances(mesh, triangles, spec.seed, groundBox); break;
+        case SceneKind::Slivers: addSlivers(mesh, triangles, spec.seed, unitBox); break;
+        case SceneKind::Mixed: {
+            // ground, rocks on it, spheres and slivers in the air above
+            const Box ground = {{-1.0f, -1.0f, -1.0f}, {1.0f, -0.7f, 1.0f}};
+            const Box rocks = {{-1.0f, -0.9f, -1.0f}, {1.0f, -0.5f, 1.0f}};
+            const Box air = {{-1.0f, -0.4f, -1.0f}, {1.0f, 1.0f, 1.0f}};
+            size_t terrain = triangles * 4 / 10, instances = triangles * 3 / 10, spheres = triangles * 2 / 10;
+            size_t slivers = triangles - terrain - instances - spheres;
+            // the parts round their counts a little, leave some slack so the big arrays aren't copied
+            mesh.vertices.reserve(3 * (triangles * 3 / 4));
+            mesh.normals.reserve(3 * (triangles * 3 / 4));
+            mesh.indices.reserve(3 * (triangles + triangles / 8));
+            if (terrain) addTerrain(mesh, terrain, spec.seed, ground);
+            if (instances) addInstances(mesh, instances, spec.seed, rocks);
+            if (spheres) addSpheres(mesh, spheres, spec.seed, air);
+            if (slivers) addSlivers(mesh, slivers, spec.seed, air);
+            break;
+        }
+    }
+    return mesh;
+}
+
+ScatteredInstances scatterInstances(size_t triangles, uint64_t seed) {
+    return scatter(std::max<size_t>(1, triangles), seed, groundBox);
+}
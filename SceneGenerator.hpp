@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Mesh.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Procedural test scenes, so loaders, BVH builders and tracers can be measured from a thousand
+// to a hundred million triangles without shipping assets. A scene is a pure function of its
+// kind, triangle budget and seed: the same spec gives the same mesh on every run and thread
+// count. Triangle counts land close to the budget, everything fits in [-1, 1]^3 and every
+// scene comes with vertex normals.
+enum class SceneKind {
+    Spheres,    // tessellated spheres of random size and placement
+    Terrain,    // one height field displaced by fractal value noise
+    Instances,  // copies of one small rock, randomly rotated, scaled and scattered over the ground
+    Slivers,    // ribbons of long, thin triangles at random orientations, the bad case for object splits
+    Mixed,      // a terrain with spheres, rocks and slivers above it
+};
+
+struct SceneSpec {
+    SceneKind kind = SceneKind::Mixed;
+    size_t triangles = 1000000;
+    uint64_t seed = 1;
+};
+
+const char* sceneKindName(SceneKind kind);
+
+// "kind[:triangles[:seed]]" with an optional k/m suffix on the count, e.g. "terrain:10m:7".
+// throws std::runtime_error on anything it doesn't understand
+SceneSpec parseSceneSpec(const std::string& text);
+
+Mesh generateScene(const SceneSpec& spec);
+
+// The Instances scene before it is flattened into one mesh: the rock and a row-major 3x4
+// world transform per copy, for code that keeps instances apart.
+struct ScatteredInstances {
+    Mesh base;
+    std::vector<std::array<float, 12>> transforms;
+};
+
+ScatteredInstances scatterInstances(size_t triangles, uint64_t seed);
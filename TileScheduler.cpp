@@ -0,0 +1,202 @@
+#include "TileScheduler.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace {
+
+// position d along a Hilbert curve through an n x n grid, n a power of two
+void hilbertPoint(uint32_t n, uint32_t d, uint32_t& x, uint32_t& y) {
+    x = y = 0;
+    for (uint32_t s = 1; s < n; s *= 2) {
+        uint32_t rx = 1 & (d / 2), ry = 1 & (d ^ rx);
+        if (ry == 0) {
+            if (rx == 1) {
+                x = s - 1 - x;
+                y = s - 1 - y;
+            }
+            std::swap(x, y);
+        }
+        x += s * rx;
+        y += s * ry;
+        d /= 4;
+    }
+}
+
+enum class Steal { Empty, Lost, Taken };
+
+// Chase-Lev work-stealing deque of tile indices, in the C11 formulation of Lê et al. The owner
+// pushes and pops at the bottom, thieves take from the top. Every tile is pushed before the run
+// starts, so the capacity is fixed and the buffer never grows.
+class TileDeque {
+public:
+    explicit TileDeque(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) size *= 2;
+        mask = size - 1;
+        items.reset(new std::atomic<uint32_t>[size]);
+    }
+
+    void push(uint32_t item) {
+        int64_t b = bottom.load(std::memory_order_relaxed);
+        items[b & mask].store(item, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    bool pop(uint32_t& item) {
+        int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        item = items[b & mask].load(std::memory_order_relaxed);
+        if (t < b) return true;
+        // the last one, which a thief may be taking at the same time
+        bool won = top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    Steal steal(uint32_t& item) {
+        int64_t t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = bottom.load(std::memory_order_acquire);
+        if (t >= b) return Steal::Empty;
+        item = items[t & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) return Steal::Lost;
+        return Steal::Taken;
+    }
+
+private:
+    // apart, so the owner's end and the thieves' end don't share a cache line
+    alignas(64) std::atomic<int64_t> top{0};
+    alignas(64) std::atomic<int64_t> bottom{0};
+    std::unique_ptr<std::atomic<uint32_t>[]> items;
+    size_t mask = 0;
+};
+
+double secondsBetween(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to) {
+    return std::chrono::duration<double>(to - from).count();
+}
+
+}
+
+std::vector<Tile> makeTiles(size_t width, size_t height, unsigned tileSize, TileOrder order) {
+    tileSize = std::max(tileSize, 1u);
+    uint32_t columns = static_cast<uint32_t>((width + tileSize - 1) / tileSize);
+    uint32_t rows = static_cast<uint32_t>((height + tileSize - 1) / tileSize);
+    std::vector<Tile> tiles;
+    tiles.reserve(size_t(columns) * rows);
+    auto add = [&](uint32_t column, uint32_t row) {
+        uint32_t x0 = column * tileSize, y0 = row * tileSize;
+        tiles.push_back({x0, y0, static_cast<uint32_t>(std::min<size_t>(x0 + tileSize, width)),
+                         static_cast<uint32_t>(std::min<size_t>(y0 + tileSize, height))});
+    };
+
+    if (order == TileOrder::Hilbert) {
+        // the curve through the smallest power of two square around the grid, skipping the
+        // cells outside it
+        uint32_t n = 1;
+        while (n < columns || n < rows) n *= 2;
+        for (uint32_t d = 0; d < n * n; ++d) {
+            uint32_t x, y;
+            hilbertPoint(n, d, x, y);
+            if (x < columns && y < rows) add(x, y);
+        }
+    } else {
+        for (uint32_t row = 0; row < rows; ++row) {
+            for (uint32_t column = 0; column < columns; ++column) add(column, row);
+        }
+        if (order == TileOrder::Spiral) {
+            // by ring around the centre tile, then by angle within the ring
+            float cx = 0.5f * (columns - 1), cy = 0.5f * (rows - 1);
+            auto key = [&](const Tile& tile) {
+                float dx = tile.x0 / float(tileSize) - cx, dy = tile.y0 / float(tileSize) - cy;
+                return std::make_pair(std::lround(std::max(std::fabs(dx), std::fabs(dy))), std::atan2(dy, dx));
+            };
+            std::stable_sort(tiles.begin(), tiles.end(), [&](const Tile& a, const Tile& b) { return key(a) < key(b); });
+        }
+    }
+    return tiles;
+}
+
+TileSchedulerStats runTiles(const std::vector<Tile>& tiles, const std::function<void(const Tile&)>& fn,
+                            const TileSchedulerOptions& options) {
+    unsigned workers = options.threads ? options.threads : threadCount();
+    workers = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(workers, tiles.size())));
+
+    // contiguous runs of the order, pushed back to front so each owner pops them in order and
+    // thieves take the end furthest from where the owner is working
+    std::vector<std::unique_ptr<TileDeque>> deques;
+    for (unsigned w = 0; w < workers; ++w) {
+        size_t first = tiles.size() * w / workers, last = tiles.size() * (w + 1) / workers;
+        deques.emplace_back(new TileDeque(last - first));
+        for (size_t i = last; i > first; --i) deques[w]->push(static_cast<uint32_t>(i - 1));
+    }
+
+    TileSchedulerStats stats;
+    stats.threads.resize(workers);
+    std::atomic<bool> failed{false};
+    std::exception_ptr failure;
+    std::mutex failureLock;
+    auto start = std::chrono::steady_clock::now();
+
+    auto work = [&](unsigned self) {
+        TileThreadStats& mine = stats.threads[self];
+        auto run = [&](uint32_t index) {
+            auto begin = std::chrono::steady_clock::now();
+            fn(tiles[index]);
+            mine.busy += secondsBetween(begin, std::chrono::steady_clock::now());
+            mine.tiles++;
+        };
+        try {
+            uint32_t index;
+            while (!failed.load(std::memory_order_relaxed)) {
+                if (deques[self]->pop(index)) {
+                    run(index);
+                    continue;
+                }
+                if (!options.steal) break;
+                // nothing is pushed once the run has started, so when every deque has been seen
+                // empty there is nothing left to take
+                bool contended = false, stolen = false;
+                for (unsigned k = 1; k < workers && !stolen; ++k) {
+                    Steal result = deques[(self + k) % workers]->steal(index);
+                    contended |= result == Steal::Lost;
+                    stolen = result == Steal::Taken;
+                }
+                if (stolen) {
+                    mine.steals++;
+                    run(index);
+                } else if (!contended) {
+                    break;
+                }
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(failureLock);
+            if (!failure) failure = std::current_exception();
+            failed = true;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(workers - 1);
+    for (unsigned t = 1; t < workers; ++t) threads.emplace_back(work, t);
+    work(0);
+    for (auto& thread : threads) thread.join();
+    if (failure) std::rethrow_exception(failure);
+
+    stats.seconds = secondsBetween(start, std::chrono::steady_clock::now());
+    for (TileThreadStats& thread : stats.threads) thread.idle = std::max(0.0, stats.seconds - thread.busy);
+    return stats;
+}
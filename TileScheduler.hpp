@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+// Image tiles handed out to all cores with work stealing. Every thread starts with a contiguous
+// run of the tile order in its own Chase-Lev deque and works through it front to back; a thread
+// that runs dry steals from the far end of another's run. Sky pixels cost next to nothing and
+// pixels on the model a lot, so equal shares up front leave cores idle where stealing doesn't.
+
+// pixels [x0, x1) x [y0, y1)
+struct Tile {
+    uint32_t x0, y0, x1, y1;
+};
+
+enum class TileOrder {
+    Scanline,  // rows of tiles, left to right
+    Hilbert,   // along a Hilbert curve, so consecutive tiles and every thread's run stay together
+    Spiral,    // rings out from the centre, where the model usually is
+};
+
+struct TileSchedulerOptions {
+    unsigned tileSize = 16;   // pixels along each side, edge tiles are cut to the image
+    TileOrder order = TileOrder::Hilbert;
+    unsigned threads = 0;     // 0 for threadCount()
+    bool steal = true;        // off: every thread keeps its share, the static split, for comparison
+};
+
+// time of one thread from the start of the run to the end of the last tile anywhere
+struct TileThreadStats {
+    double busy = 0.0;  // seconds inside tiles
+    double idle = 0.0;  // seconds looking for work or waiting for the others
+    size_t tiles = 0;
+    size_t steals = 0;
+};
+
+struct TileSchedulerStats {
+    double seconds = 0.0;
+    std::vector<TileThreadStats> threads;
+};
+
+// the tiles of a width x height image in the given order
+std::vector<Tile> makeTiles(size_t width, size_t height, unsigned tileSize, TileOrder order);
+
+// Runs fn on every tile once. The calling thread takes part, and the first exception thrown by
+// fn stops the run and is rethrown here.
+TileSchedulerStats runTiles(const std::vector<Tile>& tiles, const std::function<void(const Tile&)>& fn,
+                            const TileSchedulerOptions& options = {});
@@ -0,0 +1,144 @@
+#include "TwoLevelBvh.hpp"
+#include "Parallel.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include <string>
+
+namespace {
+
+// world to object for a row-major 3x4 affine transform, false if it is singular
+bool invertAffine(const float* m, float* inverse) {
+    float c00 = m[5] * m[10] - m[6] * m[9], c01 = m[6] * m[8] - m[4] * m[10], c02 = m[4] * m[9] - m[5] * m[8];
+    float det = m[0] * c00 + m[1] * c01 + m[2] * c02;
+    if (!(std::fabs(det) > 0.0f) || !std::isfinite(det)) return false;
+    float s = 1.0f / det;
+    float r[9] = {c00 * s, (m[2] * m[9] - m[1] * m[10]) * s, (m[1] * m[6] - m[2] * m[5]) * s,
+                  c01 * s, (m[0] * m[10] - m[2] * m[8]) * s, (m[2] * m[4] - m[0] * m[6]) * s,
+                  c02 * s, (m[1] * m[8] - m[0] * m[9]) * s, (m[0] * m[5] - m[1] * m[4]) * s};
+    for (int row = 0; row < 3; ++row) {
+        const float* a = &r[3 * row];
+        inverse[4 * row] = a[0];
+        inverse[4 * row + 1] = a[1];
+        inverse[4 * row + 2] = a[2];
+        inverse[4 * row + 3] = -(a[0] * m[3] + a[1] * m[7] + a[2] * m[11]);
+    }
+    return true;
+}
+
+// world box of an object space box under m: every row of the matrix takes the corner that
+// makes it smallest or largest on its own (Arvo)
+void transformBox(const float* m, const BvhNode& box, float* out) {
+    for (int row = 0; row < 3; ++row) {
+        float lo = m[4 * row + 3], hi = lo;
+        for (int k = 0; k < 3; ++k) {
+            float a = m[4 * row + k] * box.boundsMin[k], b = m[4 * row + k] * box.boundsMax[k];
+            lo += std::min(a, b);
+            hi += std::max(a, b);
+        }
+        out[row] = lo;
+        out[3 + row] = hi;
+    }
+}
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+size_t treeBytes(const Bvh& bvh) {
+    return bvh.nodes.size() * sizeof(BvhNode) + bvh.primitives.size() * sizeof(uint32_t);
+}
+
+}
+
+TwoLevelBvh buildTwoLevelBvh(const std::vector<TriangleGeometry>& meshes, const std::vector<Instance>& instances,
+                             const BvhBuildOptions& meshOptions, const BvhBuildOptions& topOptions) {
+    auto start = std::chrono::steady_clock::now();
+    TwoLevelBvh scene;
+    scene.meshes.resize(meshes.size());
+    // every mesh builds on all cores by itself
+    for (size_t i = 0; i < meshes.size(); ++i) {
+        scene.meshes[i].geometry = meshes[i];
+        scene.meshes[i].bvh = buildBvh(meshes[i], meshOptions);
+    }
+    scene.instances = instances;
+    rebuildTopLevel(scene, topOptions);
+    scene.stats.seconds = secondsSince(start);
+    return scene;
+}
+
+void rebuildTopLevel(TwoLevelBvh& scene, const BvhBuildOptions& topOptions) {
+    auto start = std::chrono::steady_clock::now();
+    size_t count = scene.instances.size();
+    for (size_t i = 0; i < count; ++i) {
+        if (scene.instances[i].mesh >= scene.meshes.size()) {
+            throw std::runtime_error("Failed to build instance BVH: instance " + std::to_string(i) + " refers to mesh " +
+                                     std::to_string(scene.instances[i].mesh) + " of " + std::to_string(scene.meshes.size()));
+        }
+    }
+
+    // copies of an empty mesh have no box (the inverted one of an empty tree would turn into
+    // NaN under the transform) and nothing to hit, so the top level leaves them out
+    std::vector<uint32_t> placed;
+    placed.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const Bvh& bvh = scene.meshes[scene.instances[i].mesh].bvh;
+        if (bvh.nodes.size() > 1 || bvh.nodes[0].count) placed.push_back(uint32_t(i));
+    }
+
+    scene.inverses.resize(count);
+    std::vector<float> boxes(6 * placed.size());
+    std::vector<uint8_t> singular(count);
+    parallelFor(0, count, [&](size_t i) {
+        singular[i] = !invertAffine(scene.instances[i].transform.data(), scene.inverses[i].data());
+    }, 1024);
+    parallelFor(0, placed.size(), [&](size_t i) {
+        const Instance& instance = scene.instances[placed[i]];
+        transformBox(instance.transform.data(), scene.meshes[instance.mesh].bvh.nodes[0], &boxes[6 * i]);
+    }, 1024);
+    auto bad = std::find(singular.begin(), singular.end(), 1);
+    if (bad != singular.end()) {
+        throw std::runtime_error("Failed to build instance BVH: the transform of instance " +
+                                 std::to_string(bad - singular.begin()) + " can't be inverted");
+    }
+
+    scene.top = buildBvh(boxes.data(), placed.size(), topOptions);
+    for (uint32_t& primitive : scene.top.primitives) primitive = placed[primitive];
+    scene.stats.topSeconds = secondsSince(start);
+
+    scene.stats.bytes = treeBytes(scene.top) + count * (sizeof(Instance) + sizeof(scene.inverses[0]));
+    for (const BottomLevel& mesh : scene.meshes) scene.stats.bytes += treeBytes(mesh.bvh);
+}
+
+bool intersect(const TwoLevelBvh& scene, const Ray& ray, InstanceHit& hit) {
+    const Bvh& top = scene.top;
+    bool found = false;
+    walkBvh(top.nodes.data(), ray, [&](const BvhNode& node, float& tMax) {
+        for (uint32_t i = node.first; i < node.first + node.count; ++i) {
+            uint32_t id = top.primitives[i];
+            const BottomLevel& mesh = scene.meshes[scene.instances[id].mesh];
+            // the direction isn't renormalised, so t is the same in both spaces and the
+            // closest hit so far bounds the object space ray as well
+            const float* m = scene.inverses[id].data();
+            Ray local;
+            for (int row = 0; row < 3; ++row) {
+                const float* r = m + 4 * row;
+                local.origin[row] = r[0] * ray.origin[0] + r[1] * ray.origin[1] + r[2] * ray.origin[2] + r[3];
+                local.direction[row] = r[0] * ray.direction[0] + r[1] * ray.direction[1] + r[2] * ray.direction[2];
+            }
+            local.tMin = ray.tMin;
+            local.tMax = tMax;
+            Hit objectHit;
+            if (intersect(mesh.bvh, mesh.geometry, local, objectHit)) {
+                tMax = objectHit.t;
+                static_cast<Hit&>(hit) = objectHit;
+                hit.instance = id;
+                found = true;
+            }
+        }
+        return false;
+    });
+    return found;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "Bvh.hpp"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Instancing for scenes made of many placed copies of a few meshes, like Metal's instance
+// acceleration structures over primitive ones. Every unique mesh gets one bottom-level tree
+// in its own object space, and a top-level tree over the world boxes of the instances picks
+// which copies a ray may hit. Rays are carried into object space per instance instead of the
+// triangles into world space, so memory grows with the unique meshes, not with the copies.
+
+// a placed copy of one of the meshes
+struct Instance {
+    std::array<float, 12> transform;  // row-major 3x4 object to world, as in ScatteredInstances
+    uint32_t mesh;                    // index into TwoLevelBvh::meshes
+};
+
+// one shared mesh, whose geometry the caller keeps alive
+struct BottomLevel {
+    TriangleGeometry geometry;
+    Bvh bvh;
+};
+
+struct TwoLevelBvhStats {
+    double seconds = 0.0;     // all bottom levels and the top level
+    double topSeconds = 0.0;  // the top level alone
+    size_t bytes = 0;         // trees and instances, without the meshes' own vertices and indices
+};
+
+struct TwoLevelBvh {
+    std::vector<BottomLevel> meshes;
+    std::vector<Instance> instances;
+    std::vector<std::array<float, 12>> inverses;  // world to object, per instance
+    Bvh top;  // over the instances' world boxes, primitives are instance indices
+    TwoLevelBvhStats stats;
+};
+
+// the closest hit also names the instance; `triangle` is the mesh's own triangle index
+struct InstanceHit : Hit {
+    uint32_t instance = UINT32_MAX;
+};
+
+// Builds a tree per mesh with `meshOptions` and the top level with `topOptions`. Throws
+// std::runtime_error for an instance of a mesh that doesn't exist or a transform that can't be
+// inverted.
+TwoLevelBvh buildTwoLevelBvh(const std::vector<TriangleGeometry>& meshes, const std::vector<Instance>& instances,
+                             const BvhBuildOptions& meshOptions = {}, const BvhBuildOptions& topOptions = {});
+// after instances were moved, added or removed: the meshes' trees are kept
+void rebuildTopLevel(TwoLevelBvh& scene, const BvhBuildOptions& topOptions = {});
+
+bool intersect(const TwoLevelBvh& scene, const Ray& ray, InstanceHit& hit);
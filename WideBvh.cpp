@@ -0,0 +1,622 @@
+#include "WideBvh.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#define COBALT_X86 1
+#endif
+
+namespace {
+
+const float inf = std::numeric_limits<float>::infinity();
+const uint32_t blockSize = 8;
+
+// one entry per level and pushed sibling is plenty: the binary tree is at most bvhMaxDepth deep
+const unsigned wideStackSize = bvhMaxDepth * 7 + 1;
+
+float area(const BvhNode& node) {
+    float dx = node.boundsMax[0] - node.boundsMin[0];
+    float dy = node.boundsMax[1] - node.boundsMin[1];
+    float dz = node.boundsMax[2] - node.boundsMin[2];
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+// Picks the children of every wide node from a binary tree and hands them to Output, which
+// owns the node layout: addNode() returns a new wide node, setChildren(wide, boxes, children,
+// used) fills its first `used` slots and clears the rest, and makeLeaf(first, count) stores a run
+// of bvh.primitives and returns its index, to which the leaf flag is added here.
+template <typename Output>
+class Collapser {
+public:
+    Collapser(const Bvh& bvh, Output& out) : bvh(bvh), out(out) {
+        // subtree triangle counts and where their runs start; children always come after
+        // their parent, so one backwards pass sees them first
+        size_t n = bvh.nodes.size();
+        count.resize(n);
+        first.resize(n);
+        for (size_t i = n; i-- > 0;) {
+            const BvhNode& node = bvh.nodes[i];
+            if (node.count || n == 1) {
+                count[i] = node.count;
+                first[i] = node.first;
+            } else {
+                count[i] = count[node.first] + count[node.first + 1];
+                first[i] = std::min(first[node.first], first[node.first + 1]);
+            }
+        }
+    }
+
+    void run() {
+        out.addNode();
+        if (count[0] <= blockSize) {
+            // the whole mesh fits one leaf, the root just points at it
+            const BvhNode* box = &bvh.nodes[0];
+            uint32_t child = count[0] ? wideLeafFlag | out.makeLeaf(first[0], count[0]) : wideEmptyChild;
+            out.setChildren(0, &box, &child, count[0] ? 1 : 0);
+            return;
+        }
+        std::vector<std::pair<uint32_t, uint32_t>> stack = {{0, 0}}; // binary node, wide node
+        while (!stack.empty()) {
+            auto [binary, wide] = stack.back();
+            stack.pop_back();
+
+            // open up the largest interior children until all eight slots are used
+            uint32_t slots[8] = {bvh.nodes[binary].first, bvh.nodes[binary].first + 1};
+            unsigned used = 2;
+            while (used < 8) {
+                int best = -1;
+                float bestArea = -1.0f;
+                for (unsigned s = 0; s < used; ++s) {
+                    if (count[slots[s]] <= blockSize) continue;
+                    float a = area(bvh.nodes[slots[s]]);
+                    if (a > bestArea) {
+                        bestArea = a;
+                        best = static_cast<int>(s);
+                    }
+                }
+                if (best < 0) break;
+                uint32_t opened = slots[best];
+                slots[best] = bvh.nodes[opened].first;
+                slots[used++] = bvh.nodes[opened].first + 1;
+            }
+
+            const BvhNode* boxes[8];
+            uint32_t children[8];
+            for (unsigned s = 0; s < used; ++s) {
+                boxes[s] = &bvh.nodes[slots[s]];
+                if (count[slots[s]] <= blockSize) {
+                    children[s] = wideLeafFlag | out.makeLeaf(first[slots[s]], count[slots[s]]);
+                } else {
+                    children[s] = out.addNode();
+                    stack.push_back({slots[s], children[s]});
+                }
+            }
+            out.setChildren(wide, boxes, children, used);
+        }
+    }
+
+private:
+    const Bvh& bvh;
+    Output& out;
+    std::vector<uint32_t> count, first;
+};
+
+// float boxes and triangle blocks
+struct WideOutput {
+    const Bvh& bvh;
+    const TriangleGeometry& geometry;
+    WideBvh& wide;
+
+    uint32_t addNode() {
+        wide.nodes.emplace_back();
+        return static_cast<uint32_t>(wide.nodes.size() - 1);
+    }
+
+    void setChildren(uint32_t index, const BvhNode* const* boxes, const uint32_t* children, unsigned used) {
+        WideBvhNode& node = wide.nodes[index];
+        for (unsigned s = 0; s < 8; ++s) {
+            if (s < used) {
+                node.minX[s] = boxes[s]->boundsMin[0];
+                node.minY[s] = boxes[s]->boundsMin[1];
+                node.minZ[s] = boxes[s]->boundsMin[2];
+                node.maxX[s] = boxes[s]->boundsMax[0];
+                node.maxY[s] = boxes[s]->boundsMax[1];
+                node.maxZ[s] = boxes[s]->boundsMax[2];
+                node.child[s] = children[s];
+            } else {
+                node.minX[s] = node.minY[s] = node.minZ[s] = inf;
+                node.maxX[s] = node.maxY[s] = node.maxZ[s] = -inf;
+                node.child[s] = wideEmptyChild;
+            }
+        }
+    }
+
+    uint32_t makeLeaf(uint32_t first, uint32_t count) {
+        TriangleBlock block = {};
+        for (uint32_t lane = 0; lane < blockSize; ++lane) block.triangle[lane] = UINT32_MAX;
+        for (uint32_t lane = 0; lane < count; ++lane) {
+            uint32_t triangle = bvh.primitives[first + lane];
+            const uint32_t* tri = &geometry.indices[3 * triangle];
+            const float* a = geometry.vertex(tri[0]);
+            const float* b = geometry.vertex(tri[1]);
+            const float* c = geometry.vertex(tri[2]);
+            block.v0x[lane] = a[0];
+            block.v0y[lane] = a[1];
+            block.v0z[lane] = a[2];
+            block.e1x[lane] = b[0] - a[0];
+            block.e1y[lane] = b[1] - a[1];
+            block.e1z[lane] = b[2] - a[2];
+            block.e2x[lane] = c[0] - a[0];
+            block.e2y[lane] = c[1] - a[1];
+            block.e2z[lane] = c[2] - a[2];
+            block.triangle[lane] = triangle;
+        }
+        wide.blocks.push_back(block);
+        return static_cast<uint32_t>(wide.blocks.size() - 1);
+    }
+};
+
+// grid steps are powers of two, so q * step is exact and only origin + q * step rounds
+inline float gridStep(int exponent) {
+    uint32_t bits = static_cast<uint32_t>(exponent + 127) << 23;
+    float step;
+    std::memcpy(&step, &bits, sizeof(step));
+    return step;
+}
+
+// the smallest exponent whose 255 steps from lo reach hi
+int gridExponent(float lo, float hi) {
+    if (!(hi > lo)) return -126;
+    int exponent;
+    std::frexp((hi - lo) / 255.0f, &exponent);
+    exponent = std::max(exponent, -126);
+    while (exponent < 127 && lo + 255.0f * gridStep(exponent) < hi) exponent++;
+    return exponent;
+}
+
+// 8-bit boxes on a per-node grid, leaves are runs of bvh.primitives
+struct QuantizedOutput {
+    QuantizedBvh& quantized;
+    size_t leaves = 0;
+
+    uint32_t addNode() {
+        quantized.nodes.emplace_back();
+        return static_cast<uint32_t>(quantized.nodes.size() - 1);
+    }
+
+    void setChildren(uint32_t index, const BvhNode* const* boxes, const uint32_t* children, unsigned used) {
+        QuantizedBvhNode& node = quantized.nodes[index];
+        node = {};
+        for (int k = 0; k < 3; ++k) {
+            float lo = inf, hi = -inf;
+            for (unsigned s = 0; s < used; ++s) {
+                lo = std::min(lo, boxes[s]->boundsMin[k]);
+                hi = std::max(hi, boxes[s]->boundsMax[k]);
+            }
+            if (used == 0) lo = hi = 0.0f;
+            int exponent = gridExponent(lo, hi);
+            node.origin[k] = lo;
+            node.exponent[k] = static_cast<int8_t>(exponent);
+
+            // round outwards, checking against the decoded bounds so rounding never shrinks a box
+            float step = gridStep(exponent);
+            uint8_t* qmin = k == 0 ? node.minX : k == 1 ? node.minY : node.minZ;
+            uint8_t* qmax = k == 0 ? node.maxX : k == 1 ? node.maxY : node.maxZ;
+            for (unsigned s = 0; s < 8; ++s) {
+                if (s >= used) {
+                    // inverted, so no ray enters it
+                    qmin[s] = 255;
+                    qmax[s] = 0;
+                    continue;
+                }
+                float a = boxes[s]->boundsMin[k], b = boxes[s]->boundsMax[k];
+                int q0 = std::clamp(static_cast<int>(std::floor((a - lo) / step)), 0, 255);
+                while (q0 > 0 && lo + q0 * step > a) q0--;
+                int q1 = std::clamp(static_cast<int>(std::ceil((b - lo) / step)), 0, 255);
+                while (q1 < 255 && lo + q1 * step < b) q1++;
+                qmin[s] = static_cast<uint8_t>(q0);
+                qmax[s] = static_cast<uint8_t>(q1);
+            }
+        }
+        for (unsigned s = 0; s < 8; ++s) node.child[s] = s < used ? children[s] : wideEmptyChild;
+    }
+
+    uint32_t makeLeaf(uint32_t first, uint32_t count) {
+        leaves++;
+        return first << 3 | (count - 1);
+    }
+};
+
+// 1/d without infinities, so origin * inverse stays finite for axis-parallel rays
+inline float safeInverse(float d) {
+    return 1.0f / (std::fabs(d) > 1e-30f ? d : std::copysign(1e-30f, d));
+}
+
+struct StackEntry {
+    uint32_t child;
+    float t;
+};
+
+// pushes the children that were hit, farthest first so the nearest comes off next
+inline void pushOrdered(StackEntry* stack, unsigned& size, const uint32_t* children, unsigned mask, const float* tNear) {
+    StackEntry hits[8];
+    unsigned count = 0;
+    while (mask) {
+        unsigned s = static_cast<unsigned>(__builtin_ctz(mask));
+        mask &= mask - 1;
+        StackEntry entry = {children[s], tNear[s]};
+        unsigned i = count++;
+        while (i > 0 && hits[i - 1].t < entry.t) {
+            hits[i] = hits[i - 1];
+            --i;
+        }
+        hits[i] = entry;
+    }
+    for (unsigned i = 0; i < count; ++i) stack[size++] = hits[i];
+}
+
+bool intersectScalar(const WideBvh& bvh, const Ray& ray, Hit& hit) {
+    float inverse[3], scaledOrigin[3];
+    for (int k = 0; k < 3; ++k) {
+        inverse[k] = safeInverse(ray.direction[k]);
+        scaledOrigin[k] = ray.origin[k] * inverse[k];
+    }
+    float tMax = ray.tMax;
+    bool found = false;
+
+    StackEntry stack[wideStackSize];
+    unsigned size = 0;
+    stack[size++] = {0, ray.tMin};
+    while (size > 0) {
+        StackEntry entry = stack[--size];
+        if (entry.t > tMax) continue;
+
+        if (entry.child & wideLeafFlag) {
+            const TriangleBlock& block = bvh.blocks[entry.child & ~wideLeafFlag];
+            for (uint32_t lane = 0; lane < blockSize; ++lane) {
+                float a[3] = {block.v0x[lane], block.v0y[lane], block.v0z[lane]};
+                float b[3] = {a[0] + block.e1x[lane], a[1] + block.e1y[lane], a[2] + block.e1z[lane]};
+                float c[3] = {a[0] + block.e2x[lane], a[1] + block.e2y[lane], a[2] + block.e2z[lane]};
+                float t, u, v;
+                if (block.triangle[lane] != UINT32_MAX && intersectTriangle(a, b, c, ray, tMax, t, u, v)) {
+                    tMax = t;
+                    hit = {t, block.triangle[lane], u, v};
+                    found = true;
+                }
+            }
+            continue;
+        }
+
+        // near and far planes picked by the direction's sign rather than by min/max, so the
+        // inverted boxes of empty slots stay empty
+        const WideBvhNode& node = bvh.nodes[entry.child];
+        const float* lo[3] = {node.minX, node.minY, node.minZ};
+        const float* hi[3] = {node.maxX, node.maxY, node.maxZ};
+        float tNear[8];
+        unsigned mask = 0;
+        for (unsigned s = 0; s < 8; ++s) {
+            float t0 = ray.tMin, t1 = tMax;
+            for (int k = 0; k < 3; ++k) {
+                bool flip = inverse[k] < 0.0f;
+                t0 = std::max(t0, (flip ? hi : lo)[k][s] * inverse[k] - scaledOrigin[k]);
+                t1 = std::min(t1, (flip ? lo : hi)[k][s] * inverse[k] - scaledOrigin[k]);
+            }
+            tNear[s] = t0;
+            if (t0 <= t1) mask |= 1u << s;
+        }
+        pushOrdered(stack, size, node.child, mask, tNear);
+    }
+    return found;
+}
+
+// closest hit in a leaf run of a quantized tree
+inline bool intersectRun(const QuantizedBvh& bvh, const TriangleGeometry& geometry, uint32_t child, const Ray& ray,
+                         float& tMax, Hit& hit) {
+    uint32_t first = (child & ~wideLeafFlag) >> 3;
+    uint32_t count = (child & 7) + 1;
+    bool found = false;
+    for (uint32_t i = first; i < first + count; ++i) {
+        uint32_t triangle = bvh.primitives[i];
+        const uint32_t* tri = &geometry.indices[3 * triangle];
+        float t, u, v;
+        if (intersectTriangle(geometry.vertex(tri[0]), geometry.vertex(tri[1]), geometry.vertex(tri[2]), ray, tMax, t, u, v)) {
+            tMax = t;
+            hit = {t, triangle, u, v};
+            found = true;
+        }
+    }
+    return found;
+}
+
+// the box planes are origin + q * step, so along the ray t = q * (step / d) + (origin - o) / d
+bool intersectQuantizedScalar(const QuantizedBvh& bvh, const TriangleGeometry& geometry, const Ray& ray, Hit& hit) {
+    float inverse[3];
+    for (int k = 0; k < 3; ++k) inverse[k] = safeInverse(ray.direction[k]);
+    float tMax = ray.tMax;
+    bool found = false;
+
+    StackEntry stack[wideStackSize];
+    unsigned size = 0;
+    stack[size++] = {0, ray.tMin};
+    while (size > 0) {
+        StackEntry entry = stack[--size];
+        if (entry.t > tMax) continue;
+
+        if (entry.child & wideLeafFlag) {
+            found |= intersectRun(bvh, geometry, entry.child, ray, tMax, hit);
+            continue;
+        }
+
+        const QuantizedBvhNode& node = bvh.nodes[entry.child];
+        const uint8_t* lo[3] = {node.minX, node.minY, node.minZ};
+        const uint8_t* hi[3] = {node.maxX, node.maxY, node.maxZ};
+        float scale[3], offset[3];
+        for (int k = 0; k < 3; ++k) {
+            scale[k] = gridStep(node.exponent[k]) * inverse[k];
+            offset[k] = (node.origin[k] - ray.origin[k]) * inverse[k];
+        }
+        float tNear[8];
+        unsigned mask = 0;
+        for (unsigned s = 0; s < 8; ++s) {
+            float t0 = ray.tMin, t1 = tMax;
+            for (int k = 0; k < 3; ++k) {
+                bool flip = inverse[k] < 0.0f;
+                t0 = std::max(t0, (flip ? hi : lo)[k][s] * scale[k] + offset[k]);
+                t1 = std::min(t1, (flip ? lo : hi)[k][s] * scale[k] + offset[k]);
+            }
+            tNear[s] = t0;
+            if (t0 <= t1) mask |= 1u << s;
+        }
+        pushOrdered(stack, size, node.child, mask, tNear);
+    }
+    return found;
+}
+
+#if COBALT_X86
+
+// a * b - c * d
+__attribute__((target("avx2,fma")))
+inline __m256 differenceOfProducts(__m256 a, __m256 b, __m256 c, __m256 d) {
+    return _mm256_sub_ps(_mm256_mul_ps(a, b), _mm256_mul_ps(c, d));
+}
+
+// (ax * bx + ay * by) + az * bz
+__attribute__((target("avx2,fma")))
+inline __m256 dot(__m256 ax, __m256 ay, __m256 az, __m256 bx, __m256 by, __m256 bz) {
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(ax, bx), _mm256_mul_ps(ay, by)), _mm256_mul_ps(az, bz));
+}
+
+__attribute__((target("avx2,fma")))
+bool intersectAvx2(const WideBvh& bvh, const Ray& ray, Hit& hit) {
+    float inverse[3];
+    for (int k = 0; k < 3; ++k) inverse[k] = safeInverse(ray.direction[k]);
+    const __m256 ix = _mm256_set1_ps(inverse[0]), iy = _mm256_set1_ps(inverse[1]), iz = _mm256_set1_ps(inverse[2]);
+    const __m256 oix = _mm256_set1_ps(ray.origin[0] * inverse[0]);
+    const __m256 oiy = _mm256_set1_ps(ray.origin[1] * inverse[1]);
+    const __m256 oiz = _mm256_set1_ps(ray.origin[2] * inverse[2]);
+    const __m256 ox = _mm256_set1_ps(ray.origin[0]), oy = _mm256_set1_ps(ray.origin[1]), oz = _mm256_set1_ps(ray.origin[2]);
+    const __m256 dx = _mm256_set1_ps(ray.direction[0]), dy = _mm256_set1_ps(ray.direction[1]), dz = _mm256_set1_ps(ray.direction[2]);
+    const __m256 tMinV = _mm256_set1_ps(ray.tMin);
+    const __m256 zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f);
+
+    // the near plane per axis only depends on the direction's sign
+    const bool flipX = inverse[0] < 0.0f, flipY = inverse[1] < 0.0f, flipZ = inverse[2] < 0.0f;
+
+    float tMax = ray.tMax;
+    bool found = false;
+    StackEntry stack[wideStackSize];
+    unsigned size = 0;
+    stack[size++] = {0, ray.tMin};
+    while (size > 0) {
+        StackEntry entry = stack[--size];
+        if (entry.t > tMax) continue;
+        const __m256 tMaxV = _mm256_set1_ps(tMax);
+
+        if (entry.child & wideLeafFlag) {
+            const TriangleBlock& b = bvh.blocks[entry.child & ~wideLeafFlag];
+            __m256 e1x = _mm256_load_ps(b.e1x), e1y = _mm256_load_ps(b.e1y), e1z = _mm256_load_ps(b.e1z);
+            __m256 e2x = _mm256_load_ps(b.e2x), e2y = _mm256_load_ps(b.e2y), e2z = _mm256_load_ps(b.e2z);
+            // p = d x e2, det = e1 . p. Separate multiplies and adds in intersectTriangle's order:
+            // fused ones round differently and move hits across triangle edges
+            __m256 px = differenceOfProducts(dy, e2z, dz, e2y);
+            __m256 py = differenceOfProducts(dz, e2x, dx, e2z);
+            __m256 pz = differenceOfProducts(dx, e2y, dy, e2x);
+            __m256 det = dot(e1x, e1y, e1z, px, py, pz);
+            __m256 inv = _mm256_div_ps(one, det);
+            // s = o - v0, u = (s . p) / det
+            __m256 sx = _mm256_sub_ps(ox, _mm256_load_ps(b.v0x));
+            __m256 sy = _mm256_sub_ps(oy, _mm256_load_ps(b.v0y));
+            __m256 sz = _mm256_sub_ps(oz, _mm256_load_ps(b.v0z));
+            __m256 u = _mm256_mul_ps(dot(sx, sy, sz, px, py, pz), inv);
+            // q = s x e1, v = (d . q) / det, t = (e2 . q) / det
+            __m256 qx = differenceOfProducts(sy, e1z, sz, e1y);
+            __m256 qy = differenceOfProducts(sz, e1x, sx, e1z);
+            __m256 qz = differenceOfProducts(sx, e1y, sy, e1x);
+            __m256 v = _mm256_mul_ps(dot(dx, dy, dz, qx, qy, qz), inv);
+            __m256 t = _mm256_mul_ps(dot(e2x, e2y, e2z, qx, qy, qz), inv);
+
+            __m256 valid = _mm256_cmp_ps(det, zero, _CMP_NEQ_OQ);
+            valid = _mm256_and_ps(valid, _mm256_cmp_ps(u, zero, _CMP_GE_OQ));
+            valid = _mm256_and_ps(valid, _mm256_cmp_ps(v, zero, _CMP_GE_OQ));
+            valid = _mm256_and_ps(valid, _mm256_cmp_ps(_mm256_add_ps(u, v), one, _CMP_LE_OQ));
+            valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, tMinV, _CMP_GT_OQ));
+            valid = _mm256_and_ps(valid, _mm256_cmp_ps(t, tMaxV, _CMP_LT_OQ));
+            unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(valid));
+            if (mask) {
+                alignas(32) float ts[8], us[8], vs[8];
+                _mm256_store_ps(ts, t);
+                _mm256_store_ps(us, u);
+                _mm256_store_ps(vs, v);
+                while (mask) {
+                    unsigned lane = static_cast<unsigned>(__builtin_ctz(mask));
+                    mask &= mask - 1;
+                    if (ts[lane] < tMax) {
+                        tMax = ts[lane];
+                        hit = {ts[lane], b.triangle[lane], us[lane], vs[lane]};
+                        found = true;
+                    }
+                }
+            }
+            continue;
+        }
+
+        const WideBvhNode& node = bvh.nodes[entry.child];
+        __m256 nearX = _mm256_fmsub_ps(_mm256_load_ps(flipX ? node.maxX : node.minX), ix, oix);
+        __m256 nearY = _mm256_fmsub_ps(_mm256_load_ps(flipY ? node.maxY : node.minY), iy, oiy);
+        __m256 nearZ = _mm256_fmsub_ps(_mm256_load_ps(flipZ ? node.maxZ : node.minZ), iz, oiz);
+        __m256 farX = _mm256_fmsub_ps(_mm256_load_ps(flipX ? node.minX : node.maxX), ix, oix);
+        __m256 farY = _mm256_fmsub_ps(_mm256_load_ps(flipY ? node.minY : node.maxY), iy, oiy);
+        __m256 farZ = _mm256_fmsub_ps(_mm256_load_ps(flipZ ? node.minZ : node.maxZ), iz, oiz);
+        __m256 tNear = _mm256_max_ps(_mm256_max_ps(nearX, nearY), _mm256_max_ps(nearZ, tMinV));
+        __m256 tFar = _mm256_min_ps(_mm256_min_ps(farX, farY), _mm256_min_ps(farZ, tMaxV));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ)));
+        if (!mask) continue;
+        alignas(32) float near[8];
+        _mm256_store_ps(near, tNear);
+        pushOrdered(stack, size, node.child, mask, near);
+    }
+    return found;
+}
+
+__attribute__((target("avx2,fma")))
+inline __m256 loadGrid(const uint8_t* q) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(q))));
+}
+
+__attribute__((target("avx2,fma")))
+bool intersectQuantizedAvx2(const QuantizedBvh& bvh, const TriangleGeometry& geometry, const Ray& ray, Hit& hit) {
+    float inverse[3];
+    for (int k = 0; k < 3; ++k) inverse[k] = safeInverse(ray.direction[k]);
+    const __m256 tMinV = _mm256_set1_ps(ray.tMin);
+    const bool flipX = inverse[0] < 0.0f, flipY = inverse[1] < 0.0f, flipZ = inverse[2] < 0.0f;
+
+    float tMax = ray.tMax;
+    bool found = false;
+    StackEntry stack[wideStackSize];
+    unsigned size = 0;
+    stack[size++] = {0, ray.tMin};
+    while (size > 0) {
+        StackEntry entry = stack[--size];
+        if (entry.t > tMax) continue;
+
+        if (entry.child & wideLeafFlag) {
+            found |= intersectRun(bvh, geometry, entry.child, ray, tMax, hit);
+            continue;
+        }
+
+        const QuantizedBvhNode& node = bvh.nodes[entry.child];
+        __m256 sx = _mm256_set1_ps(gridStep(node.exponent[0]) * inverse[0]);
+        __m256 sy = _mm256_set1_ps(gridStep(node.exponent[1]) * inverse[1]);
+        __m256 sz = _mm256_set1_ps(gridStep(node.exponent[2]) * inverse[2]);
+        __m256 ox = _mm256_set1_ps((node.origin[0] - ray.origin[0]) * inverse[0]);
+        __m256 oy = _mm256_set1_ps((node.origin[1] - ray.origin[1]) * inverse[1]);
+        __m256 oz = _mm256_set1_ps((node.origin[2] - ray.origin[2]) * inverse[2]);
+        __m256 nearX = _mm256_fmadd_ps(loadGrid(flipX ? node.maxX : node.minX), sx, ox);
+        __m256 nearY = _mm256_fmadd_ps(loadGrid(flipY ? node.maxY : node.minY), sy, oy);
+        __m256 nearZ = _mm256_fmadd_ps(loadGrid(flipZ ? node.maxZ : node.minZ), sz, oz);
+        __m256 farX = _mm256_fmadd_ps(loadGrid(flipX ? node.minX : node.maxX), sx, ox);
+        __m256 farY = _mm256_fmadd_ps(loadGrid(flipY ? node.minY : node.maxY), sy, oy);
+        __m256 farZ = _mm256_fmadd_ps(loadGrid(flipZ ? node.minZ : node.maxZ), sz, oz);
+        __m256 tNear = _mm256_max_ps(_mm256_max_ps(nearX, nearY), _mm256_max_ps(nearZ, tMinV));
+        __m256 tFar = _mm256_min_ps(_mm256_min_ps(farX, farY), _mm256_min_ps(farZ, _mm256_set1_ps(tMax)));
+        unsigned mask = static_cast<unsigned>(_mm256_movemask_ps(_mm256_cmp_ps(tNear, tFar, _CMP_LE_OQ)));
+        if (!mask) continue;
+        alignas(32) float near[8];
+        _mm256_store_ps(near, tNear);
+        pushOrdered(stack, size, node.child, mask, near);
+    }
+    return found;
+}
+
+#endif
+
+}
+
+WideBvh collapseBvh(const Bvh& bvh, const TriangleGeometry& geometry) {
+    auto start = std::chrono::steady_clock::now();
+    WideBvh wide;
+    WideOutput output = {bvh, geometry, wide};
+    Collapser<WideOutput>(bvh, output).run();
+
+    WideBvhStats& stats = wide.stats;
+    stats.collapseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.seconds = bvh.stats.seconds + stats.collapseSeconds;
+    stats.nodes = wide.nodes.size();
+    stats.blocks = wide.blocks.size();
+    stats.blockFill = stats.blocks ? static_cast<double>(geometry.triangleCount) / stats.blocks : 0.0;
+    stats.bytes = wide.nodes.size() * sizeof(WideBvhNode) + wide.blocks.size() * sizeof(TriangleBlock);
+    return wide;
+}
+
+QuantizedBvh quantizeBvh(const Bvh& bvh) {
+    if (bvh.primitives.size() >= quantizedMaxTriangles) {
+        throw std::runtime_error("Failed to quantize BVH: " + std::to_string(bvh.primitives.size()) + " triangles is too many");
+    }
+    auto start = std::chrono::steady_clock::now();
+    QuantizedBvh quantized;
+    quantized.primitives = bvh.primitives;
+    QuantizedOutput output = {quantized};
+    Collapser<QuantizedOutput>(bvh, output).run();
+
+    WideBvhStats& stats = quantized.stats;
+    stats.collapseSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stats.seconds = bvh.stats.seconds + stats.collapseSeconds;
+    stats.nodes = quantized.nodes.size();
+    stats.blocks = output.leaves;
+    stats.blockFill = stats.blocks ? static_cast<double>(quantized.primitives.size()) / stats.blocks : 0.0;
+    stats.bytes = quantized.nodes.size() * sizeof(QuantizedBvhNode) + quantized.primitives.size() * sizeof(uint32_t);
+    return quantized;
+}
+
+QuantizedBvh buildQuantizedBvh(const TriangleGeometry& geometry, const BvhBuildOptions& options) {
+    BvhBuildOptions binary = options;
+    binary.maxLeafSize = std::min(binary.maxLeafSize, blockSize);
+    return quantizeBvh(buildBvh(geometry, binary));
+}
+
+WideBvh buildWideBvh(const TriangleGeometry& geometry, const BvhBuildOptions& options) {
+    BvhBuildOptions binary = options;
+    binary.maxLeafSize = std::min(binary.maxLeafSize, blockSize);
+    return collapseBvh(buildBvh(geometry, binary), geometry);
+}
+
+SimdLevel detectSimdLevel() {
+#if COBALT_X86
+    static const SimdLevel level = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma") ? SimdLevel::Avx2 : SimdLevel::Scalar;
+    return level;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+const char* simdLevelName(SimdLevel level) {
+    return level == SimdLevel::Avx2 ? "avx2" : "scalar";
+}
+
+bool intersect(const WideBvh& bvh, const Ray& ray, Hit& hit) {
+    return intersect(bvh, ray, hit, detectSimdLevel());
+}
+
+bool intersect(const WideBvh& bvh, const Ray& ray, Hit& hit, SimdLevel level) {
+#if COBALT_X86
+    if (level == SimdLevel::Avx2) return intersectAvx2(bvh, ray, hit);
+#endif
+    return intersectScalar(bvh, ray, hit);
+}
+
+bool intersect(const QuantizedBvh& bvh, const TriangleGeometry& geometry, const Ray& ray, Hit& hit) {
+    return intersect(bvh, geometry, ray, hit, detectSimdLevel());
+}
+
+bool intersect(const QuantizedBvh& bvh, const TriangleGeometry& geometry, const Ray& ray, Hit& hit, SimdLevel level) {
+#if COBALT_X86
+    if (level == SimdLevel::Avx2) return intersectQuantizedAvx2(bvh, geometry, ray, hit);
+#endif
+    return intersectQuantizedScalar(bvh, geometry, ray, hit);
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "Bvh.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// 8-wide BVH for CPU tracing. A node holds the boxes of up to eight children as SoA float
+// arrays, so one ray is tested against all of them in a single AVX2 pass. Leaves are blocks of
+// up to eight triangles stored as vertex and two edges, SoA again, for an 8-wide Möller-Trumbore.
+// The tree is collapsed from a binary SAH build; subtrees of eight or fewer triangles become
+// one block.
+
+const uint32_t wideLeafFlag = 0x80000000u;   // child refers to a TriangleBlock
+const uint32_t wideEmptyChild = 0xFFFFFFFFu; // unused slot, its box is empty
+
+struct alignas(32) WideBvhNode {
+    float minX[8], minY[8], minZ[8];
+    float maxX[8], maxY[8], maxZ[8];
+    uint32_t child[8];  // node index, wideLeafFlag | block index, or wideEmptyChild
+};
+
+struct alignas(32) TriangleBlock {
+    float v0x[8], v0y[8], v0z[8];
+    float e1x[8], e1y[8], e1z[8];  // v1 - v0
+    float e2x[8], e2y[8], e2z[8];  // v2 - v0
+    uint32_t triangle[8];          // UINT32_MAX in unused lanes, whose edges are zero
+};
+
+struct WideBvhStats {
+    double seconds = 0.0;  // binary build plus collapse
+    double collapseSeconds = 0.0;
+    size_t nodes = 0;
+    size_t blocks = 0;
+    double blockFill = 0.0;  // average used lanes per block, out of 8
+    size_t bytes = 0;
+};
+
+struct WideBvh {
+    std::vector<WideBvhNode> nodes;  // root first, always an interior node
+    std::vector<TriangleBlock> blocks;
+    WideBvhStats stats;
+};
+
+WideBvh buildWideBvh(const TriangleGeometry& geometry, const BvhBuildOptions& options = {});
+// `bvh` must have been built from `geometry` with a maxLeafSize of at most 8
+WideBvh collapseBvh(const Bvh& bvh, const TriangleGeometry& geometry);
+
+// the traversal kernels. AVX2 needs AVX2 and FMA, checked with CPUID at runtime, so the build
+// doesn't need -mavx2 and the same binary runs on older x86 and on ARM. FMA is only used for
+// the box tests: the triangle test rounds after every operation like intersectTriangle, and
+// the build keeps the compiler from fusing them, so both kernels find the same triangles
+enum class SimdLevel { Scalar, Avx2 };
+
+SimdLevel detectSimdLevel();
+const char* simdLevelName(SimdLevel level);
+
+// closest hit with the best kernel for this CPU
+bool intersect(const WideBvh& bvh, const Ray& ray, Hit& hit);
+// closest hit with a given kernel, which must not be above detectSimdLevel()
+bool intersect(const WideBvh& bvh, const Ray& ray, Hit& hit, SimdLevel level);
+
+// Compressed 8-wide BVH for scenes whose float trees don't fit in memory next to the mesh.
+// Child boxes are 8-bit offsets on a per-node grid whose step is a power of two per axis, so
+// decoding is exact and the quantized boxes are rounded outwards to always contain the real
+// ones. Leaves are runs of at most eight entries in `primitives`, tested against the mesh's own
+// vertices, so nothing but the tree and one index per triangle is stored.
+struct alignas(32) QuantizedBvhNode {
+    float origin[3];     // lower corner of the grid
+    int8_t exponent[3];  // grid step per axis is 2^exponent
+    uint8_t padding;
+    uint8_t minX[8], minY[8], minZ[8];  // child box in grid steps from origin
+    uint8_t maxX[8], maxY[8], maxZ[8];
+    uint32_t child[8];  // node index, wideLeafFlag | first << 3 | (count - 1), or wideEmptyChild
+};
+
+// leaf runs start at most this many primitives in
+const uint32_t quantizedMaxTriangles = 1u << 28;
+
+struct QuantizedBvh {
+    std::vector<QuantizedBvhNode> nodes;  // root first, always an interior node
+    std::vector<uint32_t> primitives;     // triangle indices
+    WideBvhStats stats;                   // blocks counts leaf runs
+};
+
+// `bvh` must have leaves of at most 8 triangles and fewer than quantizedMaxTriangles entries
+QuantizedBvh quantizeBvh(const Bvh& bvh);
+QuantizedBvh buildQuantizedBvh(const TriangleGeometry& geometry, const BvhBuildOptions& options = {});
+
+bool intersect(const QuantizedBvh& bvh, const TriangleGeometry& geometry, const Ray& ray, Hit& hit);
+bool intersect(const QuantizedBvh& bvh, const TriangleGeometry& geometry, const Ray& ray, Hit& hit, SimdLevel level);
@@ -0,0 +1,1089 @@
+// cobalt-bench: standalone benchmarks for the portable (non-Metal) parts of cobalt.
+// usage: cobalt-bench <benchmark> [args...], run without arguments for the list.
+// where a benchmark takes a mesh, scene:kind[:triangles[:seed]] generates one instead, see SceneGenerator.hpp.
+
+#include "tiny_obj_loader.h"
+
+#include "Bvh.hpp"
+#include "BvhCache.hpp"
+#include "BvhStats.hpp"
+#include "BvhRefit.hpp"
+#include "CpuRenderer.hpp"
+#include "Lbvh.hpp"
+#include "MeshCache.hpp"
+#include "MeshLoader.hpp"
+#include "MeshSimplifier.hpp"
+#include "NormalPacking.hpp"
+#include "Parallel.hpp"
+#include "SceneGenerator.hpp"
+#include "TwoLevelBvh.hpp"
+#include "WideBvh.hpp"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// a set of whitespace separated number tokens, as they appear in v/vn/vt records
+struct NumberSet {
+    std::string name;
+    std::string text;
+    std::vector<std::pair<size_t, size_t>> tokens; // offset, length
+};
+
+void addToken(NumberSet& set, const char* token) {
+    set.tokens.push_back({set.text.size(), std::strlen(token)});
+    set.text += token;
+    set.text += ' ';
+}
+
+// number formats written by the exporters and scanners our meshes come from
+std::vector<NumberSet> makeNumberSets(size_t count) {
+    std::mt19937 rng(1234);
+    std::uniform_real_distribution<double> unit(-1.0, 1.0);
+    std::uniform_real_distribution<double> texcoord(0.0, 1.0);
+    std::uniform_real_distribution<double> scan(-250.0, 250.0);
+    std::uniform_int_distribution<int> decade(-7, 2);
+
+    std::vector<NumberSet> sets(5);
+    sets[0].name = "%f positions (blender, meshlab)";
+    sets[1].name = "%.4f texcoords";
+    sets[2].name = "%g scanner output";
+    sets[3].name = "%.9g round-trip floats";
+    sets[4].name = "%e scientific";
+
+    char token[64];
+    for (size_t i = 0; i < count; ++i) {
+        std::snprintf(token, sizeof(token), "%f", unit(rng));
+        addToken(sets[0], token);
+        std::snprintf(token, sizeof(token), "%.4f", texcoord(rng));
+        addToken(sets[1], token);
+        std::snprintf(token, sizeof(token), "%g", scan(rng) * std::pow(10.0, decade(rng)));
+        addToken(sets[2], token);
+        std::snprintf(token, sizeof(token), "%.9g", static_cast<float>(scan(rng)));
+        addToken(sets[3], token);
+        std::snprintf(token, sizeof(token), "%e", unit(rng) * std::pow(10.0, decade(rng)));
+        addToken(sets[4], token);
+    }
+    return sets;
+}
+
+// pulls the numbers out of the v/vn/vt records of a real OBJ
+NumberSet readNumberSet(const std::string& path) {
+    NumberSet set;
+    set.name = path;
+    std::ifstream file(path);
+    std::string line;
+    while (std::getline(file, line)) {
+        if (line.size() < 2 || line[0] != 'v') continue;
+        const char* p = line.c_str() + 1;
+        if (*p == 'n' || *p == 't') ++p;
+        std::string word;
+        std::istringstream words(p);
+        while (words >> word) addToken(set, word.c_str());
+    }
+    return set;
+}
+
+int benchFloats(int argc, char** argv) {
+    std::vector<NumberSet> sets;
+    if (argc > 0) {
+        sets.push_back(readNumberSet(argv[0]));
+    } else {
+        sets = makeNumberSets(1 << 20);
+    }
+
+    std::printf("%-34s %12s %12s %8s %10s\n", "distribution", "reference", "fast", "speedup", "mismatch");
+    for (const NumberSet& set : sets) {
+        const char* text = set.text.data();
+        std::vector<float> reference(set.tokens.size()), fast(set.tokens.size());
+
+        auto run = [&](bool useReference, std::vector<float>& out) {
+            double best = 1e30;
+            for (int repeat = 0; repeat < 5; ++repeat) {
+                auto start = std::chrono::steady_clock::now();
+                for (size_t i = 0; i < set.tokens.size(); ++i) {
+                    const char* s = text + set.tokens[i].first;
+                    double value = 0.0;
+                    tinyobj::ParseDouble(s, s + set.tokens[i].second, &value, useReference);
+                    out[i] = static_cast<tinyobj::real_t>(value);
+                }
+                best = std::min(best, secondsSince(start));
+            }
+            return best;
+        };
+
+        double fastTime = run(false, fast);
+        double referenceTime = run(true, reference);
+
+        // bit-exact at the precision the loader stores
+        size_t mismatches = 0;
+        for (size_t i = 0; i < set.tokens.size(); ++i) {
+            if (std::memcmp(&reference[i], &fast[i], sizeof(float)) != 0) mismatches++;
+        }
+
+        double count = static_cast<double>(set.tokens.size());
+        std::printf("%-34s %9.2f ns %9.2f ns %7.2fx %10zu\n", set.name.c_str(),
+                    referenceTime / count * 1e9, fastTime / count * 1e9, referenceTime / fastTime, mismatches);
+    }
+    return 0;
+}
+
+// the loader main.cpp used to have: tinyobj::LoadObj, then a per-element copy into Mesh
+Mesh loadOBJLegacy(const std::string& filepath, float scale) {
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn, err;
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str())) {
+        throw std::runtime_error("Failed to load OBJ file: " + err);
+    }
+
+    Mesh mesh;
+    for (const auto& shape : shapes) {
+        size_t indexOffset = 0;
+        for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); ++f) {
+            int faceVertices = shape.mesh.num_face_vertices[f];
+            for (int v = 0; v < faceVertices; ++v) {
+                tinyobj::index_t idx = shape.mesh.indices[indexOffset + v];
+                if (idx.vertex_index >= 0) {
+                    for (int k = 0; k < 3; ++k) mesh.vertices.push_back(scale * attrib.vertices[3 * idx.vertex_index + k]);
+                }
+                if (idx.normal_index >= 0) {
+                    for (int k = 0; k < 3; ++k) mesh.normals.push_back(attrib.normals[3 * idx.normal_index + k]);
+                }
+                if (idx.texcoord_index >= 0) {
+                    for (int k = 0; k < 2; ++k) mesh.texcoords.push_back(attrib.texcoords[2 * idx.texcoord_index + k]);
+                }
+                mesh.indices.push_back(indexOffset + v);
+            }
+            indexOffset += faceVertices;
+        }
+    }
+    return mesh;
+}
+
+// peak resident set of this process in MB
+double peakRSS() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0);   // bytes
+#else
+    return usage.ru_maxrss / 1024.0;              // kilobytes
+#endif
+}
+
+// each loader runs in its own child process, so every peak is measured from a clean start
+int benchLoadRSS(int argc, char** argv) {
+    if (argc < 1) {
+        std::cerr << "usage: cobalt-bench rss <file.obj>" << std::endl;
+        return 1;
+    }
+    const std::string path = argv[0];
+
+    struct Loader {
+        const char* name;
+        Mesh (*load)(const std::string&, float);
+    };
+    const Loader loaders[] = {
+        {"legacy (LoadObj + copy)", loadOBJLegacy},
+        {"parallel (loadOBJ)", loadOBJ},
+        {"streaming (loadOBJStreaming)", loadOBJStreaming},
+    };
+
+    std::printf("%-30s %10s %12s %12s %12s\n", "loader", "time", "triangles", "mesh MB", "peak RSS MB");
+    for (const Loader& loader : loaders) {
+        std::fflush(stdout);
+        pid_t child = fork();
+        if (child == 0) {
+            // keep the loaders' own progress output out of the table
+            std::cout.setstate(std::ios::failbit);
+            auto start = std::chrono::steady_clock::now();
+            Mesh mesh = loader.load(path, 1.0f);
+            double seconds = secondsSince(start);
+            double meshMB = (mesh.vertices.size() + mesh.normals.size() + mesh.texcoords.size()) * sizeof(float) / (1024.0 * 1024.0) +
+                            mesh.indices.size() * sizeof(unsigned int) / (1024.0 * 1024.0);
+            std::printf("%-30s %8.0f ms %12zu %12.1f %12.1f\n", loader.name, seconds * 1000.0,
+                        mesh.indices.size() / 3, meshMB, peakRSS());
+            std::fflush(stdout);
+            _exit(0);
+        }
+        int status = 0;
+        waitpid(child, &status, 0);
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::printf("%-30s failed\n", loader.name);
+        }
+    }
+    return 0;
+}
+
+// octahedral packing of the per-primitive normals: memory, encode speed and angular error.
+// without a file, random unit normals stand in for a mesh
+int benchNormals(int argc, char** argv) {
+    std::vector<float> normals;
+    if (argc > 0) {
+        std::cout.setstate(std::ios::failbit);
+        Mesh mesh = loadOBJ(argv[0]);
+        std::cout.clear();
+        normals = primitiveNormals(mesh);
+    } else {
+        std::mt19937 rng(1234);
+        std::normal_distribution<float> gauss;
+        normals.resize(9 * (1 << 20));
+        for (size_t i = 0; i < normals.size(); i += 3) {
+            float x = gauss(rng), y = gauss(rng), z = gauss(rng);
+            float length = std::sqrt(x * x + y * y + z * z);
+            normals[i] = x / length;
+            normals[i + 1] = y / length;
+            normals[i + 2] = z / length;
+        }
+    }
+    size_t triangleCount = normals.size() / 9;
+
+    std::vector<uint32_t> packed;
+    double best = 1e30;
+    for (int repeat = 0; repeat < 5; ++repeat) {
+        auto start = std::chrono::steady_clock::now();
+        packed = packPrimitiveNormals(normals.data(), triangleCount);
+        best = std::min(best, secondsSince(start));
+    }
+    NormalPackingError error = measurePackingError(normals.data(), packed.data(), packed.size());
+
+    std::printf("triangles        %12zu\n", triangleCount);
+    std::printf("float normals    %9zu MB  (%zu bytes/triangle)\n", normals.size() * sizeof(float) >> 20, 9 * sizeof(float));
+    std::printf("packed normals   %9zu MB  (%zu bytes/triangle)\n", packed.size() * sizeof(uint32_t) >> 20, 3 * sizeof(uint32_t));
+    std::printf("encode           %9.1f Mnormals/s\n", packed.size() / best / 1e6);
+    std::printf("angular error    mean %.5f, rms %.5f, max %.5f degrees\n", error.meanDegrees, error.rmsDegrees, error.maxDegrees);
+    return 0;
+}
+
+// load time of each file through loadMesh, best of three, so formats can be compared side by side
+int benchLoad(int argc, char** argv) {
+    if (argc < 1) {
+        std::cerr << "usage: cobalt-bench load <mesh file>..." << std::endl;
+        return 1;
+    }
+
+    std::printf("%-40s %10s %10s %12s %10s %10s\n", "file", "file MB", "time", "triangles", "MB/s", "Mtri/s");
+    for (int i = 0; i < argc; ++i) {
+        std::cout.setstate(std::ios::failbit);
+        double best = 1e30, megabytes = 0.0;
+        size_t triangles = 0;
+        for (int repeat = 0; repeat < 3; ++repeat) {
+            auto start = std::chrono::steady_clock::now();
+            Mesh mesh = loadMesh(argv[i]);
+            best = std::min(best, secondsSince(start));
+            triangles = mesh.indices.size() / 3;
+        }
+        std::cout.clear();
+        if (FILE* file = std::fopen(argv[i], "rb")) {
+            std::fseek(file, 0, SEEK_END);
+            megabytes = std::ftell(file) / (1024.0 * 1024.0);
+            std::fclose(file);
+        }
+        std::printf("%-40s %10.1f %7.0f ms %12zu %10.0f %10.1f\n", argv[i], megabytes, best * 1000.0, triangles,
+                    megabytes / best, triangles / best / 1e6);
+    }
+    return 0;
+}
+
+// a mesh file, or a generated scene given as scene:kind[:triangles[:seed]]
+Mesh benchMesh(const std::string& arg) {
+    if (arg.compare(0, 6, "scene:") == 0) return generateScene(parseSceneSpec(arg.substr(6)));
+    std::cout.setstate(std::ios::failbit);
+    Mesh mesh = loadMesh(arg);
+    std::cout.clear();
+    return mesh;
+}
+
+// generation speed of every scene kind, plus a content hash to check runs reproduce
+int benchGenerate(int argc, char** argv) {
+    SceneSpec spec;
+    if (argc > 0) spec.triangles = parseSceneSpec(std::string("mixed:") + argv[0]).triangles;
+    if (argc > 1) spec.seed = parseSceneSpec(std::string("mixed:1:") + argv[1]).seed;
+    std::printf("budget: %zu triangles, seed %llu, %u threads\n", spec.triangles,
+                static_cast<unsigned long long>(spec.seed), threadCount());
+
+    std::printf("%-10s %12s %12s %10s %10s %10s  %s\n", "scene", "triangles", "vertices", "MB", "time", "Mtri/s", "hash");
+    for (SceneKind kind : {SceneKind::Spheres, SceneKind::Terrain, SceneKind::Instances, SceneKind::Slivers, SceneKind::Mixed}) {
+        spec.kind = kind;
+        auto start = std::chrono::steady_clock::now();
+        Mesh mesh = generateScene(spec);
+        double seconds = secondsSince(start);
+
+        size_t triangles = mesh.indices.size() / 3;
+        size_t bytes = (mesh.vertices.size() + mesh.normals.size()) * sizeof(float) + mesh.indices.size() * sizeof(unsigned int);
+        uint64_t hash = contentHash(mesh.vertices.data(), mesh.vertices.size() * sizeof(float)) ^
+                        contentHash(mesh.indices.data(), mesh.indices.size() * sizeof(unsigned int));
+        std::printf("%-10s %12zu %12zu %10.1f %7.0f ms %10.1f  %016llx\n", sceneKindName(kind), triangles,
+                    mesh.vertices.size() / 3, bytes / (1024.0 * 1024.0), seconds * 1000.0, triangles / seconds / 1e6,
+                    static_cast<unsigned long long>(hash));
+    }
+    return 0;
+}
+
+// simplification speed in input triangles per second, for single levels and the whole LOD chain
+int benchSimplify(int argc, char** argv) {
+    Mesh mesh = benchMesh(argc > 0 ? argv[0] : "scene:terrain:2m");
+    size_t triangles = mesh.indices.size() / 3;
+    std::printf("input: %zu triangles, %zu vertices, %u threads\n", triangles, mesh.vertices.size() / 3, threadCount());
+
+    std::printf("%-10s %12s %12s %10s %12s\n", "run", "target", "triangles", "time", "Mtri/s");
+    for (float fraction : {0.5f, 0.1f, 0.01f}) {
+        size_t target = static_cast<size_t>(triangles * fraction);
+        auto start = std::chrono::steady_clock::now();
+        Mesh level = simplifyMesh(mesh, target);
+        double seconds = secondsSince(start);
+        std::printf("%9.0f%% %12zu %12zu %7.0f ms %12.2f\n", fraction * 100.0f, target, level.indices.size() / 3,
+                    seconds * 1000.0, triangles / seconds / 1e6);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Mesh> chain = buildLODChain(mesh);
+    double seconds = secondsSince(start);
+    std::printf("%-10s %12s %12zu %7.0f ms %12.2f\n", "chain", "50/10/1%", chain.back().indices.size() / 3,
+                seconds * 1000.0, triangles / seconds / 1e6);
+    return 0;
+}
+
+// rays from a sphere around the bounds toward random points inside them, so most of them hit
+std::vector<Ray> makeRays(const Mesh& mesh, size_t count, uint32_t seed) {
+    float lo[3], hi[3];
+    meshBounds(mesh, lo, hi);
+    float center[3], radius = 0.0f;
+    for (int k = 0; k < 3; ++k) {
+        center[k] = 0.5f * (lo[k] + hi[k]);
+        radius += (hi[k] - lo[k]) * (hi[k] - lo[k]);
+    }
+    radius = std::sqrt(radius);
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    std::normal_distribution<float> gauss;
+    std::vector<Ray> rays(count);
+    for (Ray& ray : rays) {
+        float d[3] = {gauss(rng), gauss(rng), gauss(rng)};
+        float length = std::sqrt(d[0] * d[0] + d[1] * d[1] + d[2] * d[2]);
+        float target[3], direction[3];
+        for (int k = 0; k < 3; ++k) {
+            ray.origin[k] = center[k] + radius * d[k] / length;
+            target[k] = lo[k] + (hi[k] - lo[k]) * unit(rng);
+            direction[k] = target[k] - ray.origin[k];
+        }
+        length = std::sqrt(direction[0] * direction[0] + direction[1] * direction[1] + direction[2] * direction[2]);
+        for (int k = 0; k < 3; ++k) ray.direction[k] = direction[k] / length;
+    }
+    return rays;
+}
+
+// closest hits for all rays on every core, returns rays per second
+template<typename Trace>
+double traceRays(const std::vector<Ray>& rays, std::vector<Hit>& hits, Trace&& trace) {
+    hits.assign(rays.size(), Hit());
+    auto start = std::chrono::steady_clock::now();
+    parallelFor(0, rays.size(), [&](size_t i) { trace(rays[i], hits[i]); }, 256);
+    return rays.size() / secondsSince(start);
+}
+
+// the brute force answer for the first rays, to catch traversal bugs
+size_t countMismatches(const TriangleGeometry& geometry, const std::vector<Ray>& rays, const std::vector<Hit>& hits, size_t count) {
+    size_t wrong = 0;
+    for (size_t i = 0; i < std::min(count, rays.size()); ++i) {
+        Hit best;
+        for (uint32_t t = 0; t < geometry.triangleCount; ++t) {
+            const uint32_t* tri = &geometry.indices[3 * t];
+            float tHit, u, v;
+            if (intersectTriangle(geometry.vertex(tri[0]), geometry.vertex(tri[1]), geometry.vertex(tri[2]), rays[i], best.t, tHit, u, v)) {
+                best = {tHit, t, u, v};
+            }
+        }
+        if (best.t != hits[i].t) wrong++;
+    }
+    return wrong;
+}
+
+// binned SAH build speed and quality for a few bin counts, and closest-hit throughput
+int benchBvh(int argc, char** argv) {
+    Mesh mesh = benchMesh(argc > 0 ? argv[0] : "scene:mixed:1m");
+    TriangleGeometry geometry = triangleGeometry(mesh);
+    std::printf("input: %zu triangles, %u threads\n", geometry.triangleCount, threadCount());
+
+    std::printf("%-6s %10s %10s %10s %10s %6s %8s %10s\n", "bins", "time", "Mtri/s", "nodes", "leaves", "depth", "leaf", "SAH");
+    Bvh bvh;
+    for (unsigned bins : {8u, 16u, 32u, 64u}) {
+        BvhBuildOptions options;
+        options.bins = bins;
+        bvh = buildBvh(geometry, options);
+        const BvhBuildStats& stats = bvh.stats;
+        std::printf("%-6u %7.0f ms %10.2f %10zu %10zu %6u %8.2f %10.2f\n", bins, stats.seconds * 1000.0,
+                    geometry.triangleCount / stats.seconds / 1e6, stats.nodes, stats.leaves, stats.maxDepth,
+                    stats.averageLeafSize, stats.sahCost);
+    }
+
+    std::vector<Ray> rays = makeRays(mesh, 1 << 20, 1234);
+    std::vector<Hit> hits;
+    double raysPerSecond = traceRays(rays, hits, [&](const Ray& ray, Hit& hit) { intersect(bvh, geometry, ray, hit); });
+    size_t hitCount = std::count_if(hits.begin(), hits.end(), [](const Hit& hit) { return hit.triangle != UINT32_MAX; });
+    std::printf("trace: %.2f Mrays/s, %.1f%% hit, %zu of 64 differ from brute force\n", raysPerSecond / 1e6,
+                100.0 * hitCount / rays.size(), countMismatches(geometry, rays, hits, 64));
+    return 0;
+}
+
+// edges may be precomputed, the AVX2 kernels use FMA and instanced rays are transformed, so rays
+// grazing a shared edge can take the neighbour, or at a silhouette whatever is behind. Hits count
+// as the same within rounding of t; expect a few in ten thousand on slivers
+size_t countDiffering(const std::vector<Hit>& hits, const std::vector<Hit>& reference) {
+    size_t differ = 0;
+    for (size_t i = 0; i < hits.size(); ++i) {
+        if (hits[i].triangle == reference[i].triangle) continue;
+        if (std::fabs(hits[i].t - reference[i].t) > 1e-4f * std::max(1.0f, reference[i].t)) differ++;
+    }
+    return differ;
+}
+
+// 8-wide and quantized 8-wide against binary BVH: memory and closest-hit throughput of both
+// kernels, per mesh
+int benchWide(int argc, char** argv) {
+    std::vector<std::string> inputs(argv, argv + argc);
+    if (inputs.empty()) inputs = {"scene:mixed:1m", "scene:terrain:1m", "scene:slivers:1m"};
+    SimdLevel best = detectSimdLevel();
+    std::printf("%u threads, best kernel %s\n", threadCount(), simdLevelName(best));
+
+    std::printf("%-20s %-8s %10s %10s %10s %10s\n", "mesh", "layout", "build", "B/tri", "Mrays/s", "differ");
+    for (const std::string& input : inputs) {
+        Mesh mesh = benchMesh(input);
+        TriangleGeometry geometry = triangleGeometry(mesh);
+        double triangles = static_cast<double>(geometry.triangleCount);
+        std::vector<Ray> rays = makeRays(mesh, 1 << 19, 1234);
+
+        Bvh bvh = buildBvh(geometry);
+        std::vector<Hit> reference;
+        double rate = traceRays(rays, reference, [&](const Ray& ray, Hit& hit) { intersect(bvh, geometry, ray, hit); });
+        size_t binaryBytes = bvh.nodes.size() * sizeof(BvhNode) + bvh.primitives.size() * sizeof(uint32_t);
+        std::printf("%-20s %-8s %7.0f ms %10.1f %10.2f %10s\n", input.c_str(), "binary", bvh.stats.seconds * 1000.0,
+                    binaryBytes / triangles, rate / 1e6, "-");
+
+        WideBvh wide = collapseBvh(bvh, geometry);
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2}) {
+            if (level > best) continue;
+            std::vector<Hit> hits;
+            rate = traceRays(rays, hits, [&](const Ray& ray, Hit& hit) { intersect(wide, ray, hit, level); });
+            size_t differ = countDiffering(hits, reference);
+            std::printf("%-20s %-8s %7.0f ms %10.1f %10.2f %10zu\n", "", (std::string("8-") + simdLevelName(level)).c_str(),
+                        wide.stats.seconds * 1000.0, wide.stats.bytes / triangles, rate / 1e6, differ);
+        }
+        std::printf("%-20s %zu nodes, %zu blocks, %.1f of 8 lanes used, collapse %.0f ms\n", "", wide.stats.nodes,
+                    wide.stats.blocks, wide.stats.blockFill, wide.stats.collapseSeconds * 1000.0);
+
+        // same tree with 8-bit boxes and leaves that fetch the mesh's vertices
+        QuantizedBvh quantized = quantizeBvh(bvh);
+        for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Avx2}) {
+            if (level > best) continue;
+            std::vector<Hit> hits;
+            rate = traceRays(rays, hits, [&](const Ray& ray, Hit& hit) { intersect(quantized, geometry, ray, hit, level); });
+            size_t differ = countDiffering(hits, reference);
+            std::printf("%-20s %-8s %7.0f ms %10.1f %10.2f %10zu\n", "", (std::string("q8-") + simdLevelName(level)).c_str(),
+                        quantized.stats.seconds * 1000.0, quantized.stats.bytes / triangles, rate / 1e6, differ);
+        }
+    }
+    return 0;
+}
+
+// precomputed triangle transforms against fetching the vertices in the leaves: memory, build
+// time and closest-hit throughput of the same tree, per mesh. The dragon the viewer loads is
+// included when it is there
+int benchLeaves(int argc, char** argv) {
+    std::vector<std::string> inputs(argv, argv + argc);
+    if (inputs.empty()) {
+        if (std::ifstream("models/dragon.obj")) inputs.push_back("models/dragon.obj");
+        inputs.insert(inputs.end(), {"scene:mixed:1m", "scene:terrain:1m", "scene:slivers:1m"});
+    }
+    std::printf("%u threads\n", threadCount());
+
+    std::printf("%-20s %-12s %10s %10s %10s %10s\n", "mesh", "leaves", "build", "B/tri", "Mrays/s", "differ");
+    for (const std::string& input : inputs) {
+        Mesh mesh = benchMesh(input);
+        TriangleGeometry geometry = triangleGeometry(mesh);
+        double triangles = static_cast<double>(geometry.triangleCount);
+        std::vector<Ray> rays = makeRays(mesh, 1 << 19, 1234);
+
+        std::vector<Hit> reference;
+        for (LeafFormat format : {LeafFormat::VertexFetch, LeafFormat::Transformed}) {
+            BvhBuildOptions options;
+            options.leafFormat = format;
+            Bvh bvh = buildBvh(geometry, options);
+            std::vector<Hit> hits;
+            double rate = traceRays(rays, hits, [&](const Ray& ray, Hit& hit) { intersect(bvh, geometry, ray, hit); });
+            // the vertex fetching tree also reads the mesh, 12 bytes per index and a share of a vertex
+            size_t bytes = bvh.nodes.size() * sizeof(BvhNode) + bvh.primitives.size() * sizeof(uint32_t) +
+                           bvh.transforms.size() * sizeof(TriangleTransform);
+            bool fetch = format == LeafFormat::VertexFetch;
+            if (fetch) reference = hits;
+            std::printf("%-20s %-12s %7.0f ms %10.1f %10.2f %10s\n", fetch ? input.c_str() : "",
+                        fetch ? "vertex fetch" : "transformed", bvh.stats.seconds * 1000.0, bytes / triangles, rate / 1e6,
+                        fetch ? "-" : std::to_string(countDiffering(hits, reference)).c_str());
+        }
+    }
+    return 0;
+}
+
+// linear builds against the binned SAH build: build throughput, tree quality and trace speed
+int benchLbvh(int argc, char** argv) {
+    std::vector<std::string> inputs(argv, argv + argc);
+    if (inputs.empty()) inputs = {"scene:mixed:1m", "scene:terrain:1m"};
+    std::printf("%u threads\n", threadCount());
+
+    std::printf("%-20s %-14s %10s %10s %8s %10s %10s\n", "mesh", "build", "time", "Mtri/s", "SAH", "Mrays/s", "differ");
+    for (const std::string& input : inputs) {
+        Mesh mesh = benchMesh(input);
+        TriangleGeometry geometry = triangleGeometry(mesh);
+        std::vector<Ray> rays = makeRays(mesh, 1 << 19, 1234);
+        std::vector<Hit> reference;
+        auto report = [&](const char* name, const Bvh& bvh) {
+            std::vector<Hit> hits;
+            double rate = traceRays(rays, hits, [&](const Ray& ray, Hit& hit) { intersect(bvh, geometry, ray, hit); });
+            if (reference.empty()) reference = hits;
+            std::printf("%-20s %-14s %7.1f ms %10.1f %8.1f %10.2f %10zu\n", input.c_str(), name, bvh.stats.seconds * 1000.0,
+                        geometry.triangleCount / bvh.stats.seconds / 1e6, bvh.stats.sahCost, rate / 1e6,
+                        countDiffering(hits, reference));
+        };
+
+        report("binned SAH", buildBvh(geometry));
+        struct Mode {
+            const char* name;
+            unsigned bits, passes;
+        };
+        for (Mode mode : {Mode{"lbvh 30", 30, 0}, Mode{"lbvh 63", 63, 0}, Mode{"lbvh 30 +1", 30, 1}, Mode{"lbvh 30 +3", 30, 3}}) {
+            LbvhBuildOptions options;
+            options.mortonBits = mode.bits;
+            options.restructurePasses = mode.passes;
+            report(mode.name, buildLbvh(geometry, options));
+        }
+    }
+    return 0;
+}
+
+// the tree report of a mesh, then one frame from a pinhole camera with per-pixel traversal
+// counters (in STATS=1 builds) and an optional heatmap of them
+int benchStats(int argc, char** argv) {
+    Mesh mesh = benchMesh(argc > 0 ? argv[0] : "scene:mixed:1m");
+    TriangleGeometry geometry = triangleGeometry(mesh);
+    std::printf("input: %zu triangles, %u threads, counters %s\n", geometry.triangleCount, threadCount(),
+                COBALT_STATS ? "built in" : "compiled out (make bench STATS=1)");
+    Bvh bvh = buildBvh(geometry);
+    std::printf("%s", formatReport(analyzeBvh(bvh)).c_str());
+
+    // looking at the middle of the bounds from the front, a little above
+    const size_t width = 512, height = 512;
+    float lo[3], hi[3];
+    meshBounds(mesh, lo, hi);
+    float center[3], size = 0.0f;
+    for (int k = 0; k < 3; ++k) {
+        center[k] = 0.5f * (lo[k] + hi[k]);
+        size = std::max(size, hi[k] - lo[k]);
+    }
+    float eye[3] = {center[0], center[1] + 0.3f * size, center[2] + 1.6f * size};
+    FrameStats stats(width, height);
+    stats.beginFrame();
+    std::vector<Hit> hits(width * height);
+    auto start = std::chrono::steady_clock::now();
+    parallelFor(0, height, [&](size_t y) {
+        for (size_t x = 0; x < width; ++x) {
+            Ray ray;
+            float target[3] = {center[0] + size * ((x + 0.5f) / width - 0.5f), center[1] + size * (0.5f - (y + 0.5f) / height),
+                               center[2]};
+            for (int k = 0; k < 3; ++k) {
+                ray.origin[k] = eye[k];
+                ray.direction[k] = target[k] - eye[k];
+            }
+            traceCounted(bvh, geometry, ray, hits[y * width + x], stats, y * width + x);
+        }
+    });
+    double seconds = secondsSince(start);
+    stats.endFrame();
+    std::printf("frame: %zux%zu, %.2f Mrays/s\n", width, height, width * height / seconds / 1e6);
+    if (COBALT_STATS) {
+        double rays = static_cast<double>(stats.rays());
+        std::printf("per ray: %.1f nodes, %.1f triangles\n", stats.totals().nodes / rays, stats.totals().triangles / rays);
+        if (argc > 1) {
+            stats.writeHeatmap(argv[1]);
+            std::printf("heatmap: %s\n", argv[1]);
+        }
+    }
+    return 0;
+}
+
+// the viewer's default view of the dragon, or for a generated scene the same direction from far
+// enough to take in [-1, 1]^3 and a little above, so terrain isn't seen edge-on
+Camera benchCamera(const std::string& input) {
+    Camera camera;
+    if (input.compare(0, 6, "scene:") == 0) {
+        const float from[3] = {8.4f, 1.2f, -3.6f}, at[3] = {0.0f, 0.0f, 0.0f};
+        std::copy(from, from + 3, camera.lookFrom);
+        std::copy(at, at + 3, camera.lookAt);
+    }
+    return camera;
+}
+
+// one frame of compute_kernel on the CPU at the compute texture's size in the default window,
+// with float and packed normals. Writes the float one (.pfm for the raw values), and compares
+// it to a capture of the Metal kernel if one is given
+int benchRender(int argc, char** argv) {
+    std::string input = argc > 0 ? argv[0] : (std::ifstream("models/dragon.obj") ? "models/dragon.obj" : "scene:mixed:1m");
+    std::string path = argc > 1 ? argv[1] : "cobalt-render.ppm";
+    Mesh mesh = benchMesh(input);
+    std::vector<float> normals = primitiveNormals(mesh);
+    std::vector<uint32_t> packed = packPrimitiveNormals(normals.data(), normals.size() / 9);
+    RenderScene scene;
+    scene.geometry = triangleGeometry(mesh, normals.data());
+    Bvh bvh = buildBvh(scene.geometry);
+    scene.bvh = bvh;
+    std::printf("input: %zu triangles, %u threads, build %.0f ms\n", scene.geometry.triangleCount, threadCount(),
+                bvh.stats.seconds * 1000.0);
+
+    Camera camera = benchCamera(input);
+    Image image(640, 360), packedImage(640, 360);
+    renderFrame(scene, camera, image);  // warm up
+    RenderStats stats = renderFrame(scene, camera, image);
+    std::printf("float normals:  %.1f ms, %.2f Mrays/s\n", stats.seconds * 1000.0, stats.rays / stats.seconds / 1e6);
+
+    scene.packedNormals = true;
+    scene.geometry.primitiveData = packed.data();
+    scene.geometry.primitiveDataStride = 3 * sizeof(uint32_t);
+    stats = renderFrame(scene, camera, packedImage);
+    ImageDifference difference = compareImages(packedImage, image);
+    std::printf("packed normals: %.1f ms, %.2f Mrays/s, rmse %.2e, max %.2e against float\n", stats.seconds * 1000.0,
+                stats.rays / stats.seconds / 1e6, difference.rmse, difference.maxError);
+
+    writeImage(image, path);
+    std::printf("image: %s\n", path.c_str());
+    if (argc > 2) {
+        difference = compareImages(image, readPfm(argv[2]));
+        std::printf("against %s: rmse %.2e, max %.2e, %zu of %zu pixels off by more than 1e-3\n", argv[2],
+                    difference.rmse, difference.maxError, difference.pixelsOver, image.width * image.height);
+    }
+    return 0;
+}
+
+// render time per tile size and order, with and without stealing, and how much of it the
+// threads spent working; more threads than cores can be asked for to watch the stealing
+int benchTiles(int argc, char** argv) {
+    std::string input = argc > 0 ? argv[0] : (std::ifstream("models/dragon.obj") ? "models/dragon.obj" : "scene:mixed:1m");
+    unsigned threads = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : threadCount();
+    Mesh mesh = benchMesh(input);
+    std::vector<float> normals = primitiveNormals(mesh);
+    RenderScene scene;
+    scene.geometry = triangleGeometry(mesh, normals.data());
+    Bvh bvh = buildBvh(scene.geometry);
+    scene.bvh = bvh;
+    Camera camera = benchCamera(input);
+    Image image(1280, 720);
+    std::printf("input: %zu triangles, %u threads on %u cores, %zux%zu\n", scene.geometry.triangleCount, threads,
+                threadCount(), image.width, image.height);
+
+    struct Mode {
+        const char* name;
+        TileOrder order;
+        bool steal;
+    };
+    std::printf("%-16s %6s %10s %10s %8s %8s %8s\n", "order", "tile", "time", "Mrays/s", "busy", "idle", "steals");
+    renderFrame(scene, camera, image);  // warm up
+    for (Mode mode : {Mode{"scanline static", TileOrder::Scanline, false}, Mode{"scanline", TileOrder::Scanline, true},
+                      Mode{"hilbert", TileOrder::Hilbert, true}, Mode{"spiral", TileOrder::Spiral, true}}) {
+        for (unsigned tileSize : {8u, 16u, 32u, 64u}) {
+            RenderOptions options;
+            options.tiles.tileSize = tileSize;
+            options.tiles.order = mode.order;
+            options.tiles.steal = mode.steal;
+            options.tiles.threads = threads;
+            RenderStats stats = renderFrame(scene, camera, image, options);
+            double busy = 0.0, idle = 0.0;
+            size_t steals = 0;
+            for (const TileThreadStats& thread : stats.threads) {
+                busy += thread.busy;
+                idle += thread.idle;
+                steals += thread.steals;
+            }
+            std::printf("%-16s %6u %7.1f ms %10.2f %7.1f%% %7.1f%% %8zu\n", mode.name, tileSize, stats.seconds * 1000.0,
+                        stats.rays / stats.seconds / 1e6, 100.0 * busy / (busy + idle), 100.0 * idle / (busy + idle), steals);
+        }
+    }
+    return 0;
+}
+
+// progressive rendering to a few error targets within a sample budget: passes until it stopped,
+// and why. Writes the mean of the tightest target if asked to
+int benchProgressive(int argc, char** argv) {
+    std::string input = argc > 0 ? argv[0] : (std::ifstream("models/dragon.obj") ? "models/dragon.obj" : "scene:mixed:1m");
+    unsigned budget = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 64;
+    Mesh mesh = benchMesh(input);
+    std::vector<float> normals = primitiveNormals(mesh);
+    RenderScene scene;
+    scene.geometry = triangleGeometry(mesh, normals.data());
+    Bvh bvh = buildBvh(scene.geometry);
+    scene.bvh = bvh;
+    Camera camera = benchCamera(input);
+    Accumulator accumulator(640, 360);
+    std::printf("input: %zu triangles, %u threads, %zux%zu, budget %u samples\n", scene.geometry.triangleCount,
+                threadCount(), accumulator.width(), accumulator.height(), budget);
+
+    std::printf("%-8s %8s %10s %10s %10s %10s\n", "target", "passes", "time", "Mrays/s", "converged", "stopped");
+    for (float target : {0.1f, 0.05f, 0.02f, 0.01f}) {
+        ConvergenceOptions convergence;
+        convergence.relativeError = target;
+        convergence.maxSamples = budget;
+        accumulator.reset();
+        ProgressiveStats stats = renderProgressive(scene, camera, accumulator, convergence);
+        std::printf("%-8.3f %8u %7.0f ms %10.2f %9.2f%% %10s\n", target, stats.passes, stats.seconds * 1000.0,
+                    stats.rays / stats.seconds / 1e6, 100.0 * stats.convergedPixels / (accumulator.width() * accumulator.height()),
+                    stats.converged ? "converged" : "budget");
+    }
+    if (argc > 1) {
+        writeImage(accumulator.mean(), argv[1]);
+        std::printf("image: %s\n", argv[1]);
+    }
+    return 0;
+}
+
+// time until the mean is within an RMSE of a many-sample reference, sampling every pixel
+// alike against adaptive per-tile sampling. The RMSE checks aren't timed
+int benchAdaptive(int argc, char** argv) {
+    std::string input = argc > 0 ? argv[0] : (std::ifstream("models/dragon.obj") ? "models/dragon.obj" : "scene:mixed:1m");
+    double target = argc > 1 ? std::stod(argv[1]) : 0.01;
+    const unsigned referenceSamples = 512, maxSamples = 256;
+    Mesh mesh = benchMesh(input);
+    std::vector<float> normals = primitiveNormals(mesh);
+    RenderScene scene;
+    scene.geometry = triangleGeometry(mesh, normals.data());
+    Bvh bvh = buildBvh(scene.geometry);
+    scene.bvh = bvh;
+    Camera camera = benchCamera(input);
+    Accumulator accumulator(320, 180);
+    size_t pixels = accumulator.width() * accumulator.height();
+
+    ConvergenceOptions all;
+    all.maxSamples = referenceSamples;
+    all.pixelShare = 2.0f;  // never done early
+    RenderOptions independent;
+    independent.seed = 1;
+    renderProgressive(scene, camera, accumulator, all, independent);
+    Image reference = accumulator.mean();
+    std::printf("input: %zu triangles, %u threads, %zux%zu, reference %u samples, target RMSE %.4f\n",
+                scene.geometry.triangleCount, threadCount(), accumulator.width(), accumulator.height(), referenceSamples,
+                target);
+
+    std::printf("%-10s %10s %10s %12s %10s\n", "sampling", "time", "samples", "per pixel", "RMSE");
+    auto report = [&](const char* name, double seconds, uint64_t samples, double rmse) {
+        std::printf("%-10s %7.0f ms %10.2fM %12.1f %10.5f%s\n", name, seconds * 1000.0, samples / 1e6,
+                    double(samples) / pixels, rmse, rmse <= target ? "" : "  (not reached)");
+    };
+
+    accumulator.reset();
+    double seconds = 0.0, rmse = 1.0;
+    uint64_t samples = 0;
+    for (unsigned pass = 0; pass < maxSamples && rmse > target; ++pass) {
+        RenderStats stats = accumulateFrame(scene, camera, accumulator);
+        seconds += stats.seconds;
+        samples += stats.samples;
+        rmse = compareImages(accumulator.mean(), reference).rmse;
+    }
+    report("uniform", seconds, samples, rmse);
+
+    accumulator.reset();
+    AdaptiveOptions options;
+    options.relativeError = 0.001f;  // tighter than the target, the RMSE decides when to stop
+    options.maxSamples = 4 * maxSamples;
+    options.sampleBudget = maxSamples;
+    AdaptiveRenderer adaptive(accumulator, options);
+    rmse = 1.0;
+    while (rmse > target && adaptive.pass(scene, camera)) rmse = compareImages(accumulator.mean(), reference).rmse;
+    report("adaptive", adaptive.stats().seconds, adaptive.stats().samples, rmse);
+    std::printf("%-10s %zu of %zu tiles converged after %u passes\n", "", adaptive.stats().convergedTiles,
+                adaptive.stats().tiles, adaptive.stats().passes);
+    return 0;
+}
+
+// the path tracer at a few depths against the kernel's shading, at the same samples per pixel:
+// the rays every sample takes, shadow rays included, and the throughput in rays and samples.
+// The mean brightness has to stay put when Russian roulette is turned off, it only ends paths
+// early. Writes the deepest image if asked to
+int benchPathTrace(int argc, char** argv) {
+    std::string input = argc > 0 ? argv[0] : (std::ifstream("models/dragon.obj") ? "models/dragon.obj" : "scene:mixed:1m");
+    unsigned maxDepth = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 8;
+    const unsigned samples = 16;
+    Mesh mesh = benchMesh(input);
+    std::vector<float> normals = primitiveNormals(mesh);
+    RenderScene scene;
+    scene.geometry = triangleGeometry(mesh, normals.data());
+    Bvh bvh = buildBvh(scene.geometry);
+    scene.bvh = bvh;
+    Camera camera = benchCamera(input);
+    Accumulator accumulator(320, 180);
+    std::printf("input: %zu triangles, %u threads, %zux%zu, %u samples per pixel\n", scene.geometry.triangleCount,
+                threadCount(), accumulator.width(), accumulator.height(), samples);
+
+    ConvergenceOptions fixed;
+    fixed.maxSamples = samples;
+    fixed.pixelShare = 2.0f;  // never done early
+    auto brightness = [](const Image& image) {
+        double sum = 0.0;
+        for (size_t i = 0; i < image.pixels.size(); i += 4) sum += (image.pixels[i] + image.pixels[i + 1] + image.pixels[i + 2]) / 3.0;
+        return sum / (image.width * image.height);
+    };
+    std::printf("%-14s %10s %10s %10s %12s %12s\n", "integrator", "time", "Mrays/s", "Msamples/s", "rays/sample", "brightness");
+    auto run = [&](const char* name, const RenderOptions& options) {
+        accumulator.reset();
+        ProgressiveStats stats = renderProgressive(scene, camera, accumulator, fixed, options);
+        std::printf("%-14s %7.0f ms %10.2f %10.2f %12.2f %12.4f\n", name, stats.seconds * 1000.0,
+                    stats.rays / stats.seconds / 1e6, stats.samples / stats.seconds / 1e6,
+                    double(stats.rays) / stats.samples, brightness(accumulator.mean()));
+    };
+
+    run("kernel", RenderOptions());
+    RenderOptions options;
+    options.integrator = Integrator::PathTracer;
+    for (unsigned depth = 1; depth < maxDepth; depth *= 2) {
+        options.path.maxDepth = depth;
+        run(("path " + std::to_string(depth)).c_str(), options);
+    }
+    options.path.maxDepth = maxDepth;
+    options.path.rouletteDepth = maxDepth;
+    run(("path " + std::to_string(maxDepth) + " no RR").c_str(), options);
+    options.path.rouletteDepth = PathTracingOptions().rouletteDepth;
+    run(("path " + std::to_string(maxDepth)).c_str(), options);
+    if (argc > 1) {
+        writeImage(accumulator.mean(), argv[1]);
+        std::printf("image: %s\n", argv[1]);
+    }
+    return 0;
+}
+
+// cold start that builds and writes the BVH cache, warm start that maps it, and a start after
+// one vertex moved, which has to miss; the mapped tree must trace exactly like the built one
+int benchBvhCache(int argc, char** argv) {
+    std::string input = argc > 0 ? argv[0] : "scene:mixed:1m";
+    std::string path = argc > 1 ? argv[1] : "cobalt-bench.cbvh";
+    Mesh mesh = benchMesh(input);
+    TriangleGeometry geometry = triangleGeometry(mesh);
+    std::printf("input: %zu triangles, cache %s, %u threads\n", geometry.triangleCount, path.c_str(), threadCount());
+    std::remove(path.c_str());
+
+    std::vector<Ray> rays = makeRays(mesh, 1 << 18, 1234);
+    std::vector<Hit> reference;
+    std::printf("%-8s %10s %8s %10s %10s\n", "start", "time", "cached", "Mrays/s", "differ");
+    auto run = [&](const char* name) {
+        std::cout.setstate(std::ios::failbit);
+        CachedBvh cached = loadCachedBvh(path, geometry);
+        std::cout.clear();
+        std::vector<Hit> hits;
+        double rate = traceRays(rays, hits, [&](const Ray& ray, Hit& hit) { intersect(cached.bvh, geometry, ray, hit); });
+        if (reference.empty()) reference = hits;
+        size_t differ = 0;
+        for (size_t i = 0; i < hits.size(); ++i) differ += hits[i].triangle != reference[i].triangle || hits[i].t != reference[i].t;
+        std::printf("%-8s %7.1f ms %8s %10.2f %10zu\n", name, cached.seconds * 1000.0, cached.fromCache ? "yes" : "no",
+                    rate / 1e6, differ);
+    };
+    run("cold");
+    run("warm");
+    mesh.vertices[0] += 1e-3f;
+    reference.clear();
+    run("stale");
+    std::remove(path.c_str());
+    return 0;
+}
+
+// the Instances scene kept as one rock under a top-level tree against the same scene flattened
+// into one mesh: build time, memory and closest-hit throughput
+int benchInstances(int argc, char** argv) {
+    SceneSpec spec;
+    spec.kind = SceneKind::Instances;
+    spec.triangles = argc > 0 ? parseSceneSpec(std::string("instances:") + argv[0]).triangles : 4000000;
+    if (argc > 1) spec.seed = parseSceneSpec(std::string("instances:1:") + argv[1]).seed;
+    ScatteredInstances scattered = scatterInstances(spec.triangles, spec.seed);
+    Mesh flat = generateScene(spec);
+    uint32_t faces = static_cast<uint32_t>(scattered.base.indices.size() / 3);
+    std::printf("%zu copies of a %u triangle rock, %zu triangles, %u threads\n", scattered.transforms.size(), faces,
+                flat.indices.size() / 3, threadCount());
+
+    std::vector<Ray> rays = makeRays(flat, 1 << 19, 1234);
+    auto meshBytes = [](const Mesh& mesh) { return (mesh.vertices.size() + mesh.indices.size()) * 4.0; };
+    std::printf("%-10s %10s %10s %10s %10s\n", "layout", "build", "MB", "Mrays/s", "differ");
+
+    TriangleGeometry geometry = triangleGeometry(flat);
+    Bvh bvh = buildBvh(geometry);
+    std::vector<Hit> reference;
+    double rate = traceRays(rays, reference, [&](const Ray& ray, Hit& hit) { intersect(bvh, geometry, ray, hit); });
+    double bytes = meshBytes(flat) + bvh.nodes.size() * sizeof(BvhNode) + bvh.primitives.size() * sizeof(uint32_t);
+    std::printf("%-10s %7.0f ms %10.1f %10.2f %10s\n", "flat", bvh.stats.seconds * 1000.0, bytes / (1024.0 * 1024.0),
+                rate / 1e6, "");
+
+    std::vector<Instance> instances(scattered.transforms.size());
+    for (size_t i = 0; i < instances.size(); ++i) instances[i] = {scattered.transforms[i], 0};
+    TwoLevelBvh scene = buildTwoLevelBvh({triangleGeometry(scattered.base)}, instances);
+    std::vector<Hit> hits;
+    // as flat triangle indices, copy by copy like the flattened mesh
+    rate = traceRays(rays, hits, [&](const Ray& ray, Hit& hit) {
+        InstanceHit instanceHit;
+        if (intersect(scene, ray, instanceHit)) {
+            hit = instanceHit;
+            hit.triangle = instanceHit.instance * faces + instanceHit.triangle;
+        }
+    });
+    bytes = meshBytes(scattered.base) + scene.stats.bytes;
+    std::printf("%-10s %7.0f ms %10.1f %10.2f %10zu\n", "two-level", scene.stats.seconds * 1000.0, bytes / (1024.0 * 1024.0),
+                rate / 1e6, countDiffering(hits, reference));
+    std::printf("top level alone %.1f ms over %zu instances\n", scene.stats.topSeconds * 1000.0, instances.size());
+    return 0;
+}
+
+// a mesh twisting around its vertical axis, more the higher up, refitted every frame: refit
+// time and SAH cost against a rebuild of the same frame, and when the degradation triggers one
+int benchRefit(int argc, char** argv) {
+    Mesh mesh = benchMesh(argc > 0 ? argv[0] : "scene:mixed:1m");
+    int frames = argc > 1 ? std::max(1, std::atoi(argv[1])) : 12;
+    std::printf("%zu triangles, %u threads\n", mesh.indices.size() / 3, threadCount());
+
+    float lo[3], hi[3];
+    meshBounds(mesh, lo, hi);
+    float center[3] = {0.5f * (lo[0] + hi[0]), 0.0f, 0.5f * (lo[2] + hi[2])};
+    std::vector<float> rest = mesh.vertices;
+    auto twist = [&](float amount) {
+        parallelFor(0, rest.size() / 3, [&](size_t i) {
+            const float* p = &rest[3 * i];
+            float x = p[0] - center[0], z = p[2] - center[2];
+            float angle = amount * (p[1] - lo[1]) / (hi[1] - lo[1]);
+            float c = std::cos(angle), s = std::sin(angle);
+            mesh.vertices[3 * i] = center[0] + c * x - s * z;
+            mesh.vertices[3 * i + 2] = center[2] + s * x + c * z;
+        }, 4096);
+    };
+
+    TriangleGeometry geometry = triangleGeometry(mesh);
+    DynamicBvh dynamic(geometry);
+    std::printf("%-6s %-8s %10s %8s %8s %12s %12s\n", "frame", "update", "time", "SAH", "x built", "rebuild", "rebuilt SAH");
+    for (int frame = 1; frame <= frames; ++frame) {
+        twist(0.4f * frame);
+        bool rebuilt = dynamic.update(geometry);
+        Bvh fresh = buildBvh(geometry);
+        std::printf("%-6d %-8s %7.1f ms %8.1f %8.2f %9.1f ms %12.1f\n", frame, rebuilt ? "rebuild" : "refit",
+                    dynamic.stats().seconds * 1000.0, dynamic.bvh().stats.sahCost, dynamic.stats().degradation,
+                    fresh.stats.seconds * 1000.0, fresh.stats.sahCost);
+    }
+    std::printf("%zu refits, %zu rebuilds\n", dynamic.stats().refits, dynamic.stats().rebuilds);
+    return 0;
+}
+
+// object splits against spatial splits at a few reference budgets: build cost, duplicated
+// references, traversal steps per ray and closest-hit throughput
+int benchSbvh(int argc, char** argv) {
+    std::vector<std::string> inputs(argv, argv + argc);
+    if (inputs.empty()) inputs = {"scene:slivers:1m", "scene:mixed:1m", "scene:terrain:1m"};
+    std::printf("%u threads\n", threadCount());
+
+    std::printf("%-20s %-10s %10s %10s %8s %8s %8s %10s %10s %10s %8s\n", "mesh", "build", "time", "refs", "dup", "spatial",
+                "SAH", "nodes/ray", "tris/ray", "Mrays/s", "differ");
+    for (const std::string& input : inputs) {
+        Mesh mesh = benchMesh(input);
+        TriangleGeometry geometry = triangleGeometry(mesh);
+        std::vector<Ray> rays = makeRays(mesh, 1 << 19, 1234);
+        std::vector<Hit> reference;
+
+        struct Mode {
+            const char* name;
+            SpatialSplits splits;
+            float budget;
+        };
+        for (Mode mode : {Mode{"object", SpatialSplits::Off, 0.0f}, Mode{"sbvh 10%", SpatialSplits::On, 0.1f},
+                          Mode{"sbvh 30%", SpatialSplits::On, 0.3f}, Mode{"sbvh 100%", SpatialSplits::On, 1.0f}}) {
+            BvhBuildOptions options;
+            options.spatialSplits = mode.splits;
+            options.referenceBudget = mode.budget;
+            Bvh bvh = buildBvh(geometry, options);
+
+            std::vector<Hit> hits;
+            double rate = traceRays(rays, hits, [&](const Ray& ray, Hit& hit) { intersect(bvh, geometry, ray, hit); });
+            if (reference.empty()) reference = hits;
+            TraversalCounters counters;
+            const size_t counted = std::min<size_t>(rays.size(), 1 << 16);
+            for (size_t i = 0; i < counted; ++i) {
+                Hit hit;
+                intersect(bvh, geometry, rays[i], hit, counters);
+            }
+
+            const BvhBuildStats& stats = bvh.stats;
+            std::printf("%-20s %-10s %7.0f ms %10zu %7.1f%% %8zu %8.1f %10.1f %10.1f %10.2f %8zu\n", input.c_str(), mode.name,
+                        stats.seconds * 1000.0, stats.references,
+                        100.0 * (stats.references - geometry.triangleCount) / geometry.triangleCount, stats.spatialSplits,
+                        stats.sahCost, static_cast<double>(counters.nodes) / counted,
+                        static_cast<double>(counters.triangles) / counted, rate / 1e6, countDiffering(hits, reference));
+        }
+        double share = thinTriangleShare(geometry);
+        std::printf("%-20s thin triangles: %.0f%% of box area, auto picks %s\n", "", 100.0 * share,
+                    prefersSpatialSplits(geometry) ? "spatial splits" : "object splits");
+    }
+    return 0;
+}
+
+struct Benchmark {
+    const char* name;
+    const char* usage;
+    std::function<int(int, char**)> run;
+};
+
+const std::vector<Benchmark> benchmarks = {
+    {"floats", "[file.obj]   OBJ number parsing, fast path vs reference", benchFloats},
+    {"rss", "<file.obj>      load time and peak memory of each OBJ loader", benchLoadRSS},
+    {"load", "<file>...       load time of OBJ/PLY/GLB files through loadMesh", benchLoad},
+    {"simplify", "[mesh]       QEM simplification and LOD chain speed", benchSimplify},
+    {"bvh", "[mesh]            binned SAH BVH build time, quality and trace speed", benchBvh},
+    {"wide", "[mesh]...         8-wide SIMD and quantized BVHs against the binary one", benchWide},
+    {"leaves", "[mesh]...       precomputed triangle transforms against vertex fetching leaves", benchLeaves},
+    {"lbvh", "[mesh]...         Morton-code linear builds, with and without treelet restructuring", benchLbvh},
+    {"stats", "[mesh] [heat.ppm]  tree report and per-ray traversal counters (STATS=1 builds)", benchStats},
+    {"render", "[mesh] [image] [metal.pfm]  compute_kernel on the CPU, written out and compared to a GPU capture", benchRender},
+    {"tiles", "[mesh] [threads]  tile sizes and orders of the CPU renderer, with and without work stealing", benchTiles},
+    {"progressive", "[mesh] [image] [budget]  accumulating samples until an error target or the budget is met", benchProgressive},
+    {"adaptive", "[mesh] [rmse]   time to an RMSE target, uniform against adaptive per-tile sampling", benchAdaptive},
+    {"pathtrace", "[mesh] [image] [depth]  path tracing with Russian roulette against the kernel: rays and samples per second", benchPathTrace},
+    {"bvhcache", "[mesh] [cache]   BVH cache cold, warm and stale starts", benchBvhCache},
+    {"instances", "[triangles] [seed]  one shared rock under a top-level tree against the flattened scene", benchInstances},
+    {"refit", "[mesh] [frames]   refitting a deforming mesh against rebuilding it", benchRefit},
+    {"sbvh", "[mesh]...         spatial splits against object splits, per reference budget", benchSbvh},
+    {"generate", "[triangles] [seed]  procedural scene generation speed", benchGenerate},
+    {"normals", "[file.obj]  octahedral normal packing size, speed and error", benchNormals},
+};
+
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 2) {
+        for (const Benchmark& benchmark : benchmarks) {
+            if (std::strcmp(argv[1], benchmark.name) == 0) return benchmark.run(argc - 2, argv + 2);
+        }
+    }
+
+    std::cerr << "usage: " << argv[0] << " <benchmark> [args...]" << std::endl;
+    for (const Benchmark& benchmark : benchmarks) {
+        std::cerr << "  " << benchmark.name << " " << benchmark.usage << std::endl;
+    }
+    return 1;
+}
@@ -2,19 +2,24 @@
 #include "imgui_impl_glfw.h"
 #include "imgui_impl_metal.h"
 
-#define TINYOBJLOADER_IMPLEMENTATION
-#include "tiny_obj_loader.h"
-
 #define GLFW_INCLUDE_NONE
 #include <GLFW/glfw3.h>
 #include "GLFWBridge.hpp"
 
+#include "MeshCache.hpp"
+#include "MeshSimplifier.hpp"
+#include "NormalPacking.hpp"
+
 // Metal headers
 #include <Foundation/Foundation.hpp>
 #include <Metal/Metal.hpp>
 #include <QuartzCore/CAMetalLayer.hpp>
 #include <QuartzCore/QuartzCore.hpp>
 
+#include <dispatch/dispatch.h>
+
+#include <atomic>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -28,84 +33,17 @@ CA::MetalLayer* layer;
 MTL::TextureDescriptor* textureDescriptor;
 MTL::Texture* computeTexture;
 
-// window size
-int width, height;
-
-struct Mesh {
-    std::vector<float> vertices;    // x, y, z positions
-    std::vector<float> normals;     // x, y, z normals
-    std::vector<float> texcoords;   // u, v texture coordinates
-    std::vector<unsigned int> indices; // Face indices
-};
-
-Mesh loadOBJ(const std::string& filepath, float scale = 1.0) {
-    tinyobj::attrib_t attrib;                       // Contains vertex positions, normals, texcoords
-    std::vector<tinyobj::shape_t> shapes;           // Contains all shapes (faces)
-    std::vector<tinyobj::material_t> materials;     // Contains material data
-    std::string warn, err;
-
-    // Load the OBJ file
-    bool success = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, filepath.c_str());
-
-    if (!warn.empty()) {
-        std::cerr << "Warning: " << warn << std::endl;
-    }
-
-    if (!success) {
-        throw std::runtime_error("Failed to load OBJ file: " + err);
-    }
-
-    // Prepare the mesh
-    Mesh mesh;
-
-    // Iterate over shapes
-    for (const auto& shape : shapes) {
-        // Iterate over faces in the shape
-        size_t indexOffset = 0;
-        for (size_t f = 0; f < shape.mesh.num_face_vertices.size(); ++f) {
-            int faceVertices = shape.mesh.num_face_vertices[f]; // Typically 3 for triangles
-
-            // Process each vertex in the face
-            for (int v = 0; v < faceVertices; ++v) {
-                tinyobj::index_t idx = shape.mesh.indices[indexOffset + v];
-
-                // Vertex positions
-                if (idx.vertex_index >= 0) {
-                    mesh.vertices.push_back(scale * attrib.vertices[3 * idx.vertex_index + 0]);
-                    //mesh.vertices.push_back(scale * attrib.vertices[3 * idx.vertex_index + 2]);
-                    mesh.vertices.push_back(scale * attrib.vertices[3 * idx.vertex_index + 1]);
-                    mesh.vertices.push_back(scale * attrib.vertices[3 * idx.vertex_index + 2]);
-                }
-
-                // Normals
-                if (idx.normal_index >= 0) {
-                    mesh.normals.push_back(attrib.normals[3 * idx.normal_index + 0]);
-                    //mesh.normals.push_back(attrib.normals[3 * idx.normal_index + 2]);
-                    mesh.normals.push_back(attrib.normals[3 * idx.normal_index + 1]);
-                    mesh.normals.push_back(attrib.normals[3 * idx.normal_index + 2]);
-                }
-
-                // Texture coordinates
-                if (idx.texcoord_index >= 0) {
-                    mesh.texcoords.push_back(attrib.texcoords[2 * idx.texcoord_index + 0]);
-                    mesh.texcoords.push_back(attrib.texcoords[2 * idx.texcoord_index + 1]);
-                }
-
-                // Add index
-                mesh.indices.push_back(indexOffset + v);
-            }
-
-            indexOffset += faceVertices;
-        }
-    }
+// running mean and summed squared deviations of every texel, two float4 each, and whether
+// a resize has thrown them away
+MTL::Buffer* accumulationBuffer;
+bool accumulationLost = false;
 
-    return mesh;
+size_t accumulationSize(MTL::Texture* texture) {
+    return texture->width() * texture->height() * 2 * 4 * sizeof(float);
 }
 
-
-
-
-
+// window size
+int width, height;
 
 static void glfw_error_callback(int error, const char* description)
 {
@@ -121,10 +59,21 @@ void framebuffer_size_callback(GLFWwindow* window, int _width, int _height)
     textureDescriptor->setWidth(_width/2);
     textureDescriptor->setHeight(_height/2);
     computeTexture = layer->device()->newTexture(textureDescriptor);
+    accumulationBuffer->release();
+    accumulationBuffer = layer->device()->newBuffer(accumulationSize(computeTexture), MTL::ResourceStorageModePrivate);
+    accumulationLost = true;
 }
 
 
-int main() {
+int main(int argc, char** argv) {
+    // command line options
+    bool packedNormals = false;
+    bool noLod = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--packed-normals") == 0) packedNormals = true;
+        if (std::strcmp(argv[i], "--no-lod") == 0) noLod = true;
+    }
+
     // Setup Dear ImGui context
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -201,6 +150,14 @@ int main() {
     textureDescriptor = MTL::TextureDescriptor::texture2DDescriptor(MTL::PixelFormatRGBA32Float, width/2, height/2, false);
     textureDescriptor->setUsage(MTL::TextureUsageShaderRead | MTL::TextureUsageShaderWrite);
     computeTexture = device->newTexture(textureDescriptor);
+    accumulationBuffer = device->newBuffer(accumulationSize(computeTexture), MTL::ResourceStorageModePrivate);
+    // pixels a frame found converged, counted by the kernel. Compute passes overlap, so each
+    // one in flight has its own counter, free again once its completed handler has read it
+    const int computeSlots = 3;
+    MTL::Buffer* convergedBuffers[computeSlots];
+    for (MTL::Buffer*& buffer : convergedBuffers) buffer = device->newBuffer(sizeof(uint32_t), MTL::ResourceStorageModeShared);
+    dispatch_semaphore_t computeSlotFree = dispatch_semaphore_create(computeSlots);
+    int computeSlot = 0;
 
 
     // Setup Platform/Renderer backends
@@ -217,61 +174,119 @@ int main() {
 
 
 
-    // load mesh
-    Mesh mesh = loadOBJ("models/dragon.obj", 1.0f);
-    std::cout << "Loaded mesh with " << mesh.vertices.size() / 3 << " vertices and " << mesh.indices.size() / 3 << " triangles." << std::endl;
-
-    // create buffers
-    MTL::Buffer* vertexBuffer = device->newBuffer(mesh.vertices.data(), mesh.vertices.size() * sizeof(float), MTL::ResourceStorageModeShared);
-    MTL::Buffer* normalBuffer = device->newBuffer(mesh.normals.data(), mesh.normals.size() * sizeof(float), MTL::ResourceStorageModeShared);
-    MTL::Buffer* indexBuffer = device->newBuffer(mesh.indices.data(), mesh.indices.size() * sizeof(uint), MTL::ResourceStorageModeShared);
-
-    // make geometry desciptor
-    MTL::AccelerationStructureTriangleGeometryDescriptor* geometryDescriptor = MTL::AccelerationStructureTriangleGeometryDescriptor::alloc()->init();
-
-    // link vertex data
-    geometryDescriptor->setVertexBuffer(vertexBuffer);
-    geometryDescriptor->setVertexStride(sizeof(float) * 3);
-    // link index data 
-    geometryDescriptor->setIndexBuffer(indexBuffer);
-    geometryDescriptor->setIndexType(MTL::IndexTypeUInt32);
-    // set tri count
-    geometryDescriptor->setTriangleCount(mesh.indices.size() / 3);
-    // link per-primitive data 
-    geometryDescriptor->setPrimitiveDataBuffer(normalBuffer);
-    geometryDescriptor->setPrimitiveDataStride(sizeof(MTL::PackedFloat3) * 3);
-    geometryDescriptor->setPrimitiveDataElementSize(sizeof(MTL::PackedFloat3) * 3);
-
-
-    // create AccelerationStructure
-    MTL::PrimitiveAccelerationStructureDescriptor* blasDescriptor = MTL::PrimitiveAccelerationStructureDescriptor::alloc()->init();
-    blasDescriptor->setGeometryDescriptors(NS::Array::array(geometryDescriptor));
-    MTL::AccelerationStructure* blas = device->newAccelerationStructure(blasDescriptor);
-    NS::UInteger scratchBufferSize = device->accelerationStructureSizes(blasDescriptor).buildScratchBufferSize;
-    MTL::Buffer* scratchBuffer = device->newBuffer(scratchBufferSize, MTL::ResourceStorageModePrivate);
-
-    // commit data and construct
-    MTL::CommandBuffer* accelerationCommandBuffer = commandQueue->commandBuffer();
-    MTL::AccelerationStructureCommandEncoder* accelerationEncoder = accelerationCommandBuffer->accelerationStructureCommandEncoder();
-    accelerationEncoder->buildAccelerationStructure(blas, blasDescriptor, scratchBuffer, 0);
-    accelerationEncoder->endEncoding();
-    accelerationCommandBuffer->commit();
-    accelerationCommandBuffer->waitUntilCompleted();
-
-    // all data needed is now in the structure, we do not need the buffers anymore
-    vertexBuffer->release();
-    normalBuffer->release();
-    indexBuffer->release();
-    scratchBuffer->release();
+    // load mesh, straight from the binary cache when the source hasn't changed
+    CachedMesh mesh = loadCachedMesh("models/dragon.obj", 1.0f);
+    std::cout << "Loaded mesh with " << mesh.vertexCount << " vertices and " << mesh.triangleCount << " triangles." << std::endl;
+
+    // builds the acceleration structure of one triangle mesh with its per-primitive normals.
+    // --packed-normals stores them octahedral-encoded in 12 bytes instead of 36
+    auto buildBLAS = [&](const float* vertices, size_t vertexCount, const unsigned int* indices, size_t triangleCount, const float* triangleNormals) {
+        // create buffers
+        MTL::Buffer* vertexBuffer = device->newBuffer(vertices, vertexCount * 3 * sizeof(float), MTL::ResourceStorageModeShared);
+        MTL::Buffer* indexBuffer = device->newBuffer(indices, triangleCount * 3 * sizeof(uint), MTL::ResourceStorageModeShared);
+
+        // make geometry desciptor
+        MTL::AccelerationStructureTriangleGeometryDescriptor* geometryDescriptor = MTL::AccelerationStructureTriangleGeometryDescriptor::alloc()->init();
+
+        // link vertex data
+        geometryDescriptor->setVertexBuffer(vertexBuffer);
+        geometryDescriptor->setVertexStride(sizeof(float) * 3);
+        // link index data 
+        geometryDescriptor->setIndexBuffer(indexBuffer);
+        geometryDescriptor->setIndexType(MTL::IndexTypeUInt32);
+        // set tri count
+        geometryDescriptor->setTriangleCount(triangleCount);
+        // link per-primitive data, three normals per triangle
+        MTL::Buffer* normalBuffer;
+        NS::UInteger primitiveDataSize;
+        if (packedNormals) {
+            std::vector<uint32_t> packed = packPrimitiveNormals(triangleNormals, triangleCount);
+            normalBuffer = device->newBuffer(packed.data(), packed.size() * sizeof(uint32_t), MTL::ResourceStorageModeShared);
+            primitiveDataSize = sizeof(uint32_t) * 3;
+        } else {
+            normalBuffer = device->newBuffer(triangleNormals, triangleCount * 9 * sizeof(float), MTL::ResourceStorageModeShared);
+            primitiveDataSize = sizeof(MTL::PackedFloat3) * 3;
+        }
+        geometryDescriptor->setPrimitiveDataBuffer(normalBuffer);
+        geometryDescriptor->setPrimitiveDataStride(primitiveDataSize);
+        geometryDescriptor->setPrimitiveDataElementSize(primitiveDataSize);
+
+
+        // create AccelerationStructure
+        MTL::PrimitiveAccelerationStructureDescriptor* blasDescriptor = MTL::PrimitiveAccelerationStructureDescriptor::alloc()->init();
+        blasDescriptor->setGeometryDescriptors(NS::Array::array(geometryDescriptor));
+        MTL::AccelerationStructure* blas = device->newAccelerationStructure(blasDescriptor);
+        NS::UInteger scratchBufferSize = device->accelerationStructureSizes(blasDescriptor).buildScratchBufferSize;
+        MTL::Buffer* scratchBuffer = device->newBuffer(scratchBufferSize, MTL::ResourceStorageModePrivate);
+
+        // commit data and construct
+        MTL::CommandBuffer* accelerationCommandBuffer = commandQueue->commandBuffer();
+        MTL::AccelerationStructureCommandEncoder* accelerationEncoder = accelerationCommandBuffer->accelerationStructureCommandEncoder();
+        accelerationEncoder->buildAccelerationStructure(blas, blasDescriptor, scratchBuffer, 0);
+        accelerationEncoder->endEncoding();
+        accelerationCommandBuffer->commit();
+        accelerationCommandBuffer->waitUntilCompleted();
+
+        // all data needed is now in the structure, we do not need the buffers anymore
+        vertexBuffer->release();
+        normalBuffer->release();
+        indexBuffer->release();
+        scratchBuffer->release();
+        blasDescriptor->release();
+        geometryDescriptor->release();
+        return blas;
+    };
+    MTL::AccelerationStructure* blas = buildBLAS(mesh.vertices, mesh.vertexCount, mesh.indices, mesh.triangleCount, mesh.primitiveNormals);
+
+    // coarser versions of the mesh, traced instead of the full one while the camera moves
+    std::vector<MTL::AccelerationStructure*> lodBlas;
+    std::vector<size_t> lodTriangles;
+    if (!noLod) {
+        Mesh source;
+        source.vertices.assign(mesh.vertices, mesh.vertices + mesh.vertexCount * 3);
+        if (mesh.normals) source.normals.assign(mesh.normals, mesh.normals + mesh.vertexCount * 3);
+        source.indices.assign(mesh.indices, mesh.indices + mesh.triangleCount * 3);
+        for (const Mesh& level : buildLODChain(source)) {
+            std::vector<float> levelNormals = primitiveNormals(level);
+            lodBlas.push_back(buildBLAS(level.vertices.data(), level.vertices.size() / 3, level.indices.data(), level.indices.size() / 3, levelNormals.data()));
+            lodTriangles.push_back(level.indices.size() / 3);
+            std::cout << "LOD " << lodBlas.size() << ": " << lodTriangles.back() << " triangles." << std::endl;
+        }
+    }
 
 
     // temp imgui stuff
     struct point {
         float x, y, z;
     };
-    uint frame = 1;
+    uint frame = 1;  // samples per pixel in the next frame, 1 starts the image over
+    uint normalEncoding = packedNormals ? 1 : 0;
     point lookFrom = {2.8f, 0.0f, -1.2f};
     point lookAt = {0.0f, 0.1f, 0.0f};
+
+    // preview LOD, traced from the first camera change until it has been still for a moment
+    bool previewWhileMoving = !lodBlas.empty();
+    int previewLevel = lodBlas.size() > 1 ? 1 : 0;
+    const double settleTime = 0.25;
+    double lastMove = -settleTime;
+    point lastFrom = lookFrom, lastAt = lookAt;
+    bool wasMoving = false;
+
+    // progressive accumulation stops once enough pixels are within the error target, or the
+    // sample budget is spent, and starts over when the view changes
+    struct Convergence {
+        float relativeError;
+        uint minSamples;
+    };
+    Convergence convergence = {0.01f, 8};
+    int sampleBudget = 1024;
+    const float pixelShare = 0.99f;
+    bool converged = false;
+    float convergedShare = 0.0f;
+    // the latest completed pass: the accumulation it belongs to in the high 32 bits, its
+    // converged pixels in the low ones. Passes of an older accumulation don't count
+    uint32_t accumulation = 0;
+    std::atomic<uint64_t> lastConverged{0};
     
     // start main event loop
     while (!glfwWindowShouldClose(window))  {
@@ -282,13 +297,49 @@ int main() {
         CA::MetalDrawable* drawable = layer->nextDrawable();
 
 
-        // do compute pass
-        {
+        // samples of another view don't belong in the mean
+        if (std::memcmp(&lookFrom, &lastFrom, sizeof(point)) != 0 || std::memcmp(&lookAt, &lastAt, sizeof(point)) != 0) {
+            lastMove = glfwGetTime();
+            lastFrom = lookFrom;
+            lastAt = lookAt;
+            frame = 1;
+        }
+        bool moving = previewWhileMoving && glfwGetTime() - lastMove < settleTime;
+        // the image restarts with the full mesh once the camera settles
+        if (wasMoving && !moving) frame = 1;
+        wasMoving = moving;
+        if (accumulationLost) {
+            frame = 1;
+            accumulationLost = false;
+        }
+
+        // the newest pass that has finished decides whether this one is needed, without waiting
+        // for the ones still in flight; they add a frame or two of samples past the target
+        if (frame == 1) {
+            accumulation++;
+            converged = false;
+            convergedShare = 0.0f;
+        } else {
+            uint64_t latest = lastConverged.load(std::memory_order_acquire);
+            if (uint32_t(latest >> 32) == accumulation) {
+                size_t pixels = computeTexture->width() * computeTexture->height();
+                convergedShare = float(uint32_t(latest)) / float(pixels);
+            }
+            converged = convergedShare >= pixelShare || frame > uint(sampleBudget);
+        }
+
+        // do compute pass, until the image has converged
+        if (!converged) {
+            // only blocks while every counter is still in use by the GPU
+            dispatch_semaphore_wait(computeSlotFree, DISPATCH_TIME_FOREVER);
+            MTL::Buffer* convergedBuffer = convergedBuffers[computeSlot];
+            computeSlot = (computeSlot + 1) % computeSlots;
+
             MTL::CommandBuffer* computeCommandBuffer = commandQueue->commandBuffer();
             MTL::ComputeCommandEncoder* computeEncoder = computeCommandBuffer->computeCommandEncoder();
             computeEncoder->setComputePipelineState(pipelineComputeState);
-            
-            computeEncoder->setAccelerationStructure(blas, 0);
+
+            computeEncoder->setAccelerationStructure(moving ? lodBlas[previewLevel] : blas, 0);
 
 
             computeEncoder->setTexture(computeTexture, 0);
@@ -296,11 +347,22 @@ int main() {
             computeEncoder->setBytes(&lookFrom, sizeof(point), 1);
             computeEncoder->setBytes(&lookAt, sizeof(point), 2);
             computeEncoder->setBytes(&frame, sizeof(uint), 3);
+            computeEncoder->setBytes(&normalEncoding, sizeof(uint), 4);
+            computeEncoder->setBuffer(accumulationBuffer, 0, 5);
+            *static_cast<uint32_t*>(convergedBuffer->contents()) = 0;
+            computeEncoder->setBuffer(convergedBuffer, 0, 6);
+            computeEncoder->setBytes(&convergence, sizeof(Convergence), 7);
             frame++;
 
             // dispatch compute
             computeEncoder->dispatchThreads(MTL::Size(width, height, 1), MTL::Size(16, 16, 1));
             computeEncoder->endEncoding();
+            uint32_t passAccumulation = accumulation;
+            computeCommandBuffer->addCompletedHandler([&lastConverged, computeSlotFree, convergedBuffer, passAccumulation](MTL::CommandBuffer*) {
+                uint32_t count = *static_cast<uint32_t*>(convergedBuffer->contents());
+                lastConverged.store(uint64_t(passAccumulation) << 32 | count, std::memory_order_release);
+                dispatch_semaphore_signal(computeSlotFree);
+            });
             computeCommandBuffer->commit();
         }
 
@@ -345,7 +407,15 @@ int main() {
                 ImGui::Checkbox("Demo Window", &show_demo_window);
                 ImGui::SliderFloat3("Look From", &lookFrom.x, -5.0f, 5.0f);
                 ImGui::SliderFloat3("Look At", &lookAt.x, -1.0f, 1.0f);
+                if (!lodBlas.empty()) {
+                    ImGui::Checkbox("Preview LOD while moving", &previewWhileMoving);
+                    ImGui::SliderInt("Preview LOD", &previewLevel, 0, static_cast<int>(lodBlas.size()) - 1);
+                    ImGui::Text("Tracing %zu triangles", wasMoving ? lodTriangles[previewLevel] : mesh.triangleCount);
+                }
                 ImGui::Text("Frame-count since last purge: %i", frame);
+                ImGui::SliderFloat("Target error", &convergence.relativeError, 0.001f, 0.1f, "%.3f", ImGuiSliderFlags_Logarithmic);
+                ImGui::SliderInt("Sample budget", &sampleBudget, 1, 4096);
+                ImGui::Text("Converged: %.1f%% of pixels%s", 100.0f * convergedShare, converged ? ", idle" : "");
                 if(ImGui::Button("Purge")) {
                     frame = 1;
                 }
@@ -371,6 +441,9 @@ int main() {
         pPool->release();
     }
 
+    // the completed handlers of passes still in flight use the counters and lastConverged
+    for (int i = 0; i < computeSlots; ++i) dispatch_semaphore_wait(computeSlotFree, DISPATCH_TIME_FOREVER);
+
     ImGui_ImplMetal_Shutdown();
     ImGui_ImplGlfw_Shutdown();
     ImGui::DestroyContext();
@@ -17,6 +17,22 @@ struct Triangle {
     packed_float3 n2;
 };
 
+// same normals, octahedral-encoded as two snorm16 each (see NormalPacking.hpp)
+struct PackedTriangle {
+    uint n0;
+    uint n1;
+    uint n2;
+};
+
+inline float3 decodeOctahedral(uint packed) {
+    float2 p = unpack_snorm2x16_to_float(packed);
+    float3 n = float3(p.x, p.y, 1.0 - abs(p.x) - abs(p.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
 // Vertex function
 vertex VertexOut vert_shader(
     uint vertexID [[vertex_id]]
@@ -73,18 +89,41 @@ inline T interpolateVertexAttribute(thread T* attributes, float2 uv) {
 
 
 
+// PCG hash, the CPU renderer's too (CpuRenderer.cpp), so both place samples alike
+inline uint pcgHash(uint v) {
+    uint state = v * 747796405u + 2891336453u;
+    uint word = ((state >> ((state >> 28u) + 4u)) ^ state) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+// [0, 1) from the top 24 bits
+inline float unitFloat(uint bits) {
+    return float(bits >> 8) * (1.0 / 16777216.0);
+}
+
+// when a pixel counts as converged, see ConvergenceOptions in CpuRenderer.hpp
+struct Convergence {
+    float relativeError;
+    uint minSamples;
+};
+
 // Define the compute kernel
 kernel void compute_kernel(
     texture2d<float, access::read_write> texture [[texture(0)]],
     constant packed_float3 &lookFrom [[buffer(1)]],
     constant packed_float3 &lookAt [[buffer(2)]],
     constant uint &frame [[buffer(3)]],
+    constant uint &packedNormals [[buffer(4)]],
+    device float4 *accumulation [[buffer(5)]],          // mean and summed squared deviations per pixel
+    device atomic_uint *convergedPixels [[buffer(6)]],  // counted for the host, reset by it every frame
+    constant Convergence &convergence [[buffer(7)]],
     primitive_acceleration_structure accelStructure [[buffer(0)]],
     uint2 gid [[thread_position_in_grid]]                    
 ) {
     // Get texture size
     uint width = texture.get_width();
     uint height = texture.get_height();
+    if (gid.x >= width || gid.y >= height) return;
     float aspect = float(width) / float(height);
 
     // Field of View to viewport scale
@@ -102,8 +141,14 @@ kernel void compute_kernel(
     float3 vertical = 2.0 * half_height * adjustedUp;
     float3 lower_left_corner = lookFrom + forward - half_width * right - half_height * adjustedUp;
 
-    // Calculate normalized coordinates (0.0 to 1.0)
-    float2 uv = float2(gid) / float2(width, height);
+    // Calculate normalized coordinates (0.0 to 1.0). the first sample goes through the pixel's
+    // corner, later ones anywhere in it, so the mean is antialiased
+    float2 jitter = float2(0.0);
+    if (frame > 1) {
+        uint seed = pcgHash(gid.x + pcgHash(gid.y + pcgHash(frame - 1)));
+        jitter = float2(unitFloat(seed), unitFloat(pcgHash(seed)));
+    }
+    float2 uv = (float2(gid) + jitter) / float2(width, height);
 
     // Compute the ray direction for the pixel
     float3 ray_direction = normalize(lower_left_corner + uv.x * horizontal + uv.y * vertical - lookFrom);
@@ -136,13 +181,20 @@ kernel void compute_kernel(
         }
     } else {
         // if we hit a triangle, shade it based on its normal
-        const device Triangle *data;
-        data = (const device Triangle*)intersection.primitive_data;
-
         float3 n[3];
-        n[0] = data->n0;
-        n[1] = data->n1;
-        n[2] = data->n2;
+        if (packedNormals) {
+            const device PackedTriangle *data;
+            data = (const device PackedTriangle*)intersection.primitive_data;
+            n[0] = decodeOctahedral(data->n0);
+            n[1] = decodeOctahedral(data->n1);
+            n[2] = decodeOctahedral(data->n2);
+        } else {
+            const device Triangle *data;
+            data = (const device Triangle*)intersection.primitive_data;
+            n[0] = data->n0;
+            n[1] = data->n1;
+            n[2] = data->n2;
+        }
 
         float2 uv = intersection.triangle_barycentric_coord;
         float3 norm = interpolateVertexAttribute(n, uv);
@@ -154,8 +206,23 @@ kernel void compute_kernel(
         color = float4(light_intensity, 1.0);
     }
 
-    // blend the color with the previous frame
-    // float4 prev_color = texture.read(gid);
-    // float4 new_color = (prev_color * float(frame - 1) + color) / float(frame); 
-    texture.write(color, gid);
+    // running mean and variance of this pixel's samples (Welford), frame is the sample count
+    uint index = gid.y * width + gid.x;
+    float4 mean = frame > 1 ? accumulation[2 * index] : float4(0.0);
+    float4 m2 = frame > 1 ? accumulation[2 * index + 1] : float4(0.0);
+    float4 delta = color - mean;
+    mean += delta / float(frame);
+    m2 += delta * (color - mean);
+    accumulation[2 * index] = mean;
+    accumulation[2 * index + 1] = m2;
+    texture.write(mean, gid);
+
+    // converged when the standard error of every channel is small next to the luminance
+    if (frame >= max(convergence.minSamples, 2u)) {
+        float variance = max(m2.x, max(m2.y, m2.z)) / float(frame - 1);
+        float luminance = dot(mean.xyz, float3(0.2126, 0.7152, 0.0722));
+        if (sqrt(variance / float(frame)) <= convergence.relativeError * max(abs(luminance), 0.01)) {
+            atomic_fetch_add_explicit(convergedPixels, 1u, memory_order_relaxed);
+        }
+    }
 }
@@ -648,6 +648,17 @@ void LoadMtl(std::map<std::string, int> *material_map,
 bool ParseTextureNameAndOption(std::string *texname, texture_option_t *texopt,
                                const char *linebuf);
 
+///
+/// Parse a floating point number in [s, s_end) with the grammar used for
+/// `v`, `vn`, `vt` and .mtl values.
+///
+/// Short decimals take a fast path whose result matches the original
+/// digit-by-digit routine after conversion to real_t. Pass `reference = true`
+/// to force the original routine (for testing and benchmarking).
+///
+bool ParseDouble(const char *s, const char *s_end, double *result,
+                 bool reference = false);
+
 /// =<<========== Legacy v1 API =============================================
 
 }  // namespace tinyobj
@@ -667,6 +678,18 @@ bool ParseTextureNameAndOption(std::string *texname, texture_option_t *texopt,
 #include <sstream>
 #include <utility>
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TINYOBJLOADER_SIMD_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define TINYOBJLOADER_SIMD_NEON
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 #ifdef TINYOBJLOADER_USE_MAPBOX_EARCUT
 
 #ifdef TINYOBJLOADER_DONOT_INCLUDE_MAPBOX_EARCUT
@@ -894,7 +917,8 @@ static inline int parseInt(const char **token) {
 //  - s >= s_end.
 //  - parse failure.
 //
-static bool tryParseDouble(const char *s, const char *s_end, double *result) {
+static bool tryParseDoubleReference(const char *s, const char *s_end,
+                                    double *result) {
   if (s >= s_end) {
     return false;
   }
@@ -1027,6 +1051,243 @@ fail:
   return false;
 }
 
+// Fast path for the short decimals that make up almost every OBJ file.
+//
+// The token is classified with one 16 byte SIMD compare, which gives the
+// length of every digit run without a branch per character. Each run is then
+// converted eight digits at a time with SWAR multiplies. The digits (at most
+// 15, so always below 2^53 and exact in a double) are scaled with a single
+// multiply by a power of ten, as in the first stage of Eisel-Lemire.
+//
+// Neither this nor the reference routine above is correctly rounded, but
+// both are within a few double ulps of the exact value. They can therefore
+// only round to different floats when the value lies right next to a float
+// rounding midpoint. Those values, and anything outside the fast path's
+// grammar, fall back to the reference routine; that keeps the real_t result
+// bit-exact with what tinyobj always produced. With
+// TINYOBJLOADER_USE_DOUBLE real_t keeps all the reference bits, so the fast
+// path is disabled.
+
+#if defined(TINYOBJLOADER_SIMD_NEON)
+// NEON has no movemask, every byte becomes a nibble of the mask instead.
+static const int kDigitMaskBits = 4;
+static inline unsigned long long nonDigitMask16(const char *block) {
+  uint8x16_t chars = vld1q_u8(reinterpret_cast<const uint8_t *>(block));
+  uint8x16_t digits =
+      vcleq_u8(vsubq_u8(chars, vdupq_n_u8('0')), vdupq_n_u8(9));
+  uint8x8_t nibbles = vshrn_n_u16(vreinterpretq_u16_u8(digits), 4);
+  return ~vget_lane_u64(vreinterpret_u64_u8(nibbles), 0);
+}
+#elif defined(TINYOBJLOADER_SIMD_SSE2)
+static const int kDigitMaskBits = 1;
+static inline unsigned long long nonDigitMask16(const char *block) {
+  __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(block));
+  __m128i offset = _mm_sub_epi8(chars, _mm_set1_epi8('0'));
+  __m128i digits =
+      _mm_cmpeq_epi8(_mm_min_epu8(offset, _mm_set1_epi8(9)), offset);
+  return ~static_cast<unsigned long long>(_mm_movemask_epi8(digits));
+}
+#else
+static const int kDigitMaskBits = 1;
+static inline unsigned long long nonDigitMask16(const char *block) {
+  unsigned long long mask = ~0ULL;
+  for (int i = 0; i < 16; i++) {
+    if (IS_DIGIT(block[i])) mask &= ~(1ULL << i);
+  }
+  return mask;
+}
+#endif
+
+static inline int countTrailingZeros(unsigned long long x) {
+#ifdef _MSC_VER
+  unsigned long index;
+  _BitScanForward64(&index, x);
+  return static_cast<int>(index);
+#else
+  return __builtin_ctzll(x);
+#endif
+}
+
+// Length of the digit run starting at `pos`. Bytes past the token are
+// flagged as non-digits, so a run always ends inside the mask.
+static inline int digitRun(unsigned long long non_digits, int pos) {
+  return countTrailingZeros(non_digits >> (pos * kDigitMaskBits)) /
+         kDigitMaskBits;
+}
+
+// Value of `count` (0 to 8) ASCII digits at p. Reads 8 bytes.
+static inline unsigned long long parseDigits8(const char *p, int count) {
+  if (count == 0) return 0;
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+  unsigned long long value = 0;
+  for (int i = 0; i < count; i++) {
+    value = value * 10 + static_cast<unsigned int>(p[i] - '0');
+  }
+  return value;
+#else
+  // Shifting the unused bytes out on the left turns them into leading zeros.
+  unsigned long long v;
+  memcpy(&v, p, sizeof(v));
+  v = (v & 0x0F0F0F0F0F0F0F0FULL) << (8 * (8 - count));
+  v = (v * 2561) >> 8;
+  v = ((v & 0x00FF00FF00FF00FFULL) * 6553601) >> 16;
+  return ((v & 0x0000FFFF0000FFFFULL) * 42949672960001ULL) >> 32;
+#endif
+}
+
+// Short runs are cheaper as a plain loop than as a chain of SWAR multiplies.
+static inline unsigned long long parseDigits(const char *p, int count) {
+  if (count <= 4) {
+    unsigned long long value = 0;
+    for (int i = 0; i < count; i++) {
+      value = value * 10 + static_cast<unsigned int>(p[i] - '0');
+    }
+    return value;
+  }
+  if (count <= 8) return parseDigits8(p, count);
+  return parseDigits8(p, count - 8) * 100000000ULL +
+         parseDigits8(p + count - 8, 8);
+}
+
+#if defined(__SANITIZE_ADDRESS__)
+#define TINYOBJLOADER_NO_READ_AHEAD
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define TINYOBJLOADER_NO_READ_AHEAD
+#endif
+#endif
+
+// The fast path reads a fixed 32 byte window starting at the token. Reading
+// past s_end is harmless while the window stays inside one page, otherwise
+// (and under AddressSanitizer) the token is copied into a zero padded buffer.
+static inline bool canReadAhead(const char *s) {
+#ifdef TINYOBJLOADER_NO_READ_AHEAD
+  (void)s;
+  return false;
+#else
+  return (reinterpret_cast<size_t>(s) & 4095) <= 4096 - 32;
+#endif
+}
+
+static inline bool tryParseDoubleFast(const char *s, const char *s_end,
+                                      double *result) {
+#ifdef TINYOBJLOADER_USE_DOUBLE
+  (void)s;
+  (void)s_end;
+  (void)result;
+  return false;
+#else
+  static const double pow10_lut[] = {
+      1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+      1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+  };
+  static const double neg_pow10_lut[] = {
+      1e-0,  1e-1,  1e-2,  1e-3,  1e-4,  1e-5,  1e-6,  1e-7,
+      1e-8,  1e-9,  1e-10, 1e-11, 1e-12, 1e-13, 1e-14, 1e-15,
+      1e-16, 1e-17, 1e-18, 1e-19, 1e-20, 1e-21, 1e-22,
+  };
+  static const unsigned long long pow10_int[] = {
+      1ULL,          10ULL,          100ULL,          1000ULL,
+      10000ULL,      100000ULL,      1000000ULL,      10000000ULL,
+      100000000ULL,  1000000000ULL,  10000000000ULL,  100000000000ULL,
+      1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+      1000000000000000ULL,
+  };
+
+  if (s >= s_end || s_end - s > 15) return false;
+  const int len = static_cast<int>(s_end - s);
+
+  char padded[32];
+  const char *p = s;
+  if (!canReadAhead(s)) {
+    memset(padded, 0, sizeof(padded));
+    memcpy(padded, s, static_cast<size_t>(len));
+    p = padded;
+  }
+  const unsigned long long non_digits =
+      nonDigitMask16(p) | (~0ULL << (len * kDigitMaskBits));
+
+  // Signs are random in mesh data, so keep them off the branch predictor.
+  const unsigned long long negative = (p[0] == '-');
+  int pos = static_cast<int>(negative | (p[0] == '+'));
+
+  const int int_pos = pos;
+  const int int_len = digitRun(non_digits, pos);
+  pos += int_len;
+
+  int frac_pos = pos;
+  int frac_len = 0;
+  if (pos < len && p[pos] == '.') {
+    frac_pos = ++pos;
+    frac_len = digitRun(non_digits, pos);
+    pos += frac_len;
+  }
+  if (int_len + frac_len == 0) return false;
+
+  int exponent = 0;
+  if (pos < len && (p[pos] == 'e' || p[pos] == 'E')) {
+    pos++;
+    bool exp_negative = false;
+    if (pos < len && (p[pos] == '+' || p[pos] == '-')) {
+      exp_negative = (p[pos] == '-');
+      pos++;
+    }
+    const int exp_len = digitRun(non_digits, pos);
+    if (exp_len == 0 || exp_len > 3) return false;
+    exponent = static_cast<int>(parseDigits8(p + pos, exp_len));
+    if (exp_negative) exponent = -exponent;
+    pos += exp_len;
+  }
+
+  // Trailing characters: leave the greedy semantics to the reference routine.
+  if (pos != len) return false;
+
+  const int scale = exponent - frac_len;
+  if (scale < -22 || scale > 22) return false;
+
+  const unsigned long long mantissa =
+      parseDigits(p + int_pos, int_len) * pow10_int[frac_len] +
+      parseDigits(p + frac_pos, frac_len);
+
+  // Signed conversion is a single instruction, unsigned is not.
+  double value = static_cast<double>(static_cast<long long>(mantissa));
+  value *= scale < 0 ? neg_pow10_lut[-scale] : pow10_lut[scale];
+
+  unsigned long long bits;
+  memcpy(&bits, &value, sizeof(bits));
+  if (value != 0.0) {
+    // Only normal floats, and not within 1024 double ulps of a midpoint.
+    if (value < static_cast<double>(std::numeric_limits<float>::min()) ||
+        value >= 1.0e38) {
+      return false;
+    }
+    const unsigned long long dropped = bits & ((1ULL << 29) - 1);
+    const unsigned long long half = 1ULL << 28;
+    const unsigned long long distance =
+        dropped > half ? dropped - half : half - dropped;
+    if (distance <= 1024) return false;
+  }
+
+  bits |= negative << 63;
+  memcpy(result, &bits, sizeof(bits));
+  return true;
+#endif
+}
+
+// Tokens of six characters or less ("0.5", "0.1234") have so few digits that
+// the reference loop is already cheaper than the fast path's fixed cost.
+static inline bool tryParseDouble(const char *s, const char *s_end,
+                                  double *result) {
+  return (s_end - s > 6 && tryParseDoubleFast(s, s_end, result)) ||
+         tryParseDoubleReference(s, s_end, result);
+}
+
+bool ParseDouble(const char *s, const char *s_end, double *result,
+                 bool reference) {
+  return reference ? tryParseDoubleReference(s, s_end, result)
+                   : tryParseDouble(s, s_end, result);
+}
+
 static inline real_t parseReal(const char **token, double default_value = 0.0) {
   (*token) += strspn((*token), " \t");
   const char *end = (*token) + strcspn((*token), " \t\r");